@@ -32,6 +32,8 @@ from __future__ import print_function
 from third_party.dopamine import sum_tree
 import gin.tf
 import numpy as np
+import os
+import pyhanabi
 import replay_memory
 import tensorflow as tf
 
@@ -169,6 +171,108 @@ class OutOfGraphPrioritizedReplayMemory(replay_memory.OutOfGraphReplayMemory):
     return priority_batch
 
 
+class NativePrioritizedReplayMemory(object):
+  """OutOfGraphPrioritizedReplayMemory backed by pyhanabi's C++ memory.
+
+  Observations and legal actions are stored one bit per value. Legal actions
+  are passed as for the Python memory (0 for legal, -inf otherwise) and are
+  returned the same way.
+  """
+
+  def __init__(self, num_actions, observation_size, stack_size, replay_capacity,
+               batch_size, update_horizon=1, gamma=1.0):
+    self._num_actions = num_actions
+    self._observation_size = observation_size
+    self._stack_size = stack_size
+    self._batch_size = batch_size
+    self._memory = pyhanabi.PrioritizedReplayMemory(
+        num_actions, observation_size, stack_size, replay_capacity,
+        update_horizon, gamma, seed=np.random.randint(2**31))
+
+  @property
+  def add_count(self):
+    return self._memory.add_count
+
+  def add(self, observation, action, reward, terminal, legal_actions):
+    """Adds a transition to the replay memory, see OutOfGraphReplayMemory."""
+    self._memory.add(
+        np.packbits(np.asarray(observation, dtype=np.uint8) != 0),
+        int(action), float(reward), bool(terminal),
+        np.packbits(np.asarray(legal_actions) == 0))
+
+  def sample_transition_batch(self, batch_size=None, indices=None):
+    """Returns a batch of transitions, see OutOfGraphReplayMemory."""
+    if batch_size is None:
+      batch_size = self._batch_size if indices is None else len(indices)
+    stack_shape = (batch_size, self._observation_size, self._stack_size)
+    states = np.empty(stack_shape, dtype=np.uint8)
+    actions = np.empty((batch_size), dtype=np.int32)
+    rewards = np.empty((batch_size), dtype=np.float32)
+    next_states = np.empty(stack_shape, dtype=np.uint8)
+    terminals = np.empty((batch_size), dtype=np.uint8)
+    indices_batch = np.empty((batch_size), dtype=np.int32)
+    next_legal_actions = np.empty((batch_size, self._num_actions),
+                                  dtype=np.float32)
+    if indices is not None:
+      indices = np.ascontiguousarray(indices, dtype=np.int32)
+    self._memory.sample_transitions(states, actions, rewards, next_states,
+                                    terminals, indices_batch,
+                                    next_legal_actions, indices=indices)
+    return (states, actions, rewards, next_states, terminals, indices_batch,
+            next_legal_actions)
+
+  def sample_index_batch(self, batch_size):
+    indices = np.empty((batch_size), dtype=np.int32)
+    self._memory.sample_indices(indices)
+    return indices
+
+  def set_priority(self, indices, priorities):
+    """Sets the priorities of the given elements in one batched update."""
+    self._memory.set_priorities(
+        np.ascontiguousarray(indices, dtype=np.int32),
+        np.ascontiguousarray(priorities, dtype=np.float32))
+
+  def get_priority(self, indices, batch_size=None):
+    """Returns the float32 priorities of the given elements."""
+    indices = np.ascontiguousarray(indices, dtype=np.int32)
+    priority_batch = np.empty((len(indices)), dtype=np.float32)
+    self._memory.get_priorities(indices, priority_batch)
+    return priority_batch
+
+  def _generate_filename(self, checkpoint_dir, suffix):
+    return os.path.join(checkpoint_dir, 'native_replay_ckpt.{}'.format(suffix))
+
+  def save(self, checkpoint_dir, iteration_number):
+    """Writes the memory to a local checkpoint file.
+
+    Args:
+      checkpoint_dir: str, directory where the checkpoint should be saved.
+      iteration_number: int, suffix of the checkpoint file.
+    """
+    if not os.path.isdir(checkpoint_dir):
+      return
+    self._memory.save(self._generate_filename(checkpoint_dir,
+                                              iteration_number))
+    stale_iteration_number = (
+        iteration_number - replay_memory.CHECKPOINT_DURATION)
+    stale_filename = self._generate_filename(checkpoint_dir,
+                                             stale_iteration_number)
+    if stale_iteration_number >= 0 and os.path.exists(stale_filename):
+      os.remove(stale_filename)
+
+  def load(self, checkpoint_dir, suffix):
+    """Restores the memory written by save().
+
+    Raises:
+      NotFoundError: if the checkpoint file does not exist.
+    """
+    filename = self._generate_filename(checkpoint_dir, suffix)
+    if not os.path.exists(filename):
+      raise tf.errors.NotFoundError(None, None,
+                                    'Missing file: {}'.format(filename))
+    self._memory.load(filename)
+
+
 @gin.configurable(blacklist=['observation_size', 'stack_size'])
 class WrappedPrioritizedReplayMemory(replay_memory.WrappedReplayMemory):
   """In graph wrapper for the python Replay Memory.
@@ -211,7 +315,8 @@ class WrappedPrioritizedReplayMemory(replay_memory.WrappedReplayMemory):
                replay_capacity=1000000,
                batch_size=32,
                update_horizon=1,
-               gamma=1.0):
+               gamma=1.0,
+               use_native_memory=False):
     """Initializes a graph wrapper for the python Replay Memory.
 
     Args:
@@ -224,15 +329,17 @@ class WrappedPrioritizedReplayMemory(replay_memory.WrappedReplayMemory):
       batch_size: int.
       update_horizon: int, length of update ('n' in n-step update).
       gamma: int, the discount factor.
+      use_native_memory: bool, whether to use the C++ memory of pyhanabi,
+        which samples and updates priorities in batches.
 
     Raises:
       ValueError: If update_horizon is not positive.
       ValueError: If discount factor is not in [0, 1].
     """
-    memory = OutOfGraphPrioritizedReplayMemory(num_actions, observation_size,
-                                               stack_size, replay_capacity,
-                                               batch_size, update_horizon,
-                                               gamma)
+    memory_class = (NativePrioritizedReplayMemory if use_native_memory else
+                    OutOfGraphPrioritizedReplayMemory)
+    memory = memory_class(num_actions, observation_size, stack_size,
+                          replay_capacity, batch_size, update_horizon, gamma)
     super(WrappedPrioritizedReplayMemory, self).__init__(
         num_actions,
         observation_size, stack_size, use_staging, replay_capacity, batch_size,
@@ -0,0 +1,276 @@
+// Copyright 2018 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+// Heap allocations per engine call and per game step.
+//
+//   alloc_bench [--players=2,3,4,5] [--check]
+//
+// Requires a build with -DHANABI_ALLOC_ACCOUNTING=ON. Every operation runs
+// once per corpus position inside an AllocScope, and the mean number of
+// allocations and bytes per call is reported. With --check, the binary
+// exits with status 1 if any operation exceeds its budget for the player
+// count in kBudgets. Builds with HANABI_ALLOC_ACCOUNTING register
+// alloc_bench --check with CTest, so allocation regressions fail CI. Lower a
+// budget whenever an operation gets cheaper, to lock the progress in.
+
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "alloc_accounting.h"
+#include "bench_corpus.h"
+#include "bench_harness.h"
+#include "canonical_encoders.h"
+#include "hanabi_game.h"
+#include "hanabi_observation.h"
+#include "hanabi_state.h"
+#include "pyhanabi.h"
+
+namespace hle = hanabi_learning_env;
+
+namespace {
+
+// Maximum mean allocations per call for 2, 3, 4 and 5 players. Set from the
+// measured values rounded up; the corpus is seeded, so they are exact.
+const std::map<std::string, std::vector<double>> kBudgets = {
+    {"LegalMoves", {6, 6, 6, 6}},
+    {"MoveIsLegal", {0, 0, 0, 0}},
+    {"ChanceOutcomes", {12, 12, 12, 12}},
+    {"StateCopy", {31, 43, 47, 57}},
+    {"ApplyMove", {2, 2, 2, 2}},
+    {"ApplyRandomChance", {22, 22, 22, 22}},
+    {"HanabiObservation", {59, 84, 92, 113}},
+    {"Encode", {3, 3, 3, 3}},
+    {"EncodeInto", {2, 2, 2, 2}},
+    {"GameStep", {186, 339, 460, 669}},
+    {"pyhanabi.StateLegalMoves", {23, 29, 29, 34}},
+    {"pyhanabi.NewObservation", {60, 85, 93, 114}},
+    {"pyhanabi.StateLegalMoveUids", {0, 0, 0, 0}},
+    {"pyhanabi.StateMoveHistoryEntries", {0, 0, 0, 0}},
+};
+constexpr int kMinBudgetPlayers = 2;
+
+struct AllocResult {
+  std::string name;
+  int players;
+  double allocations;  // Mean per call.
+  double bytes;        // Mean per call.
+};
+
+class AllocMeter {
+ public:
+  explicit AllocMeter(int players) : players_(players) {}
+
+  // op(i) runs the i-th call; setup(i), if any, runs outside the scope.
+  template <typename Op>
+  void Measure(const std::string& name, int count, Op op) {
+    Measure(name, count, [](int) {}, op);
+  }
+
+  template <typename Setup, typename Op>
+  void Measure(const std::string& name, int count, Setup setup, Op op) {
+    hle::AllocCounts total;
+    for (int i = 0; i < count; ++i) {
+      setup(i);
+      hle::AllocScope scope;
+      op(i);
+      hle::AllocCounts counts = scope.Counts();
+      total.allocations += counts.allocations;
+      total.bytes += counts.bytes;
+    }
+    results_.push_back({name, players_,
+                        static_cast<double>(total.allocations) / count,
+                        static_cast<double>(total.bytes) / count});
+  }
+
+  const std::vector<AllocResult>& Results() const { return results_; }
+
+ private:
+  int players_;
+  std::vector<AllocResult> results_;
+};
+
+void MeasurePlayers(int num_players, std::vector<AllocResult>* results) {
+  hle::HanabiGame game({{"players", std::to_string(num_players)},
+                        {"seed", "0"}});
+  const hanabi_bench::Corpus corpus = hanabi_bench::BuildCorpus(game);
+  const auto& states = corpus.player_states;
+  const int num_states = states.size();
+  const int num_chance_states = corpus.chance_states.size();
+  hle::CanonicalObservationEncoder encoder(&game);
+  AllocMeter meter(num_players);
+  int sink = 0;
+
+  meter.Measure("LegalMoves", num_states, [&](int i) {
+    sink += states[i].LegalMoves(states[i].CurPlayer()).size();
+  });
+  meter.Measure("MoveIsLegal", num_states, [&](int i) {
+    for (int uid = 0; uid < game.MaxMoves(); ++uid) {
+      sink += states[i].MoveIsLegal(game.GetMove(uid));
+    }
+  });
+  meter.Measure("ChanceOutcomes", num_chance_states, [&](int i) {
+    sink += corpus.chance_states[i].ChanceOutcomes().first.size();
+  });
+  meter.Measure("StateCopy", num_states, [&](int i) {
+    hle::HanabiState copy(states[i]);
+    sink += copy.CurPlayer();
+  });
+  // The copy is made outside the measured scope.
+  std::unique_ptr<hle::HanabiState> state;
+  meter.Measure(
+      "ApplyMove", num_states,
+      [&](int i) { state.reset(new hle::HanabiState(states[i])); },
+      [&](int i) { state->ApplyMove(corpus.player_moves[i]); });
+  meter.Measure(
+      "ApplyRandomChance", num_chance_states,
+      [&](int i) {
+        state.reset(new hle::HanabiState(corpus.chance_states[i]));
+      },
+      [&](int) { state->ApplyRandomChance(); });
+  meter.Measure("HanabiObservation", num_states, [&](int i) {
+    hle::HanabiObservation obs(states[i], states[i].CurPlayer());
+    sink += obs.DeckSize();
+  });
+  meter.Measure("Encode", num_states, [&](int i) {
+    sink += encoder
+                .Encode(corpus.observations[i], false, {}, false, {}, {},
+                        false)
+                .size();
+  });
+  std::vector<float> encoding(encoder.EncodingLength());
+  meter.Measure("EncodeInto", num_states, [&](int i) {
+    encoder.EncodeInto(corpus.observations[i], false, {}, false, {}, {}, false,
+                       encoding.data());
+    sink += encoding[0];
+  });
+  // An actor step: observe, act, deal, and encode every player's view.
+  meter.Measure(
+      "GameStep", num_states,
+      [&](int i) { state.reset(new hle::HanabiState(states[i])); },
+      [&](int i) {
+        hle::HanabiObservation obs(*state, state->CurPlayer());
+        sink += obs.LegalMoves().size();
+        state->ApplyMove(corpus.player_moves[i]);
+        while (state->CurPlayer() == hle::kChancePlayerId &&
+               !state->IsTerminal()) {
+          state->ApplyRandomChance();
+        }
+        for (int p = 0; p < num_players; ++p) {
+          hle::HanabiObservation player_obs(*state, p);
+          sink += encoder.Encode(player_obs, false, {}, false, {}, {}, false)
+                      .size();
+        }
+      });
+
+  // The C API as driven by pyhanabi.py.
+  pyhanabi_state_t c_state;
+  meter.Measure(
+      "pyhanabi.StateLegalMoves", num_states,
+      [&](int i) { c_state.state = const_cast<hle::HanabiState*>(&states[i]); },
+      [&](int) {
+        void* movelist = StateLegalMoves(&c_state);
+        for (int m = 0; m < NumMoves(movelist); ++m) {
+          pyhanabi_move_t move;
+          GetMove(movelist, m, &move);
+          sink += MoveType(&move);
+          DeleteMove(&move);
+        }
+        DeleteMoveList(movelist);
+      });
+  meter.Measure(
+      "pyhanabi.NewObservation", num_states,
+      [&](int i) { c_state.state = const_cast<hle::HanabiState*>(&states[i]); },
+      [&](int i) {
+        pyhanabi_observation_t observation;
+        NewObservation(&c_state, states[i].CurPlayer(), &observation);
+        sink += ObsDeckSize(&observation);
+        DeleteObservation(&observation);
+      });
+
+  std::vector<int> uids(game.MaxMoves());
+  meter.Measure(
+      "pyhanabi.StateLegalMoveUids", num_states,
+      [&](int i) { c_state.state = const_cast<hle::HanabiState*>(&states[i]); },
+      [&](int) { sink += StateLegalMoveUids(&c_state, uids.data()); });
+  std::vector<pyhanabi_history_entry_t> entries(256);
+  meter.Measure(
+      "pyhanabi.StateMoveHistoryEntries", num_states,
+      [&](int i) { c_state.state = const_cast<hle::HanabiState*>(&states[i]); },
+      [&](int) {
+        sink += StateMoveHistoryEntries(&c_state, 0, entries.size(),
+                                        entries.data());
+      });
+
+  hanabi_bench::DoNotOptimize(sink);
+  results->insert(results->end(), meter.Results().begin(),
+                  meter.Results().end());
+}
+
+std::vector<int> ParseIntList(const std::string& value) {
+  std::vector<int> result;
+  std::stringstream stream(value);
+  std::string item;
+  while (std::getline(stream, item, ',')) {
+    result.push_back(std::stoi(item));
+  }
+  return result;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  std::vector<int> players = {2, 3, 4, 5};
+  bool check = false;
+  for (int i = 1; i < argc; ++i) {
+    std::string param = argv[i];
+    if (param.compare(0, 10, "--players=") == 0) {
+      players = ParseIntList(param.substr(10));
+    } else if (param == "--check") {
+      check = true;
+    } else {
+      std::cerr << "Unknown argument " << argv[i] << "\n";
+      return 1;
+    }
+  }
+  if (!hle::AllocAccountingEnabled()) {
+    std::cerr << "alloc_bench needs a build with "
+                 "-DHANABI_ALLOC_ACCOUNTING=ON\n";
+    return check ? 1 : 0;
+  }
+
+  std::vector<AllocResult> results;
+  for (int num_players : players) {
+    MeasurePlayers(num_players, &results);
+  }
+  bool within_budget = true;
+  std::printf("%-34s %8s %14s %14s %10s\n", "operation", "players",
+              "allocs/call", "bytes/call", "budget");
+  for (const auto& result : results) {
+    double budget =
+        kBudgets.at(result.name).at(result.players - kMinBudgetPlayers);
+    bool over = result.allocations > budget;
+    within_budget &= !over;
+    std::printf("%-34s %8d %14.2f %14.1f %10.2f%s\n", result.name.c_str(),
+                result.players, result.allocations, result.bytes, budget,
+                over ? "  OVER BUDGET" : "");
+  }
+  return check && !within_budget ? 1 : 0;
+}
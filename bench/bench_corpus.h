@@ -0,0 +1,79 @@
+// Copyright 2018 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+// Fixed benchmark inputs: positions from seeded random self-play games.
+
+#ifndef __BENCH_CORPUS_H__
+#define __BENCH_CORPUS_H__
+
+#include <vector>
+
+#include "game_record.h"
+#include "hanabi_game.h"
+#include "hanabi_move.h"
+#include "hanabi_observation.h"
+#include "hanabi_policy.h"
+#include "hanabi_rng.h"
+#include "hanabi_state.h"
+
+namespace hanabi_bench {
+
+struct Corpus {
+  std::vector<hanabi_learning_env::GameRecord> games;
+  // Positions where a player is to act, with the move that was played.
+  std::vector<hanabi_learning_env::HanabiState> player_states;
+  std::vector<hanabi_learning_env::HanabiMove> player_moves;
+  // Positions where a card is to be dealt.
+  std::vector<hanabi_learning_env::HanabiState> chance_states;
+  // Observations of the acting player at player_states.
+  std::vector<hanabi_learning_env::HanabiObservation> observations;
+  // Same, including the observer's own cards, as needed by the
+  // auxiliary-task encoders.
+  std::vector<hanabi_learning_env::HanabiObservation> full_observations;
+};
+
+// Game g is played from HanabiRng(0, 0, g), so the corpus only depends on
+// the game parameters.
+inline Corpus BuildCorpus(const hanabi_learning_env::HanabiGame& game,
+                          int num_games = 64) {
+  namespace hle = hanabi_learning_env;
+  Corpus corpus;
+  hle::RandomPolicy policy;
+  for (int g = 0; g < num_games; ++g) {
+    hle::HanabiRng rng(0, 0, g);
+    hle::HanabiState state(&game, rng);
+    hle::HanabiRng policy_rng = rng.Fork(1);
+    while (!state.IsTerminal()) {
+      if (state.CurPlayer() == hle::kChancePlayerId) {
+        corpus.chance_states.push_back(state);
+        state.ApplyRandomChance();
+        continue;
+      }
+      corpus.player_states.push_back(state);
+      hle::HanabiObservation obs(state, state.CurPlayer());
+      corpus.observations.push_back(obs);
+      corpus.full_observations.emplace_back(state, state.CurPlayer(), true);
+      hle::HanabiMove move = policy.Act(obs, &policy_rng);
+      corpus.player_moves.push_back(move);
+      state.ApplyMove(move);
+    }
+    corpus.games.push_back(hle::GameRecord::FromState(state, 0));
+  }
+  return corpus;
+}
+
+}  // namespace hanabi_bench
+
+#endif
@@ -0,0 +1,189 @@
+// Copyright 2018 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+// Minimal benchmark harness shared by the benchmark binaries.
+//
+// A benchmark is a callable that performs a batch of operations and returns
+// how many it performed. The runner calls it until the time budget of a
+// repetition is spent, repeats, and keeps the median repetition. Results
+// are printed as a table and can be written as JSON for regression tracking.
+// With hardware counters attached, each result also reports counts per
+// operation for its repetition.
+
+#ifndef __BENCH_HARNESS_H__
+#define __BENCH_HARNESS_H__
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "perf_counters.h"
+
+namespace hanabi_bench {
+
+// Keeps the compiler from discarding a computed value.
+template <typename T>
+inline void DoNotOptimize(const T& value) {
+  asm volatile("" : : "r,m"(value) : "memory");
+}
+
+using Labels = std::map<std::string, std::string>;
+
+struct BenchResult {
+  std::string name;
+  Labels labels;
+  int64_t ops = 0;         // Operations in the reported repetition.
+  double seconds = 0;      // Wall-clock time of the reported repetition.
+  // Additional per-operation metrics, e.g. hardware counters.
+  std::map<std::string, double> metrics;
+
+  double NsPerOp() const { return ops > 0 ? seconds * 1e9 / ops : 0; }
+  double OpsPerSec() const { return seconds > 0 ? ops / seconds : 0; }
+};
+
+class BenchRunner {
+ public:
+  BenchRunner(double min_time, int repetitions, const std::string& filter)
+      : min_time_(min_time), repetitions_(repetitions), filter_(filter) {}
+
+  // Reads counters around every repetition. Not owned; may be null.
+  void SetCounters(const PerfCounters* counters) { counters_ = counters; }
+
+  bool Enabled(const std::string& name) const {
+    return filter_.empty() || name.find(filter_) != std::string::npos;
+  }
+
+  // batch() performs some operations and returns how many.
+  template <typename F>
+  void RunBatch(const std::string& name, const Labels& labels, F batch) {
+    if (!Enabled(name)) {
+      return;
+    }
+    batch();  // Warm up caches and lazily built tables.
+    std::vector<BenchResult> reps;
+    for (int r = 0; r < repetitions_; ++r) {
+      BenchResult rep;
+      CounterValues start_counts;
+      if (counters_ != nullptr) {
+        start_counts = counters_->Read();
+      }
+      auto start = Clock::now();
+      double elapsed = 0;
+      do {
+        rep.ops += batch();
+        elapsed = std::chrono::duration<double>(Clock::now() - start).count();
+      } while (elapsed < min_time_ / repetitions_);
+      rep.seconds = elapsed;
+      if (counters_ != nullptr) {
+        rep.metrics =
+            PerfCounters::PerOp(start_counts, counters_->Read(), rep.ops);
+      }
+      reps.push_back(rep);
+    }
+    std::sort(reps.begin(), reps.end(),
+              [](const BenchResult& a, const BenchResult& b) {
+                return a.NsPerOp() < b.NsPerOp();
+              });
+    BenchResult result = reps[reps.size() / 2];
+    result.name = name;
+    result.labels = labels;
+    results_.push_back(result);
+  }
+
+  // op(i) performs the i-th operation.
+  template <typename F>
+  void Run(const std::string& name, const Labels& labels, F op,
+           int64_t batch_size = 64) {
+    int64_t next = 0;
+    RunBatch(name, labels, [&] {
+      for (int64_t i = 0; i < batch_size; ++i) {
+        op(next++);
+      }
+      return batch_size;
+    });
+  }
+
+  // Adds a result measured by the caller, e.g. a multi-threaded run.
+  void AddResult(const BenchResult& result) { results_.push_back(result); }
+
+  const std::vector<BenchResult>& Results() const { return results_; }
+
+  void PrintTable(FILE* out) const {
+    std::fprintf(out, "%-32s %-36s %14s %14s\n", "benchmark", "labels",
+                 "ns/op", "ops/s");
+    for (const auto& result : results_) {
+      std::string labels;
+      for (const auto& label : result.labels) {
+        labels += (labels.empty() ? "" : ",") + label.first + "=" +
+                  label.second;
+      }
+      std::fprintf(out, "%-32s %-36s %14.1f %14.0f", result.name.c_str(),
+                   labels.c_str(), result.NsPerOp(), result.OpsPerSec());
+      for (const auto& metric : result.metrics) {
+        std::fprintf(out, " %s=%.2f", metric.first.c_str(), metric.second);
+      }
+      std::fprintf(out, "\n");
+    }
+  }
+
+  void WriteJson(FILE* out, const Labels& context) const {
+    std::fprintf(out, "{\n  \"context\": {");
+    WriteLabels(out, context);
+    std::fprintf(out, "},\n  \"benchmarks\": [");
+    for (int i = 0; i < results_.size(); ++i) {
+      const auto& result = results_[i];
+      std::fprintf(out, "%s\n    {\"name\": \"%s\", \"labels\": {",
+                   i == 0 ? "" : ",", result.name.c_str());
+      WriteLabels(out, result.labels);
+      std::fprintf(out,
+                   "}, \"ops\": %lld, \"seconds\": %.6f, \"ns_per_op\": %.3f, "
+                   "\"ops_per_sec\": %.1f",
+                   static_cast<long long>(result.ops), result.seconds,
+                   result.NsPerOp(), result.OpsPerSec());
+      for (const auto& metric : result.metrics) {
+        std::fprintf(out, ", \"%s\": %.4f", metric.first.c_str(),
+                     metric.second);
+      }
+      std::fprintf(out, "}");
+    }
+    std::fprintf(out, "\n  ]\n}\n");
+  }
+
+ private:
+  using Clock = std::chrono::steady_clock;
+
+  static void WriteLabels(FILE* out, const Labels& labels) {
+    bool first = true;
+    for (const auto& label : labels) {
+      std::fprintf(out, "%s\"%s\": \"%s\"", first ? "" : ", ",
+                   label.first.c_str(), label.second.c_str());
+      first = false;
+    }
+  }
+
+  double min_time_;
+  int repetitions_;
+  std::string filter_;
+  const PerfCounters* counters_ = nullptr;
+  std::vector<BenchResult> results_;
+};
+
+}  // namespace hanabi_bench
+
+#endif
@@ -0,0 +1,321 @@
+// Copyright 2018 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+// Micro-benchmarks for the engine's hot paths.
+//
+//   hanabi_bench [--players=2,3,4,5] [--min_time=0.5] [--repetitions=5]
+//       [--filter=SUBSTRING] [--json=FILE] [--counters]
+//
+// Inputs are positions sampled from random self-play games with a fixed
+// seed, so every run measures the same work. --counters adds hardware
+// counts per operation (cycles, instructions, cache and branch misses).
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <numeric>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "bench_corpus.h"
+#include "bench_harness.h"
+#include "canonical_encoders.h"
+#include "game_record.h"
+#include "hanabi_game.h"
+#include "hanabi_observation.h"
+#include "hanabi_state.h"
+#include "prioritized_replay.h"
+
+namespace hle = hanabi_learning_env;
+
+namespace {
+
+struct BenchOptions {
+  std::vector<int> players = {2, 3, 4, 5};
+  double min_time = 0.5;
+  int repetitions = 5;
+  std::string filter;
+  std::string json;
+  bool counters = false;
+};
+
+void BenchPlayers(int num_players, hanabi_bench::BenchRunner* runner) {
+  hle::HanabiGame game({{"players", std::to_string(num_players)},
+                        {"seed", "0"}});
+  const hanabi_bench::Corpus corpus = hanabi_bench::BuildCorpus(game);
+  const hanabi_bench::Labels labels = {{"players",
+                                        std::to_string(num_players)}};
+  const auto& states = corpus.player_states;
+  const auto& observations = corpus.observations;
+  const auto& full_observations = corpus.full_observations;
+  hle::CanonicalObservationEncoder encoder(&game);
+  const std::vector<int> no_order;
+
+  // Replays whole games, so each op is one ApplyMove (deal or player move).
+  runner->RunBatch("ApplyMove", labels, [&] {
+    int64_t ops = 0;
+    for (const auto& record : corpus.games) {
+      hle::HanabiState state(&game, hle::HanabiRng(), record.start_player);
+      int next_card = 0;
+      int next_move = 0;
+      while (!state.IsTerminal()) {
+        if (state.CurPlayer() == hle::kChancePlayerId) {
+          int index = record.dealt[next_card++];
+          state.ApplyMove(hle::HanabiMove(hle::HanabiMove::kDeal, -1, -1,
+                                          index / game.NumRanks(),
+                                          index % game.NumRanks()));
+        } else {
+          state.ApplyMove(game.GetMove(record.moves[next_move++]));
+        }
+        ++ops;
+      }
+      hanabi_bench::DoNotOptimize(state.Score());
+    }
+    return ops;
+  });
+  runner->Run("LegalMoves", labels, [&](int64_t i) {
+    const auto& state = states[i % states.size()];
+    hanabi_bench::DoNotOptimize(state.LegalMoves(state.CurPlayer()).size());
+  });
+  // One op checks every move uid of the game.
+  runner->Run("MoveIsLegal", labels, [&](int64_t i) {
+    const auto& state = states[i % states.size()];
+    int legal = 0;
+    for (int uid = 0; uid < game.MaxMoves(); ++uid) {
+      legal += state.MoveIsLegal(game.GetMove(uid));
+    }
+    hanabi_bench::DoNotOptimize(legal);
+  });
+  runner->Run("ChanceOutcomes", labels, [&](int64_t i) {
+    const auto& state = corpus.chance_states[i % corpus.chance_states.size()];
+    hanabi_bench::DoNotOptimize(state.ChanceOutcomes().second.size());
+  });
+  runner->Run("CopyAndDealRandomCard", labels, [&](int64_t i) {
+    hle::HanabiState state =
+        corpus.chance_states[i % corpus.chance_states.size()];
+    state.ApplyRandomChance();
+    hanabi_bench::DoNotOptimize(state.Deck().Size());
+  });
+  runner->Run("StateCopy", labels, [&](int64_t i) {
+    hle::HanabiState state = states[i % states.size()];
+    hanabi_bench::DoNotOptimize(state.CurPlayer());
+  });
+  runner->Run("HanabiObservation", labels, [&](int64_t i) {
+    const auto& state = states[i % states.size()];
+    hle::HanabiObservation obs(state, state.CurPlayer());
+    hanabi_bench::DoNotOptimize(obs.LegalMoves().size());
+  });
+  runner->Run("Encode", labels, [&](int64_t i) {
+    hanabi_bench::DoNotOptimize(
+        encoder
+            .Encode(observations[i % observations.size()], false, no_order,
+                    false, {}, {}, false)
+            .data());
+  });
+  // Eight color permutations of one observation, re-encoded and gathered.
+  std::vector<std::vector<int>> permutations;
+  std::vector<std::vector<int>> inv_permutations;
+  std::vector<std::vector<int>> gathers;
+  std::vector<int> permutation(game.NumColors());
+  std::iota(permutation.begin(), permutation.end(), 0);
+  for (int k = 0; k < 8; ++k) {
+    std::next_permutation(permutation.begin(), permutation.end());
+    std::vector<int> inverse(game.NumColors());
+    for (int c = 0; c < game.NumColors(); ++c) {
+      inverse[permutation[c]] = c;
+    }
+    permutations.push_back(permutation);
+    inv_permutations.push_back(inverse);
+    gathers.push_back(encoder.ColorPermutationGather(permutation));
+  }
+  std::vector<float> permuted(gathers.size() * encoder.EncodingLength());
+  runner->Run("EncodeShuffled8", labels, [&](int64_t i) {
+    for (int k = 0; k < permutations.size(); ++k) {
+      encoder.EncodeInto(observations[i % observations.size()], false,
+                         no_order, true, permutations[k], inv_permutations[k],
+                         false, permuted.data() + k * encoder.EncodingLength());
+    }
+    hanabi_bench::DoNotOptimize(permuted.data());
+  });
+  runner->Run("EncodeColorPermutations8", labels, [&](int64_t i) {
+    encoder.EncodeColorPermutations(observations[i % observations.size()],
+                                    false, no_order, false, gathers,
+                                    permuted.data());
+    hanabi_bench::DoNotOptimize(permuted.data());
+  });
+  runner->Run("EncodeLastAction", labels, [&](int64_t i) {
+    hanabi_bench::DoNotOptimize(
+        encoder
+            .EncodeLastAction(observations[i % observations.size()],
+                              no_order, false, {})
+            .data());
+  });
+  runner->Run("EncodeOwnHandTrinary", labels, [&](int64_t i) {
+    hanabi_bench::DoNotOptimize(
+        encoder.EncodeOwnHandTrinary(
+            full_observations[i % full_observations.size()])
+            .data());
+  });
+  runner->Run("EncodeOwnHand", labels, [&](int64_t i) {
+    hanabi_bench::DoNotOptimize(
+        encoder
+            .EncodeOwnHand(full_observations[i % full_observations.size()],
+                           false, {})
+            .data());
+  });
+  runner->Run("EncodeAllHand", labels, [&](int64_t i) {
+    hanabi_bench::DoNotOptimize(
+        encoder
+            .EncodeAllHand(full_observations[i % full_observations.size()],
+                           false, {})
+            .data());
+  });
+  runner->Run("EncodeFullState", labels, [&](int64_t i) {
+    hanabi_bench::DoNotOptimize(
+        encoder
+            .EncodeFullState(full_observations[i % full_observations.size()],
+                             no_order, false, {}, {}, false)
+            .size());
+  });
+  // The joint encoding only supports hidden last actions.
+  runner->Run("EncodeJointFivePlayers", labels, [&](int64_t i) {
+    hanabi_bench::DoNotOptimize(
+        encoder
+            .EncodeJointFivePlayers(observations[i % observations.size()],
+                                    false, no_order, false, {}, {}, true)
+            .data());
+  });
+  runner->Run("ComputeCardCount", labels, [&](int64_t i) {
+    hanabi_bench::DoNotOptimize(
+        hle::ComputeCardCount(game, observations[i % observations.size()],
+                              false, {}, false)
+            .data());
+  });
+
+  // A full replay memory of packed corpus observations, sampled and updated
+  // in learner-sized batches of 32.
+  const int kReplayCapacity = 100000;
+  const int kReplayBatch = 32;
+  hle::PrioritizedReplayMemory replay(game.MaxMoves(), encoder.EncodingLength(),
+                                      1, kReplayCapacity, 1, 0.99, 0);
+  std::vector<float> encoding(encoder.EncodingLength());
+  std::vector<uint8_t> packed(replay.ObservationBytes());
+  std::vector<uint8_t> legal(replay.LegalActionBytes(), 0xff);
+  for (int i = 0; i < kReplayCapacity; ++i) {
+    encoder.EncodeInto(observations[i % observations.size()], false,
+                       no_order, false, {}, {}, false, encoding.data());
+    std::fill(packed.begin(), packed.end(), 0);
+    for (int j = 0; j < encoding.size(); ++j) {
+      packed[j / 8] |= (encoding[j] > 0) << (7 - j % 8);
+    }
+    replay.Add(packed.data(), 0, 0, i % 60 == 59, legal.data());
+  }
+  const int stack_bytes = encoder.EncodingLength();
+  std::vector<uint8_t> replay_states(kReplayBatch * stack_bytes);
+  std::vector<uint8_t> replay_next_states(kReplayBatch * stack_bytes);
+  std::vector<int32_t> actions(kReplayBatch);
+  std::vector<int32_t> indices(kReplayBatch);
+  std::vector<float> rewards(kReplayBatch);
+  std::vector<uint8_t> terminals(kReplayBatch);
+  std::vector<float> next_legal(kReplayBatch * game.MaxMoves());
+  hle::ReplayBatch batch = {replay_states.data(), actions.data(),
+                            rewards.data(), replay_next_states.data(),
+                            terminals.data(), indices.data(),
+                            next_legal.data()};
+  runner->Run("ReplaySampleTransitions32", labels, [&](int64_t) {
+    hanabi_bench::DoNotOptimize(
+        replay.SampleTransitionBatch(kReplayBatch, nullptr, batch));
+  });
+  std::vector<float> priorities(kReplayBatch);
+  runner->Run("ReplaySetPriorities32", labels, [&](int64_t i) {
+    for (int k = 0; k < kReplayBatch; ++k) {
+      priorities[k] = 1 + (i + k) % 7;
+    }
+    replay.SetPriorities(kReplayBatch, indices.data(), priorities.data());
+  });
+}
+
+std::vector<int> ParseIntList(const std::string& value) {
+  std::vector<int> result;
+  std::stringstream stream(value);
+  std::string item;
+  while (std::getline(stream, item, ',')) {
+    result.push_back(std::stoi(item));
+  }
+  return result;
+}
+
+BenchOptions ParseArguments(int argc, char** argv) {
+  BenchOptions options;
+  for (int i = 1; i < argc; ++i) {
+    std::string param = argv[i];
+    std::string value;
+    auto value_pos = param.find("=");
+    if (value_pos != std::string::npos) {
+      value = param.substr(value_pos + 1, std::string::npos);
+      param = param.substr(0, value_pos);
+    }
+    if (param == "--players") {
+      options.players = ParseIntList(value);
+    } else if (param == "--min_time") {
+      options.min_time = std::stod(value);
+    } else if (param == "--repetitions") {
+      options.repetitions = std::stoi(value);
+    } else if (param == "--filter") {
+      options.filter = value;
+    } else if (param == "--json") {
+      options.json = value;
+    } else if (param == "--counters") {
+      options.counters = true;
+    } else {
+      std::cerr << "Unknown argument " << argv[i] << "\n";
+      std::exit(1);
+    }
+  }
+  return options;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  BenchOptions options = ParseArguments(argc, argv);
+  hanabi_bench::BenchRunner runner(options.min_time, options.repetitions,
+                                   options.filter);
+  hanabi_bench::PerfCounters counters;
+  if (options.counters) {
+    if (counters.Available()) {
+      runner.SetCounters(&counters);
+    } else {
+      std::cerr << "Hardware counters are unavailable; reporting time only\n";
+    }
+  }
+  for (int num_players : options.players) {
+    BenchPlayers(num_players, &runner);
+  }
+  runner.PrintTable(stdout);
+  if (!options.json.empty()) {
+    FILE* out = std::fopen(options.json.c_str(), "w");
+    if (out == nullptr) {
+      std::cerr << "Cannot write " << options.json << "\n";
+      return 1;
+    }
+    runner.WriteJson(out, {{"benchmark", "hanabi_bench"},
+                           {"min_time", std::to_string(options.min_time)}});
+    std::fclose(out);
+  }
+  return 0;
+}
@@ -0,0 +1,154 @@
+// Copyright 2018 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+// Hardware performance counters for the benchmark binaries.
+//
+// On Linux, PerfCounters opens cycles, instructions, L1 data cache read
+// misses, last-level cache misses and branch misses through
+// perf_event_open(2) for the calling thread and any threads it creates
+// afterwards. User-space events only are counted, which the default
+// perf_event_paranoid setting allows. Events the kernel or CPU does not
+// support (e.g. in many VMs and containers) are left out; elsewhere none
+// are available.
+
+#ifndef __PERF_COUNTERS_H__
+#define __PERF_COUNTERS_H__
+
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace hanabi_bench {
+
+// Counter name to count.
+using CounterValues = std::map<std::string, double>;
+
+class PerfCounters {
+ public:
+  PerfCounters() {
+#ifdef __linux__
+    Open("cycles", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES);
+    Open("instructions", PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS);
+    Open("l1d_misses", PERF_TYPE_HW_CACHE,
+         PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+             (PERF_COUNT_HW_CACHE_RESULT_MISS << 16));
+    Open("llc_misses", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES);
+    Open("branch_misses", PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES);
+#endif
+  }
+
+  ~PerfCounters() {
+#ifdef __linux__
+    for (const auto& counter : counters_) {
+      close(counter.fd);
+    }
+#endif
+  }
+
+  PerfCounters(const PerfCounters&) = delete;
+  PerfCounters& operator=(const PerfCounters&) = delete;
+
+  bool Available() const { return !counters_.empty(); }
+
+  // Names of the counters that could be opened.
+  std::vector<std::string> Names() const {
+    std::vector<std::string> names;
+    for (const auto& counter : counters_) {
+      names.push_back(counter.name);
+    }
+    return names;
+  }
+
+  // Current counts. Counters that the kernel multiplexed are scaled to the
+  // full time they were enabled.
+  CounterValues Read() const {
+    CounterValues values;
+#ifdef __linux__
+    for (const auto& counter : counters_) {
+      uint64_t data[3];  // value, time_enabled, time_running.
+      if (read(counter.fd, data, sizeof(data)) != sizeof(data)) {
+        continue;
+      }
+      double value = data[0];
+      if (data[2] > 0 && data[2] < data[1]) {
+        value *= static_cast<double>(data[1]) / data[2];
+      }
+      values[counter.name] = value;
+    }
+#endif
+    return values;
+  }
+
+  // Per-operation metrics from two readings, plus instructions per cycle.
+  static std::map<std::string, double> PerOp(const CounterValues& start,
+                                             const CounterValues& end,
+                                             int64_t ops) {
+    std::map<std::string, double> metrics;
+    if (ops <= 0) {
+      return metrics;
+    }
+    CounterValues delta;
+    for (const auto& value : end) {
+      auto it = start.find(value.first);
+      if (it != start.end()) {
+        delta[value.first] = value.second - it->second;
+        metrics[value.first + "/op"] = delta[value.first] / ops;
+      }
+    }
+    if (delta.count("cycles") && delta.count("instructions") &&
+        delta["cycles"] > 0) {
+      metrics["ipc"] = delta["instructions"] / delta["cycles"];
+    }
+    return metrics;
+  }
+
+ private:
+  struct Counter {
+    std::string name;
+    int fd;
+  };
+
+#ifdef __linux__
+  void Open(const std::string& name, uint32_t type, uint64_t config) {
+    perf_event_attr attr = {};
+    attr.size = sizeof(attr);
+    attr.type = type;
+    attr.config = config;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    attr.inherit = 1;
+    attr.read_format =
+        PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+    int fd = syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+    if (fd >= 0) {
+      counters_.push_back({name, fd});
+    }
+  }
+#endif
+
+  std::vector<Counter> counters_;
+};
+
+}  // namespace hanabi_bench
+
+#endif
@@ -0,0 +1,269 @@
+// Copyright 2018 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+// End-to-end self-play throughput, as seen by an actor.
+//
+//   selfplay_bench [--players=2] [--policies=random,simple]
+//       [--max_threads=N] [--min_time=2] [--json=FILE] [--counters]
+//
+// Every thread plays complete games with its own states and encoder. A step
+// is one player move: choosing the move, applying it, dealing the
+// replacement card and encoding the new observation of every player. The
+// run is repeated at 1, 2, 4, ... max_threads threads, and parallel
+// efficiency is steps/s at t threads divided by t times steps/s at 1 thread.
+// --counters adds hardware counts per step, summed over all threads.
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "bench_harness.h"
+#include "canonical_encoders.h"
+#include "hanabi_game.h"
+#include "hanabi_observation.h"
+#include "hanabi_policy.h"
+#include "hanabi_state.h"
+#include "instrumentation.h"
+
+namespace hle = hanabi_learning_env;
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+struct SelfPlayOptions {
+  int players = 2;
+  std::vector<std::string> policies = {"random", "simple"};
+  int max_threads = std::max(1u, std::thread::hardware_concurrency());
+  double min_time = 2;
+  std::string json;
+  bool counters = false;
+};
+
+struct ThreadStats {
+  int64_t games = 0;
+  int64_t steps = 0;
+  int64_t observations = 0;
+  std::vector<float> step_ns;
+};
+
+void EncodeAll(const hle::HanabiState& state,
+               const hle::CanonicalObservationEncoder& encoder,
+               ThreadStats* stats) {
+  for (int p = 0; p < state.ParentGame()->NumPlayers(); ++p) {
+    hle::HanabiObservation obs(state, p);
+    hanabi_bench::DoNotOptimize(
+        encoder.Encode(obs, false, {}, false, {}, {}, false).data());
+    ++stats->observations;
+  }
+}
+
+void DealCards(hle::HanabiState* state) {
+  while (state->CurPlayer() == hle::kChancePlayerId && !state->IsTerminal()) {
+    state->ApplyRandomChance();
+  }
+}
+
+void SelfPlayThread(const hle::HanabiGame& game, const std::string& policy,
+                    int thread_id, const std::atomic<bool>& stop,
+                    ThreadStats* stats) {
+  std::unique_ptr<hle::HanabiPolicy> agent = hle::MakePolicy(policy);
+  hle::CanonicalObservationEncoder encoder(&game);
+  while (!stop.load(std::memory_order_relaxed)) {
+    hle::HanabiState state(&game, hle::HanabiRng(0, thread_id, stats->games));
+    hle::HanabiRng policy_rng = state.Rng().Fork(1);
+    DealCards(&state);
+    EncodeAll(state, encoder, stats);
+    while (!state.IsTerminal()) {
+      auto start = Clock::now();
+      hle::HanabiObservation obs(state, state.CurPlayer());
+      state.ApplyMove(agent->Act(obs, &policy_rng));
+      DealCards(&state);
+      EncodeAll(state, encoder, stats);
+      stats->step_ns.push_back(
+          std::chrono::duration<float, std::nano>(Clock::now() - start)
+              .count());
+      ++stats->steps;
+    }
+    ++stats->games;
+  }
+}
+
+float Percentile(std::vector<float>* values, double fraction) {
+  if (values->empty()) {
+    return 0;
+  }
+  auto nth = values->begin() + static_cast<size_t>(fraction *
+                                                   (values->size() - 1));
+  std::nth_element(values->begin(), nth, values->end());
+  return *nth;
+}
+
+hanabi_bench::BenchResult RunSelfPlay(
+    const hle::HanabiGame& game, const std::string& policy, int num_threads,
+    double min_time, const hanabi_bench::PerfCounters* counters) {
+  std::vector<ThreadStats> stats(num_threads);
+  std::atomic<bool> stop(false);
+  std::vector<std::thread> threads;
+  // The counters are inherited by the threads and include their counts
+  // once they have exited.
+  hanabi_bench::CounterValues start_counts;
+  if (counters != nullptr) {
+    start_counts = counters->Read();
+  }
+  auto start = Clock::now();
+  for (int t = 0; t < num_threads; ++t) {
+    threads.emplace_back(SelfPlayThread, std::cref(game), std::cref(policy),
+                         t, std::cref(stop), &stats[t]);
+  }
+  std::this_thread::sleep_for(std::chrono::duration<double>(min_time));
+  stop = true;
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+  hanabi_bench::CounterValues end_counts;
+  if (counters != nullptr) {
+    end_counts = counters->Read();
+  }
+
+  ThreadStats total;
+  for (auto& thread_stats : stats) {
+    total.games += thread_stats.games;
+    total.steps += thread_stats.steps;
+    total.observations += thread_stats.observations;
+    total.step_ns.insert(total.step_ns.end(), thread_stats.step_ns.begin(),
+                         thread_stats.step_ns.end());
+  }
+  hanabi_bench::BenchResult result;
+  result.name = "SelfPlay";
+  result.labels = {{"policy", policy},
+                   {"players", std::to_string(game.NumPlayers())},
+                   {"threads", std::to_string(num_threads)}};
+  result.ops = total.steps;
+  result.seconds = seconds;
+  result.metrics =
+      hanabi_bench::PerfCounters::PerOp(start_counts, end_counts, total.steps);
+  result.metrics["games_per_sec"] = total.games / seconds;
+  result.metrics["steps_per_sec"] = total.steps / seconds;
+  result.metrics["obs_per_sec"] = total.observations / seconds;
+  result.metrics["step_p50_us"] = Percentile(&total.step_ns, 0.5) / 1000;
+  result.metrics["step_p99_us"] = Percentile(&total.step_ns, 0.99) / 1000;
+  return result;
+}
+
+std::vector<std::string> ParseList(const std::string& value) {
+  std::vector<std::string> result;
+  std::stringstream stream(value);
+  std::string item;
+  while (std::getline(stream, item, ',')) {
+    result.push_back(item);
+  }
+  return result;
+}
+
+SelfPlayOptions ParseArguments(int argc, char** argv) {
+  SelfPlayOptions options;
+  for (int i = 1; i < argc; ++i) {
+    std::string param = argv[i];
+    std::string value;
+    auto value_pos = param.find("=");
+    if (value_pos != std::string::npos) {
+      value = param.substr(value_pos + 1, std::string::npos);
+      param = param.substr(0, value_pos);
+    }
+    if (param == "--players") {
+      options.players = std::stoi(value);
+    } else if (param == "--policies") {
+      options.policies = ParseList(value);
+    } else if (param == "--max_threads") {
+      options.max_threads = std::stoi(value);
+    } else if (param == "--min_time") {
+      options.min_time = std::stod(value);
+    } else if (param == "--json") {
+      options.json = value;
+    } else if (param == "--counters") {
+      options.counters = true;
+    } else {
+      std::cerr << "Unknown argument " << argv[i] << "\n";
+      std::exit(1);
+    }
+  }
+  return options;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  SelfPlayOptions options = ParseArguments(argc, argv);
+  for (const auto& policy : options.policies) {
+    if (!hle::MakePolicy(policy)) {
+      std::cerr << "Unknown policy " << policy << "\n";
+      return 1;
+    }
+  }
+  hle::HanabiGame game({{"players", std::to_string(options.players)},
+                        {"seed", "0"}});
+  std::vector<int> thread_counts;
+  for (int t = 1; t < options.max_threads; t *= 2) {
+    thread_counts.push_back(t);
+  }
+  thread_counts.push_back(options.max_threads);
+
+  hanabi_bench::PerfCounters counters;
+  if (options.counters && !counters.Available()) {
+    std::cerr << "Hardware counters are unavailable; reporting time only\n";
+  }
+  const hanabi_bench::PerfCounters* used_counters =
+      options.counters && counters.Available() ? &counters : nullptr;
+
+  hanabi_bench::BenchRunner runner(options.min_time, 1, "");
+  for (const auto& policy : options.policies) {
+    double single_thread_rate = 0;
+    for (int num_threads : thread_counts) {
+      auto result =
+          RunSelfPlay(game, policy, num_threads, options.min_time,
+                      used_counters);
+      if (num_threads == 1) {
+        single_thread_rate = result.OpsPerSec();
+      }
+      result.metrics["efficiency"] =
+          result.OpsPerSec() / (num_threads * single_thread_rate);
+      runner.AddResult(result);
+    }
+  }
+  runner.PrintTable(stdout);
+  if (hle::InstrumentationEnabled()) {
+    std::printf("\n%s", hle::InstrumentationReport(false).c_str());
+  }
+  if (!options.json.empty()) {
+    FILE* out = std::fopen(options.json.c_str(), "w");
+    if (out == nullptr) {
+      std::cerr << "Cannot write " << options.json << "\n";
+      return 1;
+    }
+    runner.WriteJson(out, {{"benchmark", "selfplay_bench"},
+                           {"min_time", std::to_string(options.min_time)}});
+    std::fclose(out);
+  }
+  return 0;
+}
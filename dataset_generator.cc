@@ -0,0 +1,160 @@
+// Copyright 2018 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+// Generates a sharded step dataset (see hanabi_lib/dataset_writer.h) either by
+// playing games with a built-in policy or by replaying a game-record file.
+//
+//   dataset_generator --out_dir=data --num_games=100000 --policy=random
+//       --config.hanabi.players=2
+//   dataset_generator --out_dir=data --records=games.hrec --config_id=0
+//       --config.hanabi.players=2
+//
+// Only records with the given config id (default 0) are replayed, since the
+// game is built from --config.hanabi.*; the id is written to index.json.
+//
+// Generated game g is played from HanabiRng(seed, 0, g), so the output does
+// not depend on the number of threads.
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "dataset_writer.h"
+#include "game_record.h"
+#include "hanabi_game.h"
+#include "hanabi_policy.h"
+
+constexpr const char* kGameParamArgPrefix = "--config.hanabi.";
+
+struct GeneratorOptions {
+  std::string out_dir;
+  std::string records;
+  std::string policy = "random";
+  int64_t num_games = 10000;
+  int games_per_shard = 10000;
+  int num_threads = std::max(1u, std::thread::hardware_concurrency());
+  uint64_t seed = 0;
+  int config_id = 0;
+};
+
+void GenerateDataset(
+    const std::unordered_map<std::string, std::string>& game_params,
+    const GeneratorOptions& options) {
+  hanabi_learning_env::HanabiGame game(game_params);
+  std::unique_ptr<hanabi_learning_env::GameRecordReader> reader;
+  // Indices of the records played with game.
+  std::vector<int64_t> record_indices;
+  int64_t num_games = options.num_games;
+  if (!options.records.empty()) {
+    reader.reset(new hanabi_learning_env::GameRecordReader(options.records));
+    for (int64_t i = 0; i < reader->NumRecords(); ++i) {
+      if (reader->ConfigId(i) == options.config_id) {
+        record_indices.push_back(i);
+      }
+    }
+    if (record_indices.size() < reader->NumRecords()) {
+      std::cout << "Skipping " << reader->NumRecords() - record_indices.size()
+                << " records of other config ids\n";
+    }
+    num_games = std::min<int64_t>(num_games, record_indices.size());
+  }
+  auto get_game = [&](int64_t episode) {
+    if (reader != nullptr) {
+      return reader->Get(record_indices[episode]);
+    }
+    std::vector<std::unique_ptr<hanabi_learning_env::HanabiPolicy>> owned;
+    std::vector<hanabi_learning_env::HanabiPolicy*> policies;
+    for (int p = 0; p < game.NumPlayers(); ++p) {
+      owned.push_back(hanabi_learning_env::MakePolicy(options.policy));
+      policies.push_back(owned.back().get());
+    }
+    auto state = hanabi_learning_env::PlayGame(
+        &game, policies,
+        hanabi_learning_env::HanabiRng(options.seed, 0, episode));
+    return hanabi_learning_env::GameRecord::FromState(state,
+                                                      options.config_id);
+  };
+  auto shards = hanabi_learning_env::WriteDataset(
+      game, options.out_dir, num_games, options.games_per_shard,
+      options.num_threads, get_game, options.config_id);
+
+  int64_t num_steps = 0;
+  for (const auto& shard : shards) {
+    num_steps += shard.num_steps;
+  }
+  std::cout << "Wrote " << num_games << " games, " << num_steps
+            << " steps in " << shards.size() << " shards to "
+            << options.out_dir << "\n";
+}
+
+void ParseArguments(int argc, char** argv,
+                    std::unordered_map<std::string, std::string>* game_params,
+                    GeneratorOptions* options) {
+  const auto prefix_len = strlen(kGameParamArgPrefix);
+  for (int i = 1; i < argc; ++i) {
+    std::string param = argv[i];
+    std::string value;
+    auto value_pos = param.find("=");
+    if (value_pos != std::string::npos) {
+      value = param.substr(value_pos + 1, std::string::npos);
+      param = param.substr(0, value_pos);
+    }
+    if (param.compare(0, prefix_len, kGameParamArgPrefix) == 0 &&
+        param.size() > prefix_len) {
+      (*game_params)[param.substr(prefix_len, std::string::npos)] = value;
+    } else if (param == "--out_dir") {
+      options->out_dir = value;
+    } else if (param == "--records") {
+      options->records = value;
+    } else if (param == "--policy") {
+      options->policy = value;
+    } else if (param == "--num_games") {
+      options->num_games = std::stoll(value);
+    } else if (param == "--games_per_shard") {
+      options->games_per_shard = std::stoi(value);
+    } else if (param == "--num_threads") {
+      options->num_threads = std::stoi(value);
+    } else if (param == "--seed") {
+      options->seed = std::stoull(value);
+    } else if (param == "--config_id") {
+      options->config_id = std::stoi(value);
+    } else {
+      std::cerr << "Unknown argument " << argv[i] << "\n";
+      std::exit(1);
+    }
+  }
+}
+
+int main(int argc, char** argv) {
+  std::unordered_map<std::string, std::string> game_params;
+  GeneratorOptions options;
+  ParseArguments(argc, argv, &game_params, &options);
+  if (options.out_dir.empty()) {
+    std::cerr << "--out_dir is required\n";
+    return 1;
+  }
+  if (options.records.empty() &&
+      !hanabi_learning_env::MakePolicy(options.policy)) {
+    std::cerr << "Unknown policy " << options.policy << "\n";
+    return 1;
+  }
+  GenerateDataset(game_params, options);
+  return 0;
+}
@@ -0,0 +1,252 @@
+// Copyright 2018 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include "actor_pipeline.h"
+
+#include <algorithm>
+#include <chrono>
+#include <thread>
+
+#include "hanabi_observation.h"
+#include "util.h"
+
+namespace hanabi_learning_env {
+
+namespace {
+
+// Value of Batch::claimed while the Run() thread is flushing the batch.
+constexpr int32_t kSealed = 1 << 30;
+
+}  // namespace
+
+SpscIndexQueue::SpscIndexQueue(int capacity) {
+  REQUIRE(capacity > 0);
+  uint64_t size = 1;
+  while (size < static_cast<uint64_t>(capacity)) {
+    size *= 2;
+  }
+  values_.resize(size);
+  mask_ = size - 1;
+}
+
+bool SpscIndexQueue::Push(int32_t value) {
+  const uint64_t tail = tail_.load(std::memory_order_relaxed);
+  if (tail - head_.load(std::memory_order_acquire) > mask_) {
+    return false;
+  }
+  values_[tail & mask_] = value;
+  tail_.store(tail + 1, std::memory_order_release);
+  return true;
+}
+
+bool SpscIndexQueue::Pop(int32_t* value) {
+  const uint64_t head = head_.load(std::memory_order_relaxed);
+  if (head == tail_.load(std::memory_order_acquire)) {
+    return false;
+  }
+  *value = values_[head & mask_];
+  head_.store(head + 1, std::memory_order_release);
+  return true;
+}
+
+ActorPipeline::ActorPipeline(const HanabiGame* game,
+                             const ActorPipelineOptions& options,
+                             ActorInferenceFn inference,
+                             ActorGameEndFn game_end)
+    : game_(game),
+      options_(options),
+      inference_(inference),
+      game_end_(game_end),
+      encoder_(game) {
+  REQUIRE(game_ != nullptr);
+  REQUIRE(inference_);
+  REQUIRE(options_.num_threads > 0);
+  REQUIRE(options_.games_per_thread > 0);
+  REQUIRE(options_.batch_size > 0 && options_.batch_size < kSealed);
+  REQUIRE(options_.timeout_us >= 0);
+  for (Batch& batch : batches_) {
+    batch.observations.resize(static_cast<size_t>(options_.batch_size) *
+                              encoder_.EncodingLength());
+    batch.legal_masks.resize(options_.batch_size * game_->MaxMoves());
+    batch.moves.resize(options_.batch_size);
+    batch.game_ids.resize(options_.batch_size);
+  }
+  games_.resize(options_.num_threads * options_.games_per_thread);
+  for (int i = 0; i < options_.num_threads; ++i) {
+    workers_.emplace_back(new Worker(options_.games_per_thread));
+  }
+  for (int game_id = 0; game_id < NumGames(); ++game_id) {
+    NewEpisode(game_id);
+    workers_[game_id / options_.games_per_thread]->deferred.push_back(
+        game_id);
+  }
+}
+
+ActorPipelineStats ActorPipeline::Run(int64_t num_moves) {
+  REQUIRE(num_moves > 0);
+  for (auto& worker : workers_) {
+    worker->stats = ActorPipelineStats();
+  }
+  stop_.store(false, std::memory_order_release);
+  std::vector<std::thread> threads;
+  for (int i = 0; i < options_.num_threads; ++i) {
+    threads.emplace_back(&ActorPipeline::WorkerThread, this, i);
+  }
+
+  ActorPipelineStats stats;
+  const int batch_size = options_.batch_size;
+  const int max_moves = game_->MaxMoves();
+  const auto timeout = std::chrono::microseconds(options_.timeout_us);
+  while (stats.moves < num_moves) {
+    const int active = active_.load(std::memory_order_relaxed);
+    Batch& batch = batches_[active];
+    bool waiting = false;
+    std::chrono::steady_clock::time_point first_request;
+    while (true) {
+      const int32_t claimed = batch.claimed.load(std::memory_order_acquire);
+      if (claimed >= batch_size) {
+        break;
+      }
+      if (claimed > 0) {
+        const auto now = std::chrono::steady_clock::now();
+        if (!waiting) {
+          waiting = true;
+          first_request = now;
+        } else if (now - first_request >= timeout) {
+          break;
+        }
+      }
+      std::this_thread::yield();
+    }
+
+    // Seal the batch so further claims fail, and send workers to the other
+    // one while this one is evaluated.
+    const int n = std::min(
+        batch.claimed.exchange(kSealed, std::memory_order_acq_rel),
+        batch_size);
+    active_.store(1 - active, std::memory_order_release);
+    while (batch.written.load(std::memory_order_acquire) < n) {
+      std::this_thread::yield();
+    }
+    inference_(n, batch.observations.data(), batch.legal_masks.data(),
+               batch.moves.data());
+    for (int i = 0; i < n; ++i) {
+      const int32_t move = batch.moves[i];
+      REQUIRE(move >= 0 && move < max_moves);
+      REQUIRE(batch.legal_masks[i * max_moves + move]);
+      const int32_t game_id = batch.game_ids[i];
+      games_[game_id].move = move;
+      REQUIRE(workers_[game_id / options_.games_per_thread]->ready.Push(
+          game_id));
+    }
+    stats.moves += n;
+    ++stats.batches;
+    // A worker that read active_ before the swap may claim a slot as soon
+    // as claimed is reset. It then waits here for the next flush.
+    batch.written.store(0, std::memory_order_relaxed);
+    batch.claimed.store(0, std::memory_order_release);
+  }
+
+  stop_.store(true, std::memory_order_release);
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  for (const auto& worker : workers_) {
+    stats.games += worker->stats.games;
+    stats.total_score += worker->stats.total_score;
+  }
+  return stats;
+}
+
+void ActorPipeline::WorkerThread(int worker_id) {
+  Worker* worker = workers_[worker_id].get();
+  std::vector<int32_t>& deferred = worker->deferred;
+  while (!stop_.load(std::memory_order_acquire)) {
+    bool progress = false;
+    if (!deferred.empty()) {
+      size_t requested = 0;
+      while (requested < deferred.size() && TryRequest(deferred[requested])) {
+        ++requested;
+      }
+      deferred.erase(deferred.begin(), deferred.begin() + requested);
+      progress = requested > 0;
+    }
+    int32_t game_id;
+    if (worker->ready.Pop(&game_id)) {
+      Step(game_id, worker);
+      progress = true;
+    }
+    if (!progress) {
+      std::this_thread::yield();
+    }
+  }
+}
+
+void ActorPipeline::Step(int game_id, Worker* worker) {
+  Game& game = games_[game_id];
+  HanabiState* state = game.state.get();
+  if (game.move >= 0) {
+    state->ApplyMove(game_->GetMove(game.move));
+    game.move = -1;
+  }
+  while (!state->IsTerminal() && state->CurPlayer() == kChancePlayerId) {
+    state->ApplyRandomChance();
+  }
+  if (state->IsTerminal()) {
+    if (game_end_) {
+      game_end_(*state);
+    }
+    ++worker->stats.games;
+    worker->stats.total_score += state->Score();
+    NewEpisode(game_id);
+  }
+  if (!TryRequest(game_id)) {
+    worker->deferred.push_back(game_id);
+  }
+}
+
+bool ActorPipeline::TryRequest(int game_id) {
+  Batch& batch = batches_[active_.load(std::memory_order_acquire)];
+  // Check first so that retries on a full batch do not keep counting up.
+  if (batch.claimed.load(std::memory_order_relaxed) >= options_.batch_size) {
+    return false;
+  }
+  const int32_t slot = batch.claimed.fetch_add(1, std::memory_order_acq_rel);
+  if (slot >= options_.batch_size) {
+    return false;
+  }
+  const HanabiState& state = *games_[game_id].state;
+  HanabiObservation observation(state, state.CurPlayer());
+  encoder_.EncodeInto(observation, false, {}, false, {}, {}, false,
+                      batch.observations.data() +
+                          static_cast<size_t>(slot) * EncodingLength());
+  encoder_.EncodeLegalMoves(
+      observation, batch.legal_masks.data() + slot * game_->MaxMoves());
+  batch.game_ids[slot] = game_id;
+  batch.written.fetch_add(1, std::memory_order_release);
+  return true;
+}
+
+void ActorPipeline::NewEpisode(int game_id) {
+  Game& game = games_[game_id];
+  game.state.reset(new HanabiState(
+      game_, HanabiRng(options_.seed, game_id, game.episode++)));
+  HanabiState* state = game.state.get();
+  while (state->CurPlayer() == kChancePlayerId) {
+    state->ApplyRandomChance();
+  }
+}
+
+}  // namespace hanabi_learning_env
@@ -0,0 +1,157 @@
+// Copyright 2018 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+// Actor runtime that plays many games on worker threads and batches their
+// action requests into a single inference call.
+//
+// Every worker thread owns a fixed set of games. When a game needs a player
+// move, the worker encodes the acting player's canonical observation and
+// legal move mask straight into a free slot of the shared batch. The thread
+// calling Run() flushes the batch when it is full, or when timeout_us has
+// passed since its first request, calls the inference callback once for the
+// whole batch and routes each chosen move back to the worker owning the game.
+//
+// There are two batches. While the callback runs on one, workers keep
+// stepping the games whose moves came back and fill the other, so stepping
+// and inference overlap. Slots are claimed with a fetch_add and moves are
+// returned through one single-producer single-consumer queue per worker, so
+// no lock is taken on the hot path.
+
+#ifndef __ACTOR_PIPELINE_H__
+#define __ACTOR_PIPELINE_H__
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include "canonical_encoders.h"
+#include "hanabi_game.h"
+#include "hanabi_state.h"
+
+namespace hanabi_learning_env {
+
+struct ActorPipelineOptions {
+  int num_threads = 1;        // Worker threads stepping games.
+  int games_per_thread = 32;  // Games owned by each worker.
+  int batch_size = 32;        // Requests per inference call, at most.
+  int timeout_us = 100;       // Flush a partial batch after this long.
+  uint64_t seed = 0;          // Game g plays episodes HanabiRng(seed, g, ...).
+};
+
+// Batched inference callback. observations holds
+// batch_size x EncodingLength() floats, legal_masks batch_size x MaxMoves()
+// bytes, and the callback writes one legal move uid per request to moves.
+// It is only called from the thread running ActorPipeline::Run().
+using ActorInferenceFn =
+    std::function<void(int batch_size, const float* observations,
+                       const uint8_t* legal_masks, int32_t* moves)>;
+
+// Called with every finished game before it is replaced by a new one, e.g.
+// to store it in a RecordReplay. Invoked concurrently from worker threads.
+using ActorGameEndFn = std::function<void(const HanabiState& state)>;
+
+struct ActorPipelineStats {
+  int64_t moves = 0;        // Player moves chosen by the callback.
+  int64_t games = 0;        // Games finished.
+  int64_t total_score = 0;  // Sum of the final scores of finished games.
+  int64_t batches = 0;      // Inference calls.
+};
+
+// Bounded queue of non-negative ints for exactly one producer and one
+// consumer thread.
+class SpscIndexQueue {
+ public:
+  explicit SpscIndexQueue(int capacity);
+  // Returns false if the queue is full.
+  bool Push(int32_t value);
+  // Returns false if the queue is empty.
+  bool Pop(int32_t* value);
+
+ private:
+  std::vector<int32_t> values_;
+  uint64_t mask_;
+  // Head and tail are written by different threads, keep them on separate
+  // cache lines.
+  std::atomic<uint64_t> head_{0};
+  char padding_[64];
+  std::atomic<uint64_t> tail_{0};
+};
+
+class ActorPipeline {
+ public:
+  ActorPipeline(const HanabiGame* game, const ActorPipelineOptions& options,
+                ActorInferenceFn inference,
+                ActorGameEndFn game_end = ActorGameEndFn());
+  ActorPipeline(const ActorPipeline&) = delete;
+  ActorPipeline& operator=(const ActorPipeline&) = delete;
+
+  int EncodingLength() const { return encoder_.EncodingLength(); }
+  int NumGames() const { return static_cast<int>(games_.size()); }
+
+  // Plays until the callback has chosen at least num_moves moves and returns
+  // the statistics of this call. Games in progress, and requests not yet
+  // answered, carry over to the next call. Not reentrant.
+  ActorPipelineStats Run(int64_t num_moves);
+
+ private:
+  struct Game {
+    std::unique_ptr<HanabiState> state;
+    uint64_t episode = 0;
+    int32_t move = -1;  // Move to apply next, -1 for none.
+  };
+  struct Batch {
+    std::vector<float> observations;
+    std::vector<uint8_t> legal_masks;
+    std::vector<int32_t> moves;
+    std::vector<int32_t> game_ids;
+    // Claims past batch_size fail. Sealing sets this to kSealed.
+    std::atomic<int32_t> claimed{0};
+    std::atomic<int32_t> written{0};
+  };
+  struct Worker {
+    explicit Worker(int num_games) : ready(num_games) {}
+    // Games whose move came back from inference. Pushed by the Run() thread.
+    SpscIndexQueue ready;
+    // Games waiting for a free batch slot.
+    std::vector<int32_t> deferred;
+    ActorPipelineStats stats;
+  };
+
+  void WorkerThread(int worker_id);
+  // Applies the pending move of game_id and any deals, restarts the game if
+  // it ended, and requests its next move.
+  void Step(int game_id, Worker* worker);
+  // Encodes game_id into a slot of the current batch. Returns false if the
+  // batch is full.
+  bool TryRequest(int game_id);
+  void NewEpisode(int game_id);
+
+  const HanabiGame* game_;
+  ActorPipelineOptions options_;
+  ActorInferenceFn inference_;
+  ActorGameEndFn game_end_;
+  CanonicalObservationEncoder encoder_;
+  std::vector<Game> games_;
+  Batch batches_[2];
+  std::atomic<int> active_{0};
+  std::vector<std::unique_ptr<Worker>> workers_;
+  std::atomic<bool> stop_{false};
+};
+
+}  // namespace hanabi_learning_env
+
+#endif
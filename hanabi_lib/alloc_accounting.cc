@@ -0,0 +1,98 @@
+// Copyright 2018 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include "alloc_accounting.h"
+
+#if defined(HANABI_ALLOC_ACCOUNTING)
+#include <cstdlib>
+#include <new>
+#endif
+
+namespace hanabi_learning_env {
+
+#if defined(HANABI_ALLOC_ACCOUNTING)
+
+namespace {
+
+// Plain integers: operator new must not allocate or run constructors.
+thread_local uint64_t thread_allocations = 0;
+thread_local uint64_t thread_bytes = 0;
+
+void* CountedAllocate(std::size_t size) {
+  ++thread_allocations;
+  thread_bytes += size;
+  return std::malloc(size == 0 ? 1 : size);
+}
+
+}  // namespace
+
+bool AllocAccountingEnabled() { return true; }
+
+AllocCounts ThreadAllocCounts() {
+  AllocCounts counts;
+  counts.allocations = thread_allocations;
+  counts.bytes = thread_bytes;
+  return counts;
+}
+
+#else
+
+bool AllocAccountingEnabled() { return false; }
+
+AllocCounts ThreadAllocCounts() { return AllocCounts(); }
+
+#endif
+
+}  // namespace hanabi_learning_env
+
+#if defined(HANABI_ALLOC_ACCOUNTING)
+
+void* operator new(std::size_t size) {
+  void* ptr = hanabi_learning_env::CountedAllocate(size);
+  if (ptr == nullptr) {
+    throw std::bad_alloc();
+  }
+  return ptr;
+}
+
+void* operator new[](std::size_t size) {
+  void* ptr = hanabi_learning_env::CountedAllocate(size);
+  if (ptr == nullptr) {
+    throw std::bad_alloc();
+  }
+  return ptr;
+}
+
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept {
+  return hanabi_learning_env::CountedAllocate(size);
+}
+
+void* operator new[](std::size_t size, const std::nothrow_t&) noexcept {
+  return hanabi_learning_env::CountedAllocate(size);
+}
+
+void operator delete(void* ptr) noexcept { std::free(ptr); }
+
+void operator delete[](void* ptr) noexcept { std::free(ptr); }
+
+void operator delete(void* ptr, const std::nothrow_t&) noexcept {
+  std::free(ptr);
+}
+
+void operator delete[](void* ptr, const std::nothrow_t&) noexcept {
+  std::free(ptr);
+}
+
+#endif
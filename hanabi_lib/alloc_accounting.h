@@ -0,0 +1,62 @@
+// Copyright 2018 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+// Optional heap-allocation accounting.
+//
+// Built with -DHANABI_ALLOC_ACCOUNTING=ON, the library replaces the global
+// operator new/delete with versions that count, per thread, how many
+// allocations were made and how many bytes were requested. Counting is
+// process-wide (it sees every allocation of the calling thread, not only
+// those made inside hanabi_lib), so measurements should bracket a single
+// engine call with an AllocScope.
+
+#ifndef __ALLOC_ACCOUNTING_H__
+#define __ALLOC_ACCOUNTING_H__
+
+#include <cstdint>
+
+namespace hanabi_learning_env {
+
+struct AllocCounts {
+  uint64_t allocations = 0;
+  uint64_t bytes = 0;
+};
+
+// True if the library was built with HANABI_ALLOC_ACCOUNTING.
+bool AllocAccountingEnabled();
+
+// Totals for the calling thread since it started. Always zero when
+// accounting is compiled out.
+AllocCounts ThreadAllocCounts();
+
+// Allocations made by the calling thread during the lifetime of the scope.
+class AllocScope {
+ public:
+  AllocScope() : start_(ThreadAllocCounts()) {}
+  AllocCounts Counts() const {
+    AllocCounts now = ThreadAllocCounts();
+    AllocCounts counts;
+    counts.allocations = now.allocations - start_.allocations;
+    counts.bytes = now.bytes - start_.bytes;
+    return counts;
+  }
+
+ private:
+  AllocCounts start_;
+};
+
+}  // namespace hanabi_learning_env
+
+#endif
@@ -19,6 +19,7 @@
 #include <vector>
 
 #include "canonical_encoders.h"
+#include "instrumentation.h"
 
 namespace hanabi_learning_env {
 
@@ -77,8 +78,9 @@ int EncodeHands(const HanabiGame& game,
                 const std::vector<int>& order,
                 bool shuffle_color,
                 const std::vector<int>& color_permute,
-                std::vector<float>* encoding,
+                float* encoding,
                 bool using_joint_obs) {
+  HANABI_PROBE(kProbeEncodeHands);
   int bits_per_card = BitsPerCard(game);
   int num_ranks = game.NumRanks();
   int num_players = game.NumPlayers();
@@ -109,7 +111,7 @@ int EncodeHands(const HanabiGame& game,
           // std::cout << card.Color() << ", " << card.Rank() << ", " << num_ranks << std::endl;
           auto card_idx = CardIndex(
               card.Color(), card.Rank(), num_ranks, shuffle_color, color_permute);
-          (*encoding).at(offset + card_idx) = 1;
+          encoding[offset + card_idx] = 1;
         } else {
           assert(!card.IsValid());
           // (*encoding).at(offset + CardIndex(card.Color(), card.Rank(), num_ranks)) = 0;
@@ -118,7 +120,7 @@ int EncodeHands(const HanabiGame& game,
         assert(card.IsValid());
         auto card_idx = CardIndex(
             card.Color(), card.Rank(), num_ranks, shuffle_color, color_permute);
-        (*encoding).at(offset + card_idx) = 1;
+        encoding[offset + card_idx] = 1;
       }
 
       ++num_cards;
@@ -139,7 +141,7 @@ int EncodeHands(const HanabiGame& game,
   // For each player, set a bit if their hand is missing a card.
   for (int player = 0; player < num_players; ++player) {
     if (hands[player].Cards().size() < game.HandSize()) {
-      (*encoding)[offset + player] = 1;
+      encoding[offset + player] = 1;
     }
   }
   if (using_joint_obs) {
@@ -177,8 +179,9 @@ int EncodeBoard(const HanabiGame& game,
                 bool shuffle_color,
                 // const std::vector<int>& color_permute,
                 const std::vector<int>& inv_color_permute,
-                std::vector<float>* encoding,
+                float* encoding,
                 bool using_joint_obs) {
+  HANABI_PROBE(kProbeEncodeBoard);
   int num_colors = game.NumColors();
   int num_ranks = game.NumRanks();
   int num_players = using_joint_obs ? 2 : game.NumPlayers();
@@ -188,7 +191,7 @@ int EncodeBoard(const HanabiGame& game,
   int offset = start_offset;
   // Encode the deck size
   for (int i = 0; i < obs.DeckSize(); ++i) {
-    (*encoding)[offset + i] = 1;
+    encoding[offset + i] = 1;
   }
   // std::cout << "max_deck_size: " << max_deck_size
   //           << ", deck_size: " << obs.DeckSize() << std::endl;
@@ -213,7 +216,7 @@ int EncodeBoard(const HanabiGame& game,
     }
 
     if (fireworks[color] > 0) {
-      (*encoding)[offset + fireworks[color] - 1] = 1;
+      encoding[offset + fireworks[color] - 1] = 1;
     }
     // std::cout << fireworks[color] << ", ";
     offset += num_ranks;
@@ -229,7 +232,7 @@ int EncodeBoard(const HanabiGame& game,
   assert(obs.InformationTokens() >= 0);
   assert(obs.InformationTokens() <= game.MaxInformationTokens());
   for (int i = 0; i < obs.InformationTokens(); ++i) {
-    (*encoding)[offset + i] = 1;
+    encoding[offset + i] = 1;
   }
   offset += game.MaxInformationTokens();
 
@@ -237,7 +240,7 @@ int EncodeBoard(const HanabiGame& game,
   assert(obs.LifeTokens() >= 0);
   assert(obs.LifeTokens() <= game.MaxLifeTokens());
   for (int i = 0; i < obs.LifeTokens(); ++i) {
-    (*encoding)[offset + i] = 1;
+    encoding[offset + i] = 1;
   }
   offset += game.MaxLifeTokens();
 
@@ -269,7 +272,8 @@ int EncodeDiscards(const HanabiGame& game,
                    int start_offset,
                    bool shuffle_color,
                    const std::vector<int>& color_permute,
-                   std::vector<float>* encoding) {
+                   float* encoding) {
+  HANABI_PROBE(kProbeEncodeDiscards);
   int num_colors = game.NumColors();
   int num_ranks = game.NumRanks();
 
@@ -284,7 +288,7 @@ int EncodeDiscards(const HanabiGame& game,
       // "discard_counts" has been permuted, and the order of discard is fixed as in the pile
       int num_discarded = discard_counts[CardIndex(c, r, num_ranks, false, color_permute)];
       for (int i = 0; i < num_discarded; ++i) {
-        (*encoding)[offset + i] = 1;
+        encoding[offset + i] = 1;
       }
       offset += game.NumberCardInstances(c, r);
     }
@@ -311,8 +315,9 @@ int EncodeLastAction_(const HanabiGame& game,
                       const std::vector<int>& order,
                       bool shuffle_color,
                       const std::vector<int>& color_permute,
-                      std::vector<float>* encoding,
+                      float* encoding,
                       bool using_joint_obs) {
+  HANABI_PROBE(kProbeEncodeLastAction);
   int num_colors = game.NumColors();
   int num_ranks = game.NumRanks();
   int num_players = using_joint_obs ? 5 : game.NumPlayers();
@@ -328,22 +333,22 @@ int EncodeLastAction_(const HanabiGame& game,
     // player_id
     // Note: no assertion here. At a terminal state, the last player could have
     // been me (player id 0).
-    (*encoding)[offset + last_move->player] = 1;
+    encoding[offset + last_move->player] = 1;
     offset += num_players;
 
     // move type
     switch (last_move_type) {
       case HanabiMove::Type::kPlay:
-        (*encoding)[offset] = 1;
+        encoding[offset] = 1;
         break;
       case HanabiMove::Type::kDiscard:
-        (*encoding)[offset + 1] = 1;
+        encoding[offset + 1] = 1;
         break;
       case HanabiMove::Type::kRevealColor:
-        (*encoding)[offset + 2] = 1;
+        encoding[offset + 2] = 1;
         break;
       case HanabiMove::Type::kRevealRank:
-        (*encoding)[offset + 3] = 1;
+        encoding[offset + 3] = 1;
         break;
       default:
         std::abort();
@@ -355,7 +360,7 @@ int EncodeLastAction_(const HanabiGame& game,
         last_move_type == HanabiMove::Type::kRevealRank) {
       int8_t observer_relative_target =
           (last_move->player + last_move->move.TargetOffset()) % game.NumPlayers();
-      (*encoding)[offset + observer_relative_target] = 1;
+      encoding[offset + observer_relative_target] = 1;
     }
     offset += num_players;
 
@@ -365,13 +370,13 @@ int EncodeLastAction_(const HanabiGame& game,
       if (shuffle_color) {
         color = color_permute[color];
       }
-      (*encoding)[offset + color] = 1;
+      encoding[offset + color] = 1;
     }
     offset += num_colors;
 
     // rank (if hint action)
     if (last_move_type == HanabiMove::Type::kRevealRank) {
-      (*encoding)[offset + last_move->move.Rank()] = 1;
+      encoding[offset + last_move->move.Rank()] = 1;
     }
     offset += num_ranks;
 
@@ -387,7 +392,7 @@ int EncodeLastAction_(const HanabiGame& game,
         last_move_type == HanabiMove::Type::kRevealRank) {
       for (int i = 0, mask = 1; i < hand_size; ++i, mask <<= 1) {
         if ((last_move->reveal_bitmask & mask) > 0) {
-          (*encoding)[offset + i] = 1;
+          encoding[offset + i] = 1;
         }
       }
     }
@@ -405,7 +410,7 @@ int EncodeLastAction_(const HanabiGame& game,
       } else {
         // in normal mode, tells you which card was played/discarded
         int hand_idx = last_move->move.CardIndex();
-        (*encoding)[offset + hand_idx] = 1;
+        encoding[offset + hand_idx] = 1;
       }
     }
     offset += hand_size;
@@ -417,17 +422,17 @@ int EncodeLastAction_(const HanabiGame& game,
       assert(last_move->rank >= 0);
       int card_idx = CardIndex(
           last_move->color, last_move->rank, num_ranks, shuffle_color, color_permute);
-      (*encoding)[offset + card_idx] = 1;
+      encoding[offset + card_idx] = 1;
     }
     offset += BitsPerCard(game);
 
     // was successful and/or added information token (if play action)
     if (last_move_type == HanabiMove::Type::kPlay) {
       if (last_move->scored) {
-        (*encoding)[offset] = 1;
+        encoding[offset] = 1;
       }
       if (last_move->information_token) {
-        (*encoding)[offset + 1] = 1;
+        encoding[offset + 1] = 1;
       }
     }
     offset += 2;
@@ -477,7 +482,7 @@ int EncodeCardKnowledge(const HanabiGame& game,
                         const std::vector<int>& order,
                         bool shuffle_color,
                         const std::vector<int>& color_permute,
-                        std::vector<float>* encoding,
+                        float* encoding,
                         bool using_joint_obs) {
   int bits_per_card = BitsPerCard(game);
   int num_colors = game.NumColors();
@@ -506,7 +511,7 @@ int EncodeCardKnowledge(const HanabiGame& game,
           for (int rank = 0; rank < num_ranks; ++rank) {
             if (card_knowledge.RankPlausible(rank)) {
               int card_idx = CardIndex(color, rank, num_ranks, shuffle_color, color_permute);
-              (*encoding)[offset + card_idx] = 1;
+              encoding[offset + card_idx] = 1;
             }
           }
         }
@@ -519,11 +524,11 @@ int EncodeCardKnowledge(const HanabiGame& game,
         if (shuffle_color) {
           color = color_permute[color];
         }
-        (*encoding)[offset + color] = 1;
+        encoding[offset + color] = 1;
       }
       offset += num_colors;
       if (card_knowledge.RankHinted()) {
-        (*encoding)[offset + card_knowledge.Rank()] = 1;
+        encoding[offset + card_knowledge.Rank()] = 1;
       }
       offset += num_ranks;
 
@@ -549,9 +554,10 @@ int EncodeV0Belief_(const HanabiGame& game,
                     const std::vector<int>& order,
                     bool shuffle_color,
                     const std::vector<int>& color_permute,
-                    std::vector<float>* encoding,
+                    float* encoding,
                     std::vector<int>* ret_card_count,
                     bool using_joint_obs) {
+  HANABI_PROBE(kProbeEncodeV0Belief);
   // int bits_per_card = BitsPerCard(game);
   int num_colors = game.NumColors();
   int num_ranks = game.NumRanks();
@@ -584,8 +590,8 @@ int EncodeV0Belief_(const HanabiGame& game,
                       + i);
         // std::cout << offset << ", " << len << std::endl;
         assert(offset - start_offset < len);
-        (*encoding)[offset] *= card_count[i];
-        total += (*encoding)[offset];
+        encoding[offset] *= card_count[i];
+        total += encoding[offset];
       }
       if (total <= 0) {
         // const std::vector<HanabiHand>& hands = obs.Hands();
@@ -599,7 +605,7 @@ int EncodeV0Belief_(const HanabiGame& game,
                       + player_offset * player_id
                       + card_idx * per_card_offset
                       + i);
-        (*encoding)[offset] /= total;
+        encoding[offset] /= total;
       }
     }
   }
@@ -630,15 +636,18 @@ int LastActionSectionLength(const HanabiGame& game,
          2;                   // play (successful, added information token)
 }
 
+int CanonicalObservationEncoder::EncodingLength() const {
+  return HandsSectionLength(*parent_game_, false) +
+         BoardSectionLength(*parent_game_, false) +
+         DiscardSectionLength(*parent_game_) +
+         LastActionSectionLength(*parent_game_, false) +
+         (parent_game_->ObservationType() == HanabiGame::kMinimal
+              ? 0
+              : V0BeliefSectionLength(*parent_game_, false));
+}
+
 std::vector<int> CanonicalObservationEncoder::Shape() const {
-  int l = HandsSectionLength(*parent_game_, false) +
-          BoardSectionLength(*parent_game_, false) +
-          DiscardSectionLength(*parent_game_) +
-          LastActionSectionLength(*parent_game_, false) +
-          (parent_game_->ObservationType() == HanabiGame::kMinimal
-               ? 0
-               : V0BeliefSectionLength(*parent_game_, false));
-  return {l};
+  return {EncodingLength()};
 }
 
 std::vector<int> CanonicalObservationEncoder::ShapeJointObs() const {
@@ -660,7 +669,7 @@ std::vector<float> CanonicalObservationEncoder::EncodeLastAction(
   std::vector<float> encoding(LastActionSectionLength(*parent_game_), 0);
   int offset = 0;
   offset += EncodeLastAction_(
-      *parent_game_, obs, offset, order, shuffle_color, color_permute, &encoding, false);
+      *parent_game_, obs, offset, order, shuffle_color, color_permute, encoding.data(), false);
   assert(offset == encoding.size());
   return encoding;
 }
@@ -700,15 +709,24 @@ std::vector<float> CanonicalObservationEncoder::Encode(
     const std::vector<int>& color_permute,
     const std::vector<int>& inv_color_permute,
     bool hide_action) const {
+  std::vector<float> encoding(EncodingLength());
+  EncodeInto(obs, show_own_cards, order, shuffle_color, color_permute,
+             inv_color_permute, hide_action, encoding.data());
+  return encoding;
+}
 
-  // Make an empty bit string of the proper size.
-  std::vector<float> encoding(FlatLength(Shape()), 0);
-  // std::cout << "encoding shape: " << encoding.size() << std::endl;
-  // std::cout << "rand order:" << std::endl;
-  // for (auto& a : order) {
-  //   std::cout << a << ", ";
-  // }
-  // std::cout << std::endl;
+void CanonicalObservationEncoder::EncodeInto(
+    const HanabiObservation& obs,
+    bool show_own_cards,
+    const std::vector<int>& order,
+    bool shuffle_color,
+    const std::vector<int>& color_permute,
+    const std::vector<int>& inv_color_permute,
+    bool hide_action,
+    float* encoding) const {
+  // Start from an empty bit string; the sections only set their ones.
+  const int length = EncodingLength();
+  std::fill(encoding, encoding + length, 0.0f);
 
   // This offset is an index to the start of each section of the bit vector.
   // It is incremented at the end of each section.
@@ -716,24 +734,111 @@ std::vector<float> CanonicalObservationEncoder::Encode(
 
   offset += EncodeHands(
       *parent_game_, obs, offset, show_own_cards, order,
-      shuffle_color, color_permute, &encoding, false);
+      shuffle_color, color_permute, encoding, false);
   offset += EncodeBoard(
-      *parent_game_, obs, offset, shuffle_color, inv_color_permute, &encoding, false);
+      *parent_game_, obs, offset, shuffle_color, inv_color_permute, encoding, false);
   offset += EncodeDiscards(
-      *parent_game_, obs, offset, shuffle_color, color_permute, &encoding);
+      *parent_game_, obs, offset, shuffle_color, color_permute, encoding);
   if (hide_action) {
     offset += LastActionSectionLength(*parent_game_, false);
   } else {
     offset += EncodeLastAction_(
-        *parent_game_, obs, offset, order, shuffle_color, color_permute, &encoding, false);
+        *parent_game_, obs, offset, order, shuffle_color, color_permute, encoding, false);
   }
   if (parent_game_->ObservationType() != HanabiGame::kMinimal) {
     offset += EncodeV0Belief_(
-        *parent_game_, obs, offset, order, shuffle_color, color_permute, &encoding, nullptr, false);
+        *parent_game_, obs, offset, order, shuffle_color, color_permute, encoding, nullptr, false);
   }
 
-  assert(offset == encoding.size());
-  return encoding;
+  assert(offset == length);
+}
+
+std::vector<int> CanonicalObservationEncoder::ColorPermutationGather(
+    const std::vector<int>& color_permute) const {
+  const HanabiGame& game = *parent_game_;
+  const int num_colors = game.NumColors();
+  const int num_ranks = game.NumRanks();
+  const int num_players = game.NumPlayers();
+  const int hand_size = game.HandSize();
+  const int bits_per_card = BitsPerCard(game);
+  assert(color_permute.size() == num_colors);
+  std::vector<int> inv_color_permute(num_colors);
+  for (int c = 0; c < num_colors; ++c) {
+    inv_color_permute[color_permute[c]] = c;
+  }
+
+  std::vector<int> gather(EncodingLength());
+  for (int i = 0; i < gather.size(); ++i) {
+    gather[i] = i;
+  }
+  // Color c' of a slice at offset holds what color inv[c'] held unshuffled.
+  auto permute_slice = [&](int offset, int color_stride) {
+    for (int c = 0; c < num_colors; ++c) {
+      for (int j = 0; j < color_stride; ++j) {
+        gather[offset + c * color_stride + j] =
+            offset + inv_color_permute[c] * color_stride + j;
+      }
+    }
+  };
+
+  // Hands: one color-major card per slot.
+  int offset = 0;
+  for (int slot = 0; slot < num_players * hand_size; ++slot) {
+    permute_slice(offset + slot * bits_per_card, num_ranks);
+  }
+  offset += HandsSectionLength(game, false);
+  // Board: the fireworks follow the deck size thermometer.
+  permute_slice(offset + game.MaxDeckSize() - num_players * hand_size,
+                num_ranks);
+  offset += BoardSectionLength(game, false);
+  // Discards: one thermometer block of CardsPerColor() entries per color.
+  permute_slice(offset, game.CardsPerColor());
+  offset += DiscardSectionLength(game);
+  // Last action: the hinted color and the played or discarded card.
+  const int hint_color_offset = offset + 2 * num_players + 4;
+  permute_slice(hint_color_offset, 1);
+  permute_slice(hint_color_offset + num_colors + num_ranks + 2 * hand_size,
+                num_ranks);
+  offset += LastActionSectionLength(game, false);
+  // Belief: per slot, the plausible cards and the hinted color.
+  if (game.ObservationType() != HanabiGame::kMinimal) {
+    const int slot_length = bits_per_card + num_colors + num_ranks;
+    for (int slot = 0; slot < num_players * hand_size; ++slot) {
+      permute_slice(offset + slot * slot_length, num_ranks);
+      permute_slice(offset + slot * slot_length + bits_per_card, 1);
+    }
+    offset += V0BeliefSectionLength(game, false);
+  }
+  assert(offset == gather.size());
+  return gather;
+}
+
+void CanonicalObservationEncoder::EncodeColorPermutations(
+    const HanabiObservation& obs,
+    bool show_own_cards,
+    const std::vector<int>& order,
+    bool hide_action,
+    const std::vector<std::vector<int>>& gathers,
+    float* encodings) const {
+  const int length = EncodingLength();
+  std::vector<float> unpermuted(length);
+  EncodeInto(obs, show_own_cards, order, false, {}, {}, hide_action,
+             unpermuted.data());
+  for (int k = 0; k < gathers.size(); ++k) {
+    const int* gather = gathers[k].data();
+    float* encoding = encodings + static_cast<size_t>(k) * length;
+    for (int i = 0; i < length; ++i) {
+      encoding[i] = unpermuted[gather[i]];
+    }
+  }
+}
+
+void CanonicalObservationEncoder::EncodeLegalMoves(const HanabiObservation& obs,
+                                                   uint8_t* mask) const {
+  std::fill(mask, mask + parent_game_->MaxMoves(), 0);
+  for (const HanabiMove& move : obs.LegalMoves()) {
+    mask[parent_game_->GetMoveUid(move)] = 1;
+  }
 }
 
   std::map<std::string, std::vector<float>> CanonicalObservationEncoder::EncodeFullState(const HanabiObservation& obs,
@@ -748,17 +853,17 @@ std::vector<float> CanonicalObservationEncoder::Encode(
 
     std::vector<float> hands_encoding(HandsSectionLength(*parent_game_, false), 0);
     EncodeHands(
-      *parent_game_, obs, offset, show_own_cards, order, shuffle_color, color_permute, &hands_encoding, false);
+      *parent_game_, obs, offset, show_own_cards, order, shuffle_color, color_permute, hands_encoding.data(), false);
     full_state["state::hands"] = hands_encoding;
 
     std::vector<float> board_encoding(BoardSectionLength(*parent_game_, false), 0);
     EncodeBoard(
-      *parent_game_, obs, offset, shuffle_color, inv_color_permute, &board_encoding, false);
+      *parent_game_, obs, offset, shuffle_color, inv_color_permute, board_encoding.data(), false);
     full_state["state::board"] = board_encoding;
 
     std::vector<float> discards_encoding(DiscardSectionLength(*parent_game_), 0);
     EncodeDiscards(
-      *parent_game_, obs, offset, shuffle_color, color_permute, &discards_encoding);
+      *parent_game_, obs, offset, shuffle_color, color_permute, discards_encoding.data());
     full_state["state::discards"] = discards_encoding;
 
     std::vector<float> last_action_encoding(LastActionSectionLength(*parent_game_, false), 0);
@@ -766,14 +871,14 @@ std::vector<float> CanonicalObservationEncoder::Encode(
         // DO NOTHING
     } else {
         EncodeLastAction_(
-            *parent_game_, obs, offset, order, shuffle_color, color_permute, &last_action_encoding, false);
+            *parent_game_, obs, offset, order, shuffle_color, color_permute, last_action_encoding.data(), false);
     }
     full_state["state::last_action"] = last_action_encoding;
 
     std::vector<float> V0_encoding(CardKnowledgeSectionLength(*parent_game_, false), 0);
     if (parent_game_->ObservationType() != HanabiGame::kMinimal) {
         EncodeV0Belief_(
-            *parent_game_, obs, offset, order, shuffle_color, color_permute, &V0_encoding, nullptr, false);
+            *parent_game_, obs, offset, order, shuffle_color, color_permute, V0_encoding.data(), nullptr, false);
     }
     full_state["state::V0_belief"] = V0_encoding;
 
@@ -892,14 +997,14 @@ std::vector<float> CanonicalObservationEncoder::EncodeJointFivePlayers(
 
   offset += EncodeHands(
       *parent_game_, obs, offset, show_own_cards, order,
-      shuffle_color, color_permute, &encoding, true);
+      shuffle_color, color_permute, encoding.data(), true);
 //  std::cerr << offset << std::endl;
   offset += EncodeBoard(
       *parent_game_, obs, offset, shuffle_color,
-      inv_color_permute, &encoding, true);
+      inv_color_permute, encoding.data(), true);
 //  std::cerr << offset << std::endl;
   offset += EncodeDiscards(
-      *parent_game_, obs, offset, shuffle_color, color_permute, &encoding);
+      *parent_game_, obs, offset, shuffle_color, color_permute, encoding.data());
 //  std::cerr << offset << std::endl;
   if (hide_action) {
     offset += LastActionSectionLength(*parent_game_, true);
@@ -907,13 +1012,13 @@ std::vector<float> CanonicalObservationEncoder::EncodeJointFivePlayers(
     assert(false);    // Need to double check that this is correct, not being used right now
     offset += EncodeLastAction_(
         *parent_game_, obs, offset, order, shuffle_color,
-        color_permute, &encoding, true);
+        color_permute, encoding.data(), true);
   }
 //  std::cerr << offset << std::endl;
   if (parent_game_->ObservationType() != HanabiGame::kMinimal) {
     offset += EncodeV0Belief_(
         *parent_game_, obs, offset, order, shuffle_color,
-        color_permute, &encoding, nullptr, true);
+        color_permute, encoding.data(), nullptr, true);
   }
 //  std::cerr << offset << std::endl;
 
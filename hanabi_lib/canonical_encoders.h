@@ -18,6 +18,7 @@
 #ifndef __CANONICAL_ENCODERS_H__
 #define __CANONICAL_ENCODERS_H__
 
+#include <cstdint>
 #include <vector>
 #include <map>
 
@@ -35,6 +36,9 @@ class CanonicalObservationEncoder : public ObservationEncoder {
 
   std::vector<int> Shape() const override;
 
+  // Number of floats written by Encode() and EncodeInto().
+  int EncodingLength() const;
+
   std::vector<int> ShapeJointObs() const;
 
   // std::vector<float> Encode(const HanabiObservation&) const override {
@@ -53,6 +57,41 @@ class CanonicalObservationEncoder : public ObservationEncoder {
                             const std::vector<int>& inv_color_permute,
                             bool hide_action) const;
 
+  // Same as Encode(), but writes the EncodingLength() values to encoding
+  // instead of allocating a vector.
+  void EncodeInto(const HanabiObservation& obs,
+                  bool show_own_cards,
+                  const std::vector<int>& order,
+                  bool shuffle_color,
+                  const std::vector<int>& color_permute,
+                  const std::vector<int>& inv_color_permute,
+                  bool hide_action,
+                  float* encoding) const;
+
+  // Index table of a color permutation: the encoding of an observation with
+  // shuffle_color and color_permute is the encoding without shuffling,
+  // gathered as permuted[i] = unpermuted[gather[i]]. Each section keys its
+  // color-dependent entries by color-major slices, so the table only
+  // depends on the game and the permutation and can be reused.
+  std::vector<int> ColorPermutationGather(
+      const std::vector<int>& color_permute) const;
+
+  // Writes the Encode() output of obs under each of the K color
+  // permutations whose gather tables are given, to encodings + k *
+  // EncodingLength(). obs is encoded once; each permutation is a gather.
+  void EncodeColorPermutations(const HanabiObservation& obs,
+                               bool show_own_cards,
+                               const std::vector<int>& order,
+                               bool hide_action,
+                               const std::vector<std::vector<int>>& gathers,
+                               float* encodings) const;
+
+  // Writes the legal move mask that accompanies the encoding of obs:
+  // parent_game->MaxMoves() bytes, 1 at the uid of every move in
+  // obs.LegalMoves() and 0 elsewhere. Uids follow the game's move layout,
+  // including the any-number-of-players layout used with joint observations.
+  void EncodeLegalMoves(const HanabiObservation& obs, uint8_t* mask) const;
+
   std::map<std::string, std::vector<float>> EncodeFullState(const HanabiObservation& obs,
                                                          const std::vector<int>& order,
                                                          bool shuffle_color,
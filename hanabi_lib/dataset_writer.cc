@@ -0,0 +1,199 @@
+// Copyright 2018 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include "dataset_writer.h"
+
+#include <sys/stat.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstdio>
+#include <functional>
+#include <map>
+#include <thread>
+
+#include "util.h"
+
+namespace hanabi_learning_env {
+
+namespace {
+
+std::string ShardPath(const std::string& dir, const std::string& name,
+                      const std::string& field) {
+  return dir + "/" + name + "." + field + ".npy";
+}
+
+}  // namespace
+
+DatasetShardWriter::DatasetShardWriter(const HanabiGame* game,
+                                       const std::string& dir,
+                                       const std::string& name)
+    : game_(game),
+      encoder_(game),
+      obs_(ShardPath(dir, name, "obs"), "<f4", encoder_.EncodingLength(), 4),
+      legal_mask_(ShardPath(dir, name, "legal_mask"), "|u1",
+                  game->MaxMoves(), 1),
+      action_(ShardPath(dir, name, "action"), "<i2", 1, 2),
+      return_(ShardPath(dir, name, "return"), "<f4", 1, 4),
+      episode_(ShardPath(dir, name, "episode"), "<i8", 1, 8) {
+  info_.name = name;
+}
+
+void DatasetShardWriter::AddGame(const GameRecord& record, int64_t episode) {
+  const int num_moves = record.moves.size();
+  const int encoding_length = encoder_.EncodingLength();
+  const int max_moves = game_->MaxMoves();
+  obs_rows_.assign(static_cast<size_t>(num_moves) * encoding_length, 0);
+  legal_mask_rows_.assign(static_cast<size_t>(num_moves) * max_moves, 0);
+  action_rows_.resize(num_moves);
+  return_rows_.resize(num_moves);
+  episode_rows_.assign(num_moves, episode);
+
+  // Same loop as ReplayGame, stopping at every player move to encode.
+  HanabiState state(game_, HanabiRng(), record.start_player);
+  int next_card = 0;
+  int step = 0;
+  while (!state.IsTerminal() && step < num_moves) {
+    if (state.CurPlayer() == kChancePlayerId) {
+      REQUIRE(next_card < record.dealt.size());
+      int index = record.dealt[next_card++];
+      state.ApplyMove(HanabiMove(HanabiMove::kDeal, -1, -1,
+                                 index / game_->NumRanks(),
+                                 index % game_->NumRanks()));
+      continue;
+    }
+    HanabiObservation obs(state, state.CurPlayer());
+    encoder_.EncodeInto(
+        obs, false, {}, false, {}, {}, false,
+        obs_rows_.data() + static_cast<size_t>(step) * encoding_length);
+    encoder_.EncodeLegalMoves(
+        obs, legal_mask_rows_.data() + static_cast<size_t>(step) * max_moves);
+    action_rows_[step] = record.moves[step];
+    // Holds the score before the move until the final score is known.
+    return_rows_[step] = state.Score();
+    state.ApplyMove(game_->GetMove(record.moves[step]));
+    ++step;
+  }
+  REQUIRE(step == num_moves);
+  const float final_score = state.Score();
+  for (float& value : return_rows_) {
+    value = final_score - value;
+  }
+
+  obs_.Append(obs_rows_.data(), num_moves);
+  legal_mask_.Append(legal_mask_rows_.data(), num_moves);
+  action_.Append(action_rows_.data(), num_moves);
+  return_.Append(return_rows_.data(), num_moves);
+  episode_.Append(episode_rows_.data(), num_moves);
+  ++info_.num_games;
+  info_.num_steps += num_moves;
+}
+
+DatasetShardInfo DatasetShardWriter::Close() {
+  obs_.Close();
+  legal_mask_.Close();
+  action_.Close();
+  return_.Close();
+  episode_.Close();
+  return info_;
+}
+
+std::vector<DatasetShardInfo> WriteDataset(
+    const HanabiGame& game, const std::string& dir, int64_t num_games,
+    int games_per_shard, int num_threads,
+    const std::function<GameRecord(int64_t episode)>& get_game,
+    int config_id) {
+  REQUIRE(games_per_shard > 0);
+  MakeDirectory(dir);
+  int num_shards = (num_games + games_per_shard - 1) / games_per_shard;
+  std::vector<DatasetShardInfo> shards(num_shards);
+  std::atomic<int> next_shard(0);
+  auto write_shards = [&] {
+    for (int shard = next_shard++; shard < num_shards; shard = next_shard++) {
+      char name[32];
+      std::snprintf(name, sizeof(name), "shard_%05d", shard);
+      DatasetShardWriter writer(&game, dir, name);
+      int64_t begin = static_cast<int64_t>(shard) * games_per_shard;
+      int64_t end = std::min(num_games, begin + games_per_shard);
+      for (int64_t episode = begin; episode < end; ++episode) {
+        const GameRecord record = get_game(episode);
+        REQUIRE(record.config_id == config_id);
+        writer.AddGame(record, episode);
+      }
+      shards[shard] = writer.Close();
+    }
+  };
+  std::vector<std::thread> threads;
+  for (int t = 0; t < std::min(num_threads, num_shards); ++t) {
+    threads.emplace_back(write_shards);
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  WriteDatasetIndex(dir, game, shards, config_id);
+  return shards;
+}
+
+void WriteDatasetIndex(const std::string& dir, const HanabiGame& game,
+                       const std::vector<DatasetShardInfo>& shards,
+                       int config_id) {
+  FILE* file = std::fopen((dir + "/index.json").c_str(), "w");
+  REQUIRE(file != nullptr);
+  CanonicalObservationEncoder encoder(&game);
+  int64_t num_games = 0;
+  int64_t num_steps = 0;
+  for (const auto& shard : shards) {
+    num_games += shard.num_games;
+    num_steps += shard.num_steps;
+  }
+  // Sorted so the file is stable across runs.
+  auto unordered_params = game.Parameters();
+  std::map<std::string, std::string> params(unordered_params.begin(),
+                                            unordered_params.end());
+  std::fprintf(file, "{\n  \"game\": {");
+  bool first = true;
+  for (const auto& item : params) {
+    std::fprintf(file, "%s\"%s\": \"%s\"", first ? "" : ", ",
+                 item.first.c_str(), item.second.c_str());
+    first = false;
+  }
+  std::fprintf(file, "},\n  \"config_id\": %d,\n", config_id);
+  std::fprintf(file,
+               "  \"fields\": {\"obs\": [\"<f4\", %d], "
+               "\"legal_mask\": [\"|u1\", %d], \"action\": [\"<i2\", 1], "
+               "\"return\": [\"<f4\", 1], \"episode\": [\"<i8\", 1]},\n",
+               encoder.EncodingLength(), game.MaxMoves());
+  std::fprintf(file, "  \"num_games\": %lld,\n  \"num_steps\": %lld,\n",
+               static_cast<long long>(num_games),
+               static_cast<long long>(num_steps));
+  std::fprintf(file, "  \"shards\": [");
+  for (int i = 0; i < shards.size(); ++i) {
+    std::fprintf(file,
+                 "%s\n    {\"name\": \"%s\", \"num_games\": %lld, "
+                 "\"num_steps\": %lld}",
+                 i == 0 ? "" : ",", shards[i].name.c_str(),
+                 static_cast<long long>(shards[i].num_games),
+                 static_cast<long long>(shards[i].num_steps));
+  }
+  std::fprintf(file, "\n  ]\n}\n");
+  std::fclose(file);
+}
+
+void MakeDirectory(const std::string& dir) {
+  REQUIRE(mkdir(dir.c_str(), 0755) == 0 || errno == EEXIST);
+}
+
+}  // namespace hanabi_learning_env
@@ -0,0 +1,102 @@
+// Copyright 2018 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+// Step-level datasets of encoded observations for offline training.
+//
+// A dataset is a directory of shards plus an index.json. Shard <name>
+// consists of one .npy file per field, each with one row per player move:
+//   <name>.obs.npy         float32 [steps, encoding length]
+//   <name>.legal_mask.npy  uint8   [steps, MaxMoves()]
+//   <name>.action.npy      int16   [steps, 1]  (move uid)
+//   <name>.return.npy      float32 [steps, 1]  (final score minus current
+//                                               score, i.e. the sum of the
+//                                               remaining rl_env rewards)
+//   <name>.episode.npy     int64   [steps, 1]  (dataset-wide game index)
+// Observations are CanonicalObservationEncoder encodings from the acting
+// player's point of view.
+
+#ifndef __DATASET_WRITER_H__
+#define __DATASET_WRITER_H__
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "canonical_encoders.h"
+#include "game_record.h"
+#include "hanabi_game.h"
+#include "npy_writer.h"
+
+namespace hanabi_learning_env {
+
+struct DatasetShardInfo {
+  std::string name;
+  int64_t num_games = 0;
+  int64_t num_steps = 0;
+};
+
+// Writes one shard. Not thread-safe; use one writer per thread.
+class DatasetShardWriter {
+ public:
+  DatasetShardWriter(const HanabiGame* game, const std::string& dir,
+                     const std::string& name);
+
+  // Replays record and writes a row for each of its player moves.
+  void AddGame(const GameRecord& record, int64_t episode);
+  // Finalizes the .npy headers. Called by the destructor if needed.
+  DatasetShardInfo Close();
+
+ private:
+  const HanabiGame* game_;
+  CanonicalObservationEncoder encoder_;
+  DatasetShardInfo info_;
+  NpyWriter obs_;
+  NpyWriter legal_mask_;
+  NpyWriter action_;
+  NpyWriter return_;
+  NpyWriter episode_;
+  // Per-game row buffers, written out once the final score is known.
+  std::vector<float> obs_rows_;
+  std::vector<uint8_t> legal_mask_rows_;
+  std::vector<int16_t> action_rows_;
+  std::vector<float> return_rows_;
+  std::vector<int64_t> episode_rows_;
+};
+
+// Writes games [0, num_games) to dir as shards of games_per_shard games,
+// spread over num_threads threads, followed by the index. Shard s holds
+// games [s * games_per_shard, (s + 1) * games_per_shard), so the output does
+// not depend on the number of threads. get_game is called concurrently and
+// must return records of game, tagged with config_id.
+std::vector<DatasetShardInfo> WriteDataset(
+    const HanabiGame& game, const std::string& dir, int64_t num_games,
+    int games_per_shard, int num_threads,
+    const std::function<GameRecord(int64_t episode)>& get_game,
+    int config_id = 0);
+
+// Writes <dir>/index.json describing the game, its config id, the field
+// layout and the shards.
+void WriteDatasetIndex(const std::string& dir, const HanabiGame& game,
+                       const std::vector<DatasetShardInfo>& shards,
+                       int config_id = 0);
+
+// Creates dir if it does not exist yet.
+void MakeDirectory(const std::string& dir);
+
+}  // namespace hanabi_learning_env
+
+#endif
@@ -0,0 +1,308 @@
+// Copyright 2018 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "game_record.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <cstring>
+
+#include "util.h"
+
+namespace hanabi_learning_env {
+
+namespace {
+
+constexpr char kMagic[4] = {'H', 'R', 'E', 'C'};
+constexpr uint32_t kVersion = 1;
+constexpr int kFileHeaderSize = 8;
+constexpr int kRecordHeaderSize = 10;
+
+void PutU16(uint16_t value, char* out) {
+  out[0] = static_cast<char>(value & 0xff);
+  out[1] = static_cast<char>(value >> 8);
+}
+
+void PutU32(uint32_t value, char* out) {
+  for (int i = 0; i < 4; ++i) {
+    out[i] = static_cast<char>((value >> (8 * i)) & 0xff);
+  }
+}
+
+uint16_t GetU16(const uint8_t* in) { return in[0] | (in[1] << 8); }
+
+uint32_t GetU32(const uint8_t* in) {
+  return in[0] | (in[1] << 8) | (in[2] << 16) |
+         (static_cast<uint32_t>(in[3]) << 24);
+}
+
+}  // namespace
+
+GameRecord GameRecord::FromState(const HanabiState& state,
+                                 uint16_t config_id) {
+  const HanabiGame* game = state.ParentGame();
+  GameRecord record;
+  record.config_id = config_id;
+  bool found_start = false;
+  for (const auto& item : state.MoveHistory()) {
+    if (item.move.MoveType() == HanabiMove::kDeal) {
+      record.dealt.push_back(item.move.Color() * game->NumRanks() +
+                             item.move.Rank());
+    } else {
+      if (!found_start) {
+        record.start_player = item.player;
+        found_start = true;
+      }
+      int uid = game->GetMoveUid(item.move);
+      REQUIRE(uid >= 0 && uid < 256);
+      record.moves.push_back(uid);
+    }
+  }
+  if (!found_start && state.CurPlayer() != kChancePlayerId) {
+    record.start_player = state.CurPlayer();
+  }
+  REQUIRE(record.dealt.size() < 256 && record.moves.size() < 65536);
+  return record;
+}
+
+HanabiState ReplayGame(const HanabiGame* game, int start_player,
+                       const uint8_t* dealt, int num_dealt,
+                       const uint8_t* moves, int num_moves, int max_moves) {
+  if (max_moves < 0 || max_moves > num_moves) {
+    max_moves = num_moves;
+  }
+  // Records come from files, so check them before they index into game.
+  REQUIRE(start_player >= 0 && start_player < game->NumPlayers());
+  HanabiState state(game, HanabiRng(), start_player);
+  int next_card = 0;
+  int next_move = 0;
+  while (!state.IsTerminal()) {
+    if (state.CurPlayer() == kChancePlayerId) {
+      // A record of an unfinished game ends with the last card dealt.
+      if (next_card == num_dealt) {
+        break;
+      }
+      int index = dealt[next_card++];
+      REQUIRE(index < game->NumColors() * game->NumRanks());
+      state.ApplyMove(HanabiMove(HanabiMove::kDeal, -1, -1,
+                                 index / game->NumRanks(),
+                                 index % game->NumRanks()));
+      continue;
+    }
+    if (next_move == max_moves) {
+      break;
+    }
+    int uid = moves[next_move++];
+    REQUIRE(uid < game->MaxMoves());
+    state.ApplyMove(game->GetMove(uid));
+  }
+  return state;
+}
+
+HanabiState ReplayGame(const HanabiGame* game, const GameRecord& record,
+                       int max_moves) {
+  return ReplayGame(game, record.start_player, record.dealt.data(),
+                    record.dealt.size(), record.moves.data(),
+                    record.moves.size(), max_moves);
+}
+
+void SerializeGameRecord(const GameRecord& record, std::vector<char>* buffer) {
+  uint32_t size =
+      kRecordHeaderSize + record.dealt.size() + record.moves.size();
+  size_t start = buffer->size();
+  buffer->resize(start + size);
+  char* out = buffer->data() + start;
+  PutU32(size, out);
+  PutU16(record.config_id, out + 4);
+  out[6] = static_cast<char>(record.start_player);
+  out[7] = static_cast<char>(record.dealt.size());
+  PutU16(record.moves.size(), out + 8);
+  std::memcpy(out + kRecordHeaderSize, record.dealt.data(),
+              record.dealt.size());
+  std::memcpy(out + kRecordHeaderSize + record.dealt.size(),
+              record.moves.data(), record.moves.size());
+}
+
+GameRecordWriter::GameRecordWriter(const std::string& path, int flush_bytes,
+                                   int flush_interval_ms)
+    : flush_bytes_(flush_bytes), flush_interval_ms_(flush_interval_ms) {
+  file_ = std::fopen(path.c_str(), "ab");
+  REQUIRE(file_ != nullptr);
+  std::fseek(file_, 0, SEEK_END);
+  if (std::ftell(file_) > 0) {
+    FILE* existing = std::fopen(path.c_str(), "rb");
+    REQUIRE(existing != nullptr);
+    char header[kFileHeaderSize];
+    REQUIRE(std::fread(header, 1, kFileHeaderSize, existing) ==
+            kFileHeaderSize);
+    std::fclose(existing);
+    REQUIRE(std::memcmp(header, kMagic, 4) == 0);
+    REQUIRE(GetU32(reinterpret_cast<const uint8_t*>(header) + 4) ==
+            kVersion);
+  } else {
+    char header[kFileHeaderSize];
+    std::memcpy(header, kMagic, 4);
+    PutU32(kVersion, header + 4);
+    REQUIRE(std::fwrite(header, 1, kFileHeaderSize, file_) ==
+            kFileHeaderSize);
+  }
+  thread_ = std::thread(&GameRecordWriter::FlushLoop, this);
+}
+
+GameRecordWriter::~GameRecordWriter() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stop_ = true;
+  }
+  work_cv_.notify_one();
+  thread_.join();
+  std::fclose(file_);
+}
+
+void GameRecordWriter::Append(const GameRecord& record) {
+  bool wake = false;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    SerializeGameRecord(record, &pending_);
+    ++num_appended_;
+    ++num_pending_;
+    wake = pending_.size() >= static_cast<size_t>(flush_bytes_);
+  }
+  if (wake) {
+    work_cv_.notify_one();
+  }
+}
+
+void GameRecordWriter::Flush() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  int64_t target = num_appended_;
+  flush_requested_ = true;
+  work_cv_.notify_one();
+  written_cv_.wait(lock, [this, target] { return num_written_ >= target; });
+}
+
+int64_t GameRecordWriter::NumAppended() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return num_appended_;
+}
+
+void GameRecordWriter::FlushLoop() {
+  // Records are serialized into pending_ by the appending threads and
+  // swapped out here, so file IO never happens under the lock.
+  std::vector<char> writing;
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (true) {
+    work_cv_.wait_for(
+        lock, std::chrono::milliseconds(flush_interval_ms_), [this] {
+          return stop_ || flush_requested_ ||
+                 pending_.size() >= static_cast<size_t>(flush_bytes_);
+        });
+    bool stop = stop_;
+    flush_requested_ = false;
+    writing.swap(pending_);
+    int64_t num_records = num_pending_;
+    num_pending_ = 0;
+    lock.unlock();
+    if (!writing.empty()) {
+      REQUIRE(std::fwrite(writing.data(), 1, writing.size(), file_) ==
+              writing.size());
+      writing.clear();
+    }
+    std::fflush(file_);
+    lock.lock();
+    num_written_ += num_records;
+    written_cv_.notify_all();
+    if (stop && pending_.empty()) {
+      break;
+    }
+  }
+}
+
+GameRecordReader::GameRecordReader(const std::string& path) {
+  int fd = open(path.c_str(), O_RDONLY);
+  REQUIRE(fd >= 0);
+  struct stat st;
+  REQUIRE(fstat(fd, &st) == 0);
+  size_ = st.st_size;
+  REQUIRE(size_ >= kFileHeaderSize);
+  void* data = mmap(nullptr, size_, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  REQUIRE(data != MAP_FAILED);
+  data_ = static_cast<const uint8_t*>(data);
+  REQUIRE(std::memcmp(data_, kMagic, 4) == 0);
+  REQUIRE(GetU32(data_ + 4) == kVersion);
+  // Records are visited in file order, so let the kernel read ahead.
+  madvise(data, size_, MADV_SEQUENTIAL);
+  uint64_t offset = kFileHeaderSize;
+  // A trailing partial record (e.g. from a writer that was killed) is
+  // ignored.
+  while (offset + kRecordHeaderSize <= size_) {
+    uint32_t record_size = GetU32(data_ + offset);
+    REQUIRE(record_size >= kRecordHeaderSize);
+    if (offset + record_size > size_) {
+      break;
+    }
+    offsets_.push_back(offset);
+    offset += record_size;
+  }
+  madvise(data, size_, MADV_RANDOM);
+}
+
+GameRecordReader::~GameRecordReader() {
+  munmap(const_cast<uint8_t*>(data_), size_);
+}
+
+const uint8_t* GameRecordReader::Record(int64_t index) const {
+  REQUIRE(index >= 0 && index < NumRecords());
+  const uint8_t* record = data_ + offsets_[index];
+  // The counts must add up to the record size, so a corrupt record cannot
+  // be read past its end.
+  REQUIRE(kRecordHeaderSize + record[7] + GetU16(record + 8) ==
+          GetU32(record));
+  return record;
+}
+
+GameRecord GameRecordReader::Get(int64_t index) const {
+  const uint8_t* record = Record(index);
+  GameRecord result;
+  result.config_id = GetU16(record + 4);
+  result.start_player = record[6];
+  const uint8_t* dealt = record + kRecordHeaderSize;
+  const uint8_t* moves = dealt + record[7];
+  result.dealt.assign(dealt, moves);
+  result.moves.assign(moves, moves + GetU16(record + 8));
+  return result;
+}
+
+int GameRecordReader::ConfigId(int64_t index) const {
+  return GetU16(Record(index) + 4);
+}
+
+int GameRecordReader::NumMoves(int64_t index) const {
+  return GetU16(Record(index) + 8);
+}
+
+HanabiState GameRecordReader::Replay(int64_t index, const HanabiGame* game,
+                                     int max_moves) const {
+  const uint8_t* record = Record(index);
+  const uint8_t* dealt = record + kRecordHeaderSize;
+  return ReplayGame(game, record[6], dealt, record[7], dealt + record[7],
+                    GetU16(record + 8), max_moves);
+}
+
+}  // namespace hanabi_learning_env
@@ -0,0 +1,142 @@
+// Copyright 2018 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Compact binary log of Hanabi games.
+//
+// A game is fully determined by its parameters, start player, the order in
+// which cards were dealt and the uids of the player moves, so that is all a
+// record stores: one byte per dealt card and one byte per move.
+//
+// File layout (little-endian):
+//   header:  "HREC" uint32 version
+//   records: uint32 record_size  (bytes, including these 10 header bytes)
+//            uint16 config_id    (application-defined id of the game params)
+//            uint8  start_player
+//            uint8  num_dealt
+//            uint16 num_moves
+//            uint8  dealt[num_dealt]   (color * num_ranks + rank)
+//            uint8  moves[num_moves]   (HanabiGame move uids)
+
+#ifndef __GAME_RECORD_H__
+#define __GAME_RECORD_H__
+
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "hanabi_game.h"
+#include "hanabi_state.h"
+
+namespace hanabi_learning_env {
+
+struct GameRecord {
+  // Identifies the HanabiGame parameters. The mapping from ids to
+  // parameters is owned by the application.
+  uint16_t config_id = 0;
+  // First player to act after the initial deal.
+  uint8_t start_player = 0;
+  // Dealt cards in order, encoded as color * num_ranks + rank.
+  std::vector<uint8_t> dealt;
+  // Player moves in order, as move uids of the parent game.
+  std::vector<uint8_t> moves;
+
+  // Captures the history of state, which may be a finished or running game.
+  static GameRecord FromState(const HanabiState& state, uint16_t config_id);
+};
+
+// Replays a record into a new state. If max_moves >= 0, stops before the
+// (max_moves+1)-th player move, after dealing any cards due before it.
+// The state's random stream is HanabiRng(), since no chance is sampled.
+// Fails a REQUIRE if the record does not fit game, e.g. one written with
+// other parameters.
+HanabiState ReplayGame(const HanabiGame* game, int start_player,
+                       const uint8_t* dealt, int num_dealt,
+                       const uint8_t* moves, int num_moves,
+                       int max_moves = -1);
+HanabiState ReplayGame(const HanabiGame* game, const GameRecord& record,
+                       int max_moves = -1);
+
+// Appends the binary form of record (without file header) to buffer.
+void SerializeGameRecord(const GameRecord& record, std::vector<char>* buffer);
+
+// Appends records to a file. Append() only serializes into a memory buffer;
+// a background thread writes buffered records once flush_bytes have
+// accumulated or flush_interval_ms has passed. Safe to use from any number
+// of threads.
+class GameRecordWriter {
+ public:
+  // Appends to path if it already is a record file, otherwise creates it.
+  explicit GameRecordWriter(const std::string& path,
+                            int flush_bytes = 1 << 20,
+                            int flush_interval_ms = 1000);
+  // Writes all pending records and closes the file.
+  ~GameRecordWriter();
+
+  void Append(const GameRecord& record);
+  void Append(const HanabiState& state, uint16_t config_id) {
+    Append(GameRecord::FromState(state, config_id));
+  }
+  // Blocks until every record appended before the call is written.
+  void Flush();
+  int64_t NumAppended() const;
+
+ private:
+  void FlushLoop();
+
+  FILE* file_ = nullptr;
+  int flush_bytes_;
+  int flush_interval_ms_;
+  mutable std::mutex mutex_;
+  std::condition_variable work_cv_;
+  std::condition_variable written_cv_;
+  std::vector<char> pending_;
+  int64_t num_appended_ = 0;
+  int64_t num_written_ = 0;
+  int64_t num_pending_ = 0;
+  bool flush_requested_ = false;
+  bool stop_ = false;
+  std::thread thread_;
+};
+
+// Read-only view of a record file. The file is memory-mapped and indexed
+// once on open; records are decoded or replayed on demand. Thread-safe.
+class GameRecordReader {
+ public:
+  explicit GameRecordReader(const std::string& path);
+  ~GameRecordReader();
+  GameRecordReader(const GameRecordReader&) = delete;
+  GameRecordReader& operator=(const GameRecordReader&) = delete;
+
+  int64_t NumRecords() const { return offsets_.size(); }
+  GameRecord Get(int64_t index) const;
+  int ConfigId(int64_t index) const;
+  int NumMoves(int64_t index) const;
+  HanabiState Replay(int64_t index, const HanabiGame* game,
+                     int max_moves = -1) const;
+
+ private:
+  const uint8_t* Record(int64_t index) const;
+
+  const uint8_t* data_ = nullptr;
+  size_t size_ = 0;
+  std::vector<uint64_t> offsets_;
+};
+
+}  // namespace hanabi_learning_env
+
+#endif
@@ -0,0 +1,160 @@
+// Copyright 2018 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include "game_task.h"
+
+#include <algorithm>
+#include <iterator>
+
+#include "canonical_encoders.h"
+#include "hanabi_observation.h"
+#include "hanabi_policy.h"
+#include "util.h"
+
+namespace hanabi_learning_env {
+
+SelfPlayTask::SelfPlayTask(const HanabiGame* game, const HanabiRng& rng)
+    : state_(game, rng) {}
+
+bool SelfPlayTask::Resume(int move_uid, MoveRequest* request) {
+  REQUIRE(request != nullptr);
+  switch (resume_point_) {
+    case kStart:
+      break;
+    case kAwaitingMove:
+      REQUIRE(move_uid >= 0);
+      state_.ApplyMove(state_.ParentGame()->GetMove(move_uid));
+      break;
+    case kFinished:
+      REQUIRE(false);
+  }
+  while (!state_.IsTerminal() && state_.CurPlayer() == kChancePlayerId) {
+    state_.ApplyRandomChance();
+  }
+  if (state_.IsTerminal()) {
+    resume_point_ = kFinished;
+    return false;
+  }
+  request->state = &state_;
+  request->player = state_.CurPlayer();
+  resume_point_ = kAwaitingMove;
+  return true;
+}
+
+BatchPolicy EncodedBatchPolicy(const HanabiGame* game,
+                               ActorInferenceFn inference) {
+  REQUIRE(game != nullptr);
+  REQUIRE(inference);
+  struct Buffers {
+    explicit Buffers(const HanabiGame* game) : encoder(game) {}
+    CanonicalObservationEncoder encoder;
+    std::vector<float> observations;
+    std::vector<uint8_t> legal_masks;
+    std::vector<int32_t> moves;
+  };
+  std::shared_ptr<Buffers> buffers(new Buffers(game));
+  return [game, inference, buffers](const std::vector<MoveRequest>& requests,
+                                    std::vector<int>* moves) {
+    const int n = requests.size();
+    const int length = buffers->encoder.EncodingLength();
+    const int max_moves = game->MaxMoves();
+    buffers->observations.resize(static_cast<size_t>(n) * length);
+    buffers->legal_masks.resize(n * max_moves);
+    // -1 until the callback answers, so a skipped request cannot reuse the
+    // previous batch's move.
+    buffers->moves.assign(n, -1);
+    for (int i = 0; i < n; ++i) {
+      HanabiObservation observation(*requests[i].state, requests[i].player);
+      buffers->encoder.EncodeInto(
+          observation, false, {}, false, {}, {}, false,
+          buffers->observations.data() + static_cast<size_t>(i) * length);
+      buffers->encoder.EncodeLegalMoves(
+          observation, buffers->legal_masks.data() + i * max_moves);
+    }
+    inference(n, buffers->observations.data(), buffers->legal_masks.data(),
+              buffers->moves.data());
+    std::copy(buffers->moves.begin(), buffers->moves.end(), moves->begin());
+  };
+}
+
+BatchPolicy NativeBatchPolicy(const std::string& policy_name,
+                              uint64_t seed) {
+  std::shared_ptr<HanabiPolicy> policy(MakePolicy(policy_name));
+  REQUIRE(policy != nullptr);
+  std::shared_ptr<uint64_t> num_calls(new uint64_t(0));
+  return [policy, seed, num_calls](const std::vector<MoveRequest>& requests,
+                                   std::vector<int>* moves) {
+    for (int i = 0; i < requests.size(); ++i) {
+      const HanabiState& state = *requests[i].state;
+      HanabiRng rng(seed, i, *num_calls);
+      (*moves)[i] = state.ParentGame()->GetMoveUid(
+          policy->Act(HanabiObservation(state, requests[i].player), &rng));
+    }
+    ++*num_calls;
+  };
+}
+
+TaskScheduler::TaskScheduler(int max_batch, DoneFn done)
+    : max_batch_(max_batch), done_(done) {
+  REQUIRE(max_batch_ > 0);
+}
+
+void TaskScheduler::Spawn(std::unique_ptr<GameTask> task) {
+  REQUIRE(task != nullptr);
+  Resume(std::move(task), -1);
+}
+
+int TaskScheduler::Step(const BatchPolicy& policy) {
+  const int n = std::min<int>(max_batch_, suspended_.size());
+  if (n == 0) {
+    return 0;
+  }
+  // Take the batch out first, resumed tasks and spawned ones queue behind
+  // the rest.
+  resuming_.clear();
+  std::move(suspended_.begin(), suspended_.begin() + n,
+            std::back_inserter(resuming_));
+  suspended_.erase(suspended_.begin(), suspended_.begin() + n);
+  requests_.clear();
+  for (const Suspended& suspended : resuming_) {
+    requests_.push_back(suspended.request);
+  }
+  moves_.assign(n, -1);
+  policy(requests_, &moves_);
+  for (int i = 0; i < n; ++i) {
+    Resume(std::move(resuming_[i].task), moves_[i]);
+  }
+  return n;
+}
+
+int64_t TaskScheduler::RunToCompletion(const BatchPolicy& policy) {
+  int64_t batches = 0;
+  while (Step(policy) > 0) {
+    ++batches;
+  }
+  return batches;
+}
+
+void TaskScheduler::Resume(std::unique_ptr<GameTask> task, int move_uid) {
+  Suspended suspended;
+  if (task->Resume(move_uid, &suspended.request)) {
+    suspended.task = std::move(task);
+    suspended_.push_back(std::move(suspended));
+  } else if (done_) {
+    done_(std::move(task));
+  }
+}
+
+}  // namespace hanabi_learning_env
@@ -0,0 +1,130 @@
+// Copyright 2018 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+// Resumable game tasks and a scheduler that answers their move requests in
+// batches.
+//
+// A GameTask is a game loop written as an explicit state machine: Resume()
+// runs until the task needs a move it cannot choose itself, describes that
+// decision in a MoveRequest and returns, and is later resumed with the
+// chosen move. This is the shape of a coroutine that awaits moves, without
+// the C++20 support this library does not build with. The scheduler keeps
+// thousands of suspended tasks on a single thread, hands the pending
+// requests of up to max_batch of them to one batched policy call and
+// resumes each task with its move.
+
+#ifndef __GAME_TASK_H__
+#define __GAME_TASK_H__
+
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "actor_pipeline.h"
+#include "hanabi_game.h"
+#include "hanabi_rng.h"
+#include "hanabi_state.h"
+
+namespace hanabi_learning_env {
+
+// A decision a suspended task waits for: a move uid for player in state.
+// The state is owned by the task and stays valid until it is resumed.
+struct MoveRequest {
+  const HanabiState* state = nullptr;
+  int player = -1;
+};
+
+class GameTask {
+ public:
+  virtual ~GameTask() = default;
+  // Runs the task until it needs a move, which it describes in *request
+  // before returning true, or until it finishes and returns false. move_uid
+  // answers the previous request, and is -1 on the first call.
+  virtual bool Resume(int move_uid, MoveRequest* request) = 0;
+};
+
+// Plays one game from the start, awaiting every player move. Chance moves
+// are drawn from rng.
+class SelfPlayTask : public GameTask {
+ public:
+  SelfPlayTask(const HanabiGame* game, const HanabiRng& rng);
+  bool Resume(int move_uid, MoveRequest* request) override;
+  const HanabiState& State() const { return state_; }
+
+ private:
+  enum ResumePoint { kStart, kAwaitingMove, kFinished };
+
+  HanabiState state_;
+  ResumePoint resume_point_ = kStart;
+};
+
+// Batched policy. Writes one move uid per request to (*moves)[i], which is
+// pre-sized.
+using BatchPolicy = std::function<void(
+    const std::vector<MoveRequest>& requests, std::vector<int>* moves)>;
+
+// Adapts an ActorInferenceFn: each batch of requests is encoded with
+// CanonicalObservationEncoder, from the view of the requested player, into
+// buffers kept across calls. Moves the callback leaves unset are -1.
+BatchPolicy EncodedBatchPolicy(const HanabiGame* game,
+                               ActorInferenceFn inference);
+
+// Answers every request with the built-in policy registered under
+// policy_name (see MakePolicy). Request i of the n-th call draws from
+// HanabiRng(seed, i, n). The returned policy must not be called
+// concurrently.
+BatchPolicy NativeBatchPolicy(const std::string& policy_name, uint64_t seed);
+
+// Not thread-safe. Tasks may be spawned from the done callback.
+class TaskScheduler {
+ public:
+  using DoneFn = std::function<void(std::unique_ptr<GameTask> task)>;
+
+  // Finished tasks are passed to done if it is set, and deleted otherwise.
+  explicit TaskScheduler(int max_batch, DoneFn done = DoneFn());
+
+  // Runs task to its first suspension.
+  void Spawn(std::unique_ptr<GameTask> task);
+  int NumSuspended() const { return static_cast<int>(suspended_.size()); }
+
+  // Answers the requests of the max_batch longest suspended tasks with one
+  // call to policy and resumes them. Returns the number of tasks resumed.
+  int Step(const BatchPolicy& policy);
+  // Steps until no task is suspended. Returns the number of batches.
+  int64_t RunToCompletion(const BatchPolicy& policy);
+
+ private:
+  struct Suspended {
+    std::unique_ptr<GameTask> task;
+    MoveRequest request;
+  };
+
+  void Resume(std::unique_ptr<GameTask> task, int move_uid);
+
+  int max_batch_;
+  DoneFn done_;
+  std::deque<Suspended> suspended_;
+  // Reused across steps.
+  std::vector<Suspended> resuming_;
+  std::vector<MoveRequest> requests_;
+  std::vector<int> moves_;
+};
+
+}  // namespace hanabi_learning_env
+
+#endif
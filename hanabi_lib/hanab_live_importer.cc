@@ -0,0 +1,467 @@
+// Copyright 2018 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include "hanab_live_importer.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <vector>
+
+#include "hanabi_state.h"
+#include "util.h"
+
+namespace hanabi_learning_env {
+
+namespace {
+
+// Forward-only JSON tokenizer. Every Read/Skip method consumes one value
+// and returns false on malformed input.
+class JsonCursor {
+ public:
+  JsonCursor(const char* begin, const char* end) : pos_(begin), end_(end) {}
+
+  bool AtEnd() {
+    SkipWhitespace();
+    return pos_ == end_;
+  }
+
+  bool Peek(char c) {
+    SkipWhitespace();
+    return pos_ < end_ && *pos_ == c;
+  }
+
+  bool Consume(char c) {
+    if (!Peek(c)) {
+      return false;
+    }
+    ++pos_;
+    return true;
+  }
+
+  bool ReadString(std::string* out) {
+    if (!Consume('"')) {
+      return false;
+    }
+    out->clear();
+    while (pos_ < end_ && *pos_ != '"') {
+      if (*pos_ == '\\') {
+        if (++pos_ == end_) {
+          return false;
+        }
+        switch (*pos_) {
+          case 'n':
+            out->push_back('\n');
+            break;
+          case 't':
+            out->push_back('\t');
+            break;
+          case 'r':
+            out->push_back('\r');
+            break;
+          case 'b':
+            out->push_back('\b');
+            break;
+          case 'f':
+            out->push_back('\f');
+            break;
+          case 'u':
+            // Non-ASCII text is never interpreted, so it is not decoded.
+            if (end_ - pos_ < 5) {
+              return false;
+            }
+            pos_ += 4;
+            out->push_back('?');
+            break;
+          default:
+            out->push_back(*pos_);
+        }
+      } else {
+        out->push_back(*pos_);
+      }
+      ++pos_;
+    }
+    return Consume('"');
+  }
+
+  // Reads a number, dropping any fractional part.
+  bool ReadInt(int64_t* out) {
+    SkipWhitespace();
+    bool negative = pos_ < end_ && *pos_ == '-';
+    if (negative) {
+      ++pos_;
+    }
+    if (pos_ == end_ || !IsDigit(*pos_)) {
+      return false;
+    }
+    int64_t value = 0;
+    while (pos_ < end_ && IsDigit(*pos_)) {
+      value = value * 10 + (*pos_++ - '0');
+    }
+    while (pos_ < end_ && (IsDigit(*pos_) || *pos_ == '.' || *pos_ == 'e' ||
+                           *pos_ == 'E' || *pos_ == '+' || *pos_ == '-')) {
+      ++pos_;
+    }
+    *out = negative ? -value : value;
+    return true;
+  }
+
+  bool ReadInt(int* out) {
+    int64_t value;
+    if (!ReadInt(&value)) {
+      return false;
+    }
+    *out = static_cast<int>(value);
+    return true;
+  }
+
+  bool ReadBool(bool* out) {
+    if (ReadLiteral("true")) {
+      *out = true;
+      return true;
+    }
+    *out = false;
+    return ReadLiteral("false");
+  }
+
+  bool SkipValue() {
+    SkipWhitespace();
+    if (pos_ == end_) {
+      return false;
+    }
+    switch (*pos_) {
+      case '"': {
+        std::string unused;
+        return ReadString(&unused);
+      }
+      case '{':
+        return ForEachMember([this](const std::string&) {
+          return SkipValue();
+        });
+      case '[':
+        return ForEachElement([this] { return SkipValue(); });
+      case 't':
+        return ReadLiteral("true");
+      case 'f':
+        return ReadLiteral("false");
+      case 'n':
+        return ReadLiteral("null");
+      default: {
+        int64_t unused;
+        return ReadInt(&unused);
+      }
+    }
+  }
+
+  // Calls member(key) for each member of an object, with the cursor on the
+  // member's value. member must consume the value.
+  template <typename F>
+  bool ForEachMember(F member) {
+    if (!Consume('{')) {
+      return false;
+    }
+    if (Consume('}')) {
+      return true;
+    }
+    std::string key;
+    do {
+      if (!ReadString(&key) || !Consume(':') || !member(key)) {
+        return false;
+      }
+    } while (Consume(','));
+    return Consume('}');
+  }
+
+  // Calls element() for each element of an array, which it must consume.
+  template <typename F>
+  bool ForEachElement(F element) {
+    if (!Consume('[')) {
+      return false;
+    }
+    if (Consume(']')) {
+      return true;
+    }
+    do {
+      if (!element()) {
+        return false;
+      }
+    } while (Consume(','));
+    return Consume(']');
+  }
+
+ private:
+  static bool IsDigit(char c) { return c >= '0' && c <= '9'; }
+
+  void SkipWhitespace() {
+    while (pos_ < end_ &&
+           (*pos_ == ' ' || *pos_ == '\n' || *pos_ == '\r' || *pos_ == '\t')) {
+      ++pos_;
+    }
+  }
+
+  bool ReadLiteral(const char* literal) {
+    SkipWhitespace();
+    const char* p = pos_;
+    for (; *literal != '\0'; ++literal, ++p) {
+      if (p == end_ || *p != *literal) {
+        return false;
+      }
+    }
+    pos_ = p;
+    return true;
+  }
+
+  const char* pos_;
+  const char* end_;
+};
+
+struct JsonAction {
+  enum Type { kPlay = 0, kDiscard = 1, kColorClue = 2, kRankClue = 3,
+              kGameOver = 4 };
+  int type = -1;
+  int target = -1;
+  int value = -1;
+};
+
+struct JsonGame {
+  int num_players = 0;
+  std::vector<std::pair<int, int>> deck;  // (suitIndex, rank), rank 1-based.
+  std::vector<JsonAction> actions;
+  std::string variant = "No Variant";
+  int starting_player = 0;
+  // Options changing the rules beyond what HanabiGame models.
+  bool unsupported_option = false;
+};
+
+bool ParseOptions(JsonCursor* cursor, JsonGame* game) {
+  return cursor->ForEachMember([cursor, game](const std::string& key) {
+    if (key == "variant") {
+      return cursor->ReadString(&game->variant);
+    } else if (key == "startingPlayer") {
+      return cursor->ReadInt(&game->starting_player);
+    } else if (key == "oneExtraCard" || key == "oneLessCard" ||
+               key == "allOrNothing" || key == "deckPlays" ||
+               key == "emptyClues" || key == "detrimentalCharacters") {
+      bool enabled;
+      if (!cursor->ReadBool(&enabled)) {
+        return false;
+      }
+      game->unsupported_option |= enabled;
+      return true;
+    }
+    return cursor->SkipValue();
+  });
+}
+
+bool ParseGame(JsonCursor* cursor, JsonGame* game) {
+  return cursor->ForEachMember([cursor, game](const std::string& key) {
+    if (key == "players") {
+      return cursor->ForEachElement([cursor, game] {
+        ++game->num_players;
+        return cursor->SkipValue();
+      });
+    } else if (key == "deck") {
+      return cursor->ForEachElement([cursor, game] {
+        std::pair<int, int> card(-1, -1);
+        game->deck.push_back(card);
+        return cursor->ForEachMember([cursor, game](const std::string& key) {
+          if (key == "suitIndex") {
+            return cursor->ReadInt(&game->deck.back().first);
+          } else if (key == "rank") {
+            return cursor->ReadInt(&game->deck.back().second);
+          }
+          return cursor->SkipValue();
+        });
+      });
+    } else if (key == "actions") {
+      return cursor->ForEachElement([cursor, game] {
+        game->actions.push_back(JsonAction());
+        JsonAction* action = &game->actions.back();
+        return cursor->ForEachMember([cursor, action](const std::string& key) {
+          if (key == "type") {
+            return cursor->ReadInt(&action->type);
+          } else if (key == "target") {
+            return cursor->ReadInt(&action->target);
+          } else if (key == "value") {
+            return cursor->ReadInt(&action->value);
+          }
+          return cursor->SkipValue();
+        });
+      });
+    } else if (key == "options") {
+      return ParseOptions(cursor, game);
+    }
+    return cursor->SkipValue();
+  });
+}
+
+// Replays json_game under game. Returns false if the game does not fit the
+// game's parameters or contains a move the engine considers illegal.
+bool ReplayJsonGame(const HanabiGame* game, const JsonGame& json_game,
+                    GameRecord* record) {
+  const int num_players = game->NumPlayers();
+  if (json_game.num_players != num_players ||
+      json_game.variant != "No Variant" || json_game.unsupported_option ||
+      json_game.starting_player < 0 ||
+      json_game.starting_player >= num_players) {
+    return false;
+  }
+  for (const auto& card : json_game.deck) {
+    if (card.first < 0 || card.first >= game->NumColors() ||
+        card.second < 1 || card.second > game->NumRanks()) {
+      return false;
+    }
+  }
+
+  HanabiState state(game, HanabiRng(), json_game.starting_player);
+  // Card orders (deck indices) of each hand, in the engine's slot order.
+  std::vector<std::vector<int>> hand_orders(num_players);
+  int next_card = 0;
+  auto deal_cards = [&] {
+    while (state.CurPlayer() == kChancePlayerId && !state.IsTerminal()) {
+      if (next_card == json_game.deck.size()) {
+        return false;
+      }
+      const auto& card = json_game.deck[next_card];
+      HanabiMove deal(HanabiMove::kDeal, -1, -1, card.first, card.second - 1);
+      if (!state.MoveIsLegal(deal)) {
+        return false;
+      }
+      state.ApplyMove(deal);
+      hand_orders[state.MoveHistory().back().deal_to_player].push_back(
+          next_card++);
+    }
+    return true;
+  };
+
+  for (const auto& action : json_game.actions) {
+    if (!deal_cards()) {
+      return false;
+    }
+    if (state.IsTerminal() || action.type == JsonAction::kGameOver) {
+      break;
+    }
+    const int player = state.CurPlayer();
+    HanabiMove move(HanabiMove::kInvalid, -1, -1, -1, -1);
+    std::vector<int>& orders = hand_orders[player];
+    auto card = std::find(orders.begin(), orders.end(), action.target);
+    const int offset = (action.target - player + num_players) % num_players;
+    switch (action.type) {
+      case JsonAction::kPlay:
+      case JsonAction::kDiscard:
+        if (card == orders.end()) {
+          return false;
+        }
+        move = HanabiMove(action.type == JsonAction::kPlay
+                              ? HanabiMove::kPlay
+                              : HanabiMove::kDiscard,
+                          card - orders.begin(), -1, -1, -1);
+        break;
+      case JsonAction::kColorClue:
+        if (action.target < 0 || action.target >= num_players ||
+            action.value < 0 || action.value >= game->NumColors()) {
+          return false;
+        }
+        move = HanabiMove(HanabiMove::kRevealColor, -1, offset, action.value,
+                          -1);
+        break;
+      case JsonAction::kRankClue:
+        if (action.target < 0 || action.target >= num_players ||
+            action.value < 1 || action.value > game->NumRanks()) {
+          return false;
+        }
+        move = HanabiMove(HanabiMove::kRevealRank, -1, offset, -1,
+                          action.value - 1);
+        break;
+      default:
+        return false;
+    }
+    if (!state.MoveIsLegal(move)) {
+      return false;
+    }
+    state.ApplyMove(move);
+    if (move.MoveType() == HanabiMove::kPlay ||
+        move.MoveType() == HanabiMove::kDiscard) {
+      orders.erase(card);
+    }
+  }
+  *record = GameRecord::FromState(state, 0);
+  return true;
+}
+
+}  // namespace
+
+HanabLiveImportStats HanabLiveImporter::Import(
+    const char* text, size_t size,
+    const std::function<void(GameRecord&& record)>& on_game) const {
+  HanabLiveImportStats stats;
+  JsonCursor cursor(text, text + size);
+  auto import_game = [&] {
+    JsonGame json_game;
+    if (!ParseGame(&cursor, &json_game)) {
+      return false;
+    }
+    GameRecord record;
+    if (ReplayJsonGame(game_, json_game, &record)) {
+      on_game(std::move(record));
+      ++stats.num_imported;
+    } else {
+      ++stats.num_skipped;
+    }
+    return true;
+  };
+  while (!cursor.AtEnd()) {
+    bool ok = cursor.Peek('[') ? cursor.ForEachElement(import_game)
+                               : import_game();
+    if (!ok) {
+      stats.error = "malformed JSON after " +
+                    std::to_string(stats.num_imported + stats.num_skipped) +
+                    " games";
+      break;
+    }
+  }
+  return stats;
+}
+
+HanabLiveImportStats HanabLiveImporter::ImportFile(
+    const std::string& path,
+    const std::function<void(GameRecord&& record)>& on_game) const {
+  HanabLiveImportStats stats;
+  int fd = open(path.c_str(), O_RDONLY);
+  if (fd < 0) {
+    stats.error = "cannot open " + path;
+    return stats;
+  }
+  struct stat st;
+  if (fstat(fd, &st) != 0 || st.st_size == 0) {
+    close(fd);
+    return stats;
+  }
+  void* data = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (data == MAP_FAILED) {
+    stats.error = "cannot map " + path;
+    return stats;
+  }
+  madvise(data, st.st_size, MADV_SEQUENTIAL);
+  stats = Import(static_cast<const char*>(data), st.st_size, on_game);
+  munmap(data, st.st_size);
+  return stats;
+}
+
+}  // namespace hanabi_learning_env
@@ -0,0 +1,74 @@
+// Copyright 2018 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+// Importer for game logs in the hanab.live JSON export format:
+//
+//   {"players": ["alice", "bob"],
+//    "deck": [{"suitIndex": 0, "rank": 1}, ...],
+//    "actions": [{"type": 0, "target": 3}, {"type": 2, "target": 1,
+//                 "value": 4}, ...],
+//    "options": {"variant": "No Variant", "startingPlayer": 0}}
+//
+// Action types are 0 play, 1 discard (target is the card order, i.e. its
+// index in the deck), 2 color clue and 3 rank clue (target is the player,
+// value the suit index or 1-based rank) and 4 game over. Input may hold one
+// game, an array of games, or several games one after the other (JSON lines).
+//
+// Parsing is a single forward pass over the text without building a
+// document. Each game is replayed through HanabiState, with the recorded
+// deck forced through chance moves, and returned as a GameRecord.
+
+#ifndef __HANAB_LIVE_IMPORTER_H__
+#define __HANAB_LIVE_IMPORTER_H__
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+
+#include "game_record.h"
+#include "hanabi_game.h"
+
+namespace hanabi_learning_env {
+
+struct HanabLiveImportStats {
+  int64_t num_imported = 0;
+  // Games for a different number of players or a variant the game does not
+  // model, and games with a move that is illegal under the game's rules.
+  int64_t num_skipped = 0;
+  // Set when the text is not well-formed JSON. Parsing stops there.
+  std::string error;
+};
+
+class HanabLiveImporter {
+ public:
+  explicit HanabLiveImporter(const HanabiGame* game) : game_(game) {}
+
+  // Calls on_game for every game in text that can be played under game_.
+  HanabLiveImportStats Import(
+      const char* text, size_t size,
+      const std::function<void(GameRecord&& record)>& on_game) const;
+  // Memory-maps path and imports it.
+  HanabLiveImportStats ImportFile(
+      const std::string& path,
+      const std::function<void(GameRecord&& record)>& on_game) const;
+
+ private:
+  const HanabiGame* game_;
+};
+
+}  // namespace hanabi_learning_env
+
+#endif
@@ -14,6 +14,11 @@
 
 #include "hanabi_game.h"
 
+#include <map>
+#include <mutex>
+#include <random>
+#include <tuple>
+
 #include "util.h"
 
 namespace hanabi_learning_env {
@@ -27,31 +32,30 @@ const bool kDefaultRandomStart = false;
 }  // namespace
 
 HanabiGame::HanabiGame(
-    const std::unordered_map<std::string, std::string>& params) {
-  params_ = params;
-  num_players_ = ParameterValue<int>(params_, "players", kDefaultPlayers);
+    const std::unordered_map<std::string, std::string>& params)
+    : next_episode_id_(std::make_shared<std::atomic<uint64_t>>(0)) {
+  num_players_ = ParameterValue<int>(params, "players", kDefaultPlayers);
   REQUIRE(num_players_ >= MinPlayers() && num_players_ <= MaxPlayers());
-  num_colors_ = ParameterValue<int>(params_, "colors", kMaxNumColors);
+  num_colors_ = ParameterValue<int>(params, "colors", kMaxNumColors);
   REQUIRE(num_colors_ > 0 && num_colors_ <= kMaxNumColors);
-  num_ranks_ = ParameterValue<int>(params_, "ranks", kMaxNumRanks);
+  num_ranks_ = ParameterValue<int>(params, "ranks", kMaxNumRanks);
   REQUIRE(num_ranks_ > 0 && num_ranks_ <= kMaxNumRanks);
-  hand_size_ = ParameterValue<int>(params_, "hand_size", HandSizeFromRules());
+  hand_size_ = ParameterValue<int>(params, "hand_size", HandSizeFromRules());
   max_information_tokens_ = ParameterValue<int>(
-      params_, "max_information_tokens", kInformationTokens);
+      params, "max_information_tokens", kInformationTokens);
   max_life_tokens_ =
-      ParameterValue<int>(params_, "max_life_tokens", kLifeTokens);
-  seed_ = ParameterValue<int>(params_, "seed", -1);
+      ParameterValue<int>(params, "max_life_tokens", kLifeTokens);
+  seed_ = ParameterValue<int>(params, "seed", -1);
   random_start_player_ =
-      ParameterValue<bool>(params_, "random_start_player", kDefaultRandomStart);
+      ParameterValue<bool>(params, "random_start_player", kDefaultRandomStart);
   observation_type_ = AgentObservationType(ParameterValue<int>(
-      params_, "observation_type", AgentObservationType::kCardKnowledge));
-  bomb_ = ParameterValue<int>(params_, "bomb", 0);
-  using_joint_obs_for_any_num_players_ = ParameterValue<bool>(params_, "using_joint_obs", false);
+      params, "observation_type", AgentObservationType::kCardKnowledge));
+  bomb_ = ParameterValue<int>(params, "bomb", 0);
+  using_joint_obs_for_any_num_players_ = ParameterValue<bool>(params, "using_joint_obs", false);
 
   while (seed_ == -1) {
     seed_ = std::random_device()();
   }
-  rng_.seed(seed_);
 
   // Work out number of cards per color, and check deck size is large enough.
   cards_per_color_ = 0;
@@ -60,13 +64,35 @@ HanabiGame::HanabiGame(
   }
   REQUIRE(hand_size_ * num_players_ <= cards_per_color_ * num_colors_);
 
-  // Build static list of moves.
-  for (int uid = 0; uid < MaxMoves(); ++uid) {
-    moves_.push_back(ConstructMove(uid));
-  }
-  for (int uid = 0; uid < MaxChanceOutcomes(); ++uid) {
-    chance_outcomes_.push_back(ConstructChanceOutcome(uid));
-  }
+  tables_ = SharedMoveTables();
+  moves_ = tables_->moves.data();
+  chance_outcomes_ = tables_->chance_outcomes.data();
+}
+
+std::shared_ptr<const HanabiGame::MoveTables> HanabiGame::SharedMoveTables()
+    const {
+  // Moves only depend on these parameters.
+  typedef std::tuple<int, int, int, int, bool> Key;
+  static std::mutex mutex;
+  static std::map<Key, std::weak_ptr<const MoveTables>> cache;
+
+  Key key(num_players_, num_colors_, num_ranks_, hand_size_,
+          using_joint_obs_for_any_num_players_);
+  std::lock_guard<std::mutex> lock(mutex);
+  std::shared_ptr<const MoveTables> tables = cache[key].lock();
+  if (tables == nullptr) {
+    auto new_tables = std::make_shared<MoveTables>();
+    // Build static list of moves.
+    for (int uid = 0; uid < MaxMoves(); ++uid) {
+      new_tables->moves.push_back(ConstructMove(uid));
+    }
+    for (int uid = 0; uid < MaxChanceOutcomes(); ++uid) {
+      new_tables->chance_outcomes.push_back(ConstructChanceOutcome(uid));
+    }
+    tables = new_tables;
+    cache[key] = tables;
+  }
+  return tables;
 }
 
 int HanabiGame::MaxMoves() const {
@@ -124,10 +150,11 @@ int HanabiGame::GetChanceOutcomeUid(HanabiMove move) const {
 
 HanabiMove HanabiGame::PickRandomChance(
     const std::pair<std::vector<HanabiMove>, std::vector<double>>&
-        chance_outcomes) const {
-  std::discrete_distribution<std::mt19937::result_type> dist(
-      chance_outcomes.second.begin(), chance_outcomes.second.end());
-  return chance_outcomes.first[dist(rng_)];
+        chance_outcomes,
+    HanabiRng* rng) const {
+  std::discrete_distribution<int> dist(chance_outcomes.second.begin(),
+                                       chance_outcomes.second.end());
+  return chance_outcomes.first[dist(*rng)];
 }
 
 std::unordered_map<std::string, std::string> HanabiGame::Parameters() const {
@@ -154,15 +181,18 @@ int HanabiGame::NumberCardInstances(int color, int rank) const {
   return 2;
 }
 
-int HanabiGame::GetSampledStartPlayer() const {
+int HanabiGame::GetSampledStartPlayer(HanabiRng* rng) const {
   if (random_start_player_) {
-    std::uniform_int_distribution<std::mt19937::result_type> dist(
-        0, num_players_ - 1);
-    return dist(rng_);
+    std::uniform_int_distribution<int> dist(0, num_players_ - 1);
+    return dist(*rng);
   }
   return 0;
 }
 
+HanabiRng HanabiGame::NextEpisodeRng() const {
+  return HanabiRng(seed_, 0, next_episode_id_->fetch_add(1));
+}
+
 int HanabiGame::HandSizeFromRules() const {
   if (num_players_ < 4) {
     return 5;
@@ -15,16 +15,24 @@
 #ifndef __HANABI_GAME_H__
 #define __HANABI_GAME_H__
 
-#include <random>
+#include <atomic>
+#include <memory>
 #include <string>
 #include <unordered_map>
 #include <vector>
 
 #include "hanabi_card.h"
 #include "hanabi_move.h"
+#include "hanabi_rng.h"
 
 namespace hanabi_learning_env {
 
+// Rules and move tables of a Hanabi variant.
+//
+// A HanabiGame is immutable after construction and holds no random state:
+// all randomness lives in the HanabiRng of each HanabiState. One game can
+// therefore be shared by any number of states and threads without locking.
+// Move tables are shared between all games with the same move layout.
 class HanabiGame {
  public:
   // An agent's observation of a state does include all state knowledge.
@@ -59,10 +67,11 @@ class HanabiGame {
   // Get unique id for a chance-outcome move. Returns -1 for invalid move.
   int GetChanceOutcomeUid(HanabiMove move) const;
   // Randomly sample a random chance-outcome move from list of moves and
-  // associated probability distribution.
+  // associated probability distribution, drawing from rng.
   HanabiMove PickRandomChance(
       const std::pair<std::vector<HanabiMove>, std::vector<double>>&
-          chance_outcomes) const;
+          chance_outcomes,
+      HanabiRng* rng) const;
 
   std::unordered_map<std::string, std::string> Parameters() const;
   int MinPlayers() const { return 2; }
@@ -85,18 +94,17 @@ class HanabiGame {
   }
   AgentObservationType ObservationType() const { return observation_type_; }
 
-  // Get the first player to act. Might be randomly generated at each call.
-  int GetSampledStartPlayer() const;
-
-  int Bomb() const { return bomb_; }
+  // Get the first player to act. Might be randomly drawn from rng.
+  int GetSampledStartPlayer(HanabiRng* rng) const;
 
-  void SetSeed(int seed) const {
-    rng_.seed(seed);
-  }
+  // Global seed of the random streams of states created from this game.
+  int Seed() const { return seed_; }
+  // Stream for a state created without an explicit HanabiRng:
+  // HanabiRng(Seed(), 0, n) for n = 0, 1, 2, ... in order of the calls.
+  // Copies of a game share the episode counter.
+  HanabiRng NextEpisodeRng() const;
 
-  std::mt19937* rng() const {
-    return &rng_;
-  }
+  int Bomb() const { return bomb_; }
 
  private:
   // Calculating max moves by move type.
@@ -113,11 +121,20 @@ class HanabiGame {
   HanabiMove ConstructMove(int uid) const;
   HanabiMove ConstructChanceOutcome(int uid) const;
 
-  // Table of all possible moves in this game.
-  std::vector<HanabiMove> moves_;
-  // Table of all possible chance outcomes in this game.
-  std::vector<HanabiMove> chance_outcomes_;
-  std::unordered_map<std::string, std::string> params_;
+  struct MoveTables {
+    // Table of all possible moves in this game.
+    std::vector<HanabiMove> moves;
+    // Table of all possible chance outcomes in this game.
+    std::vector<HanabiMove> chance_outcomes;
+  };
+  // Returns the tables of an existing game with the same move layout, or
+  // builds new ones.
+  std::shared_ptr<const MoveTables> SharedMoveTables() const;
+
+  std::shared_ptr<const MoveTables> tables_;
+  // Point into tables_.
+  const HanabiMove* moves_ = nullptr;
+  const HanabiMove* chance_outcomes_ = nullptr;
   int num_colors_ = -1;
   int num_ranks_ = -1;
   int num_players_ = -1;
@@ -129,7 +146,7 @@ class HanabiGame {
   bool random_start_player_ = false;
   AgentObservationType observation_type_ = kCardKnowledge;
   int bomb_ = 0;
-  mutable std::mt19937 rng_;
+  std::shared_ptr<std::atomic<uint64_t>> next_episode_id_;
 
   bool using_joint_obs_for_any_num_players_ = false;
 };
@@ -17,6 +17,7 @@
 #include <algorithm>
 #include <cassert>
 
+#include "instrumentation.h"
 #include "util.h"
 
 namespace hanabi_learning_env {
@@ -62,6 +63,7 @@ HanabiObservation::HanabiObservation(const HanabiState& state,
       life_tokens_(state.LifeTokens()),
       legal_moves_(state.LegalMoves(observing_player)),
       parent_game_(state.ParentGame()) {
+  HANABI_PROBE(kProbeObservation);
   REQUIRE(observing_player >= 0 &&
           observing_player < state.ParentGame()->NumPlayers());
   hands_.reserve(state.Hands().size());
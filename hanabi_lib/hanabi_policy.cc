@@ -0,0 +1,274 @@
+// Copyright 2018 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include "hanabi_policy.h"
+
+#include <algorithm>
+#include <random>
+
+#include "util.h"
+
+namespace hanabi_learning_env {
+
+namespace {
+
+using CardKnowledge = HanabiHand::CardKnowledge;
+
+bool KnownPlayable(const HanabiObservation& obs,
+                   const CardKnowledge& knowledge) {
+  const HanabiGame* game = obs.ParentGame();
+  for (int color = 0; color < game->NumColors(); ++color) {
+    for (int rank = 0; rank < game->NumRanks(); ++rank) {
+      if (knowledge.IsCardPlausible(color, rank) &&
+          !obs.CardPlayableOnFireworks(color, rank)) {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+bool KnownPlayed(const HanabiObservation& obs,
+                 const CardKnowledge& knowledge) {
+  const HanabiGame* game = obs.ParentGame();
+  for (int color = 0; color < game->NumColors(); ++color) {
+    for (int rank = 0; rank < game->NumRanks(); ++rank) {
+      if (knowledge.IsCardPlausible(color, rank) &&
+          rank >= obs.Fireworks()[color]) {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+// Whether card is still needed and its other copies were all discarded.
+bool Critical(const HanabiObservation& obs, HanabiCard card) {
+  if (card.Rank() < obs.Fireworks()[card.Color()]) {
+    return false;
+  }
+  int discarded = 0;
+  for (const HanabiCard& discard : obs.DiscardPile()) {
+    discarded += discard == card;
+  }
+  return obs.ParentGame()->NumberCardInstances(card) - discarded == 1;
+}
+
+// Oldest card without hints, or -1.
+int Chop(const std::vector<CardKnowledge>& knowledge) {
+  for (int i = 0; i < knowledge.size(); ++i) {
+    if (!knowledge[i].ColorHinted() && !knowledge[i].RankHinted()) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+HanabiMove PlayKnownPlayable(const HanabiObservation& obs) {
+  const auto& knowledge = obs.Hands()[0].Knowledge();
+  for (int i = 0; i < knowledge.size(); ++i) {
+    if (KnownPlayable(obs, knowledge[i])) {
+      return HanabiMove(HanabiMove::kPlay, i, -1, -1, -1);
+    }
+  }
+  return HanabiMove(HanabiMove::kInvalid, -1, -1, -1, -1);
+}
+
+// The hint about the card at index of the player at offset that leaves it
+// known playable if there is one, otherwise the rank or color they lack,
+// rank first.
+HanabiMove HintCard(const HanabiObservation& obs, int offset, int index) {
+  const HanabiCard card = obs.Hands()[offset].Cards()[index];
+  const CardKnowledge& knowledge = obs.Hands()[offset].Knowledge()[index];
+  HanabiMove rank_hint(HanabiMove::kRevealRank, -1, offset, -1, card.Rank());
+  HanabiMove color_hint(HanabiMove::kRevealColor, -1, offset, card.Color(),
+                        -1);
+  if (knowledge.RankHinted()) {
+    return color_hint;
+  }
+  if (knowledge.ColorHinted()) {
+    return rank_hint;
+  }
+  const HanabiGame* game = obs.ParentGame();
+  bool rank_completes = true;
+  for (int color = 0; color < game->NumColors(); ++color) {
+    rank_completes &= !knowledge.ColorPlausible(color) ||
+                      obs.CardPlayableOnFireworks(color, card.Rank());
+  }
+  bool color_completes = true;
+  for (int rank = 0; rank < game->NumRanks(); ++rank) {
+    color_completes &= !knowledge.RankPlausible(rank) ||
+                       obs.CardPlayableOnFireworks(card.Color(), rank);
+  }
+  return color_completes && !rank_completes ? color_hint : rank_hint;
+}
+
+HanabiMove HintPlayable(const HanabiObservation& obs) {
+  if (obs.InformationTokens() > 0) {
+    const auto& hands = obs.Hands();
+    for (int offset = 1; offset < hands.size(); ++offset) {
+      const auto& cards = hands[offset].Cards();
+      const auto& knowledge = hands[offset].Knowledge();
+      for (int i = 0; i < cards.size(); ++i) {
+        if (obs.CardPlayableOnFireworks(cards[i]) &&
+            !KnownPlayable(obs, knowledge[i])) {
+          return HintCard(obs, offset, i);
+        }
+      }
+    }
+  }
+  return HanabiMove(HanabiMove::kInvalid, -1, -1, -1, -1);
+}
+
+// Discards a card known to be played, else the chop, else the oldest card.
+// Invalid with all information tokens available.
+HanabiMove Discard(const HanabiObservation& obs) {
+  if (obs.InformationTokens() >= obs.ParentGame()->MaxInformationTokens()) {
+    return HanabiMove(HanabiMove::kInvalid, -1, -1, -1, -1);
+  }
+  const auto& knowledge = obs.Hands()[0].Knowledge();
+  for (int i = 0; i < knowledge.size(); ++i) {
+    if (KnownPlayed(obs, knowledge[i])) {
+      return HanabiMove(HanabiMove::kDiscard, i, -1, -1, -1);
+    }
+  }
+  const int chop = Chop(knowledge);
+  return HanabiMove(HanabiMove::kDiscard, std::max(chop, 0), -1, -1, -1);
+}
+
+// The first legal hint, else playing the oldest card.
+HanabiMove AnyHintOrPlay(const HanabiObservation& obs) {
+  for (const HanabiMove& move : obs.LegalMoves()) {
+    if (move.MoveType() == HanabiMove::kRevealColor ||
+        move.MoveType() == HanabiMove::kRevealRank) {
+      return move;
+    }
+  }
+  return HanabiMove(HanabiMove::kPlay, 0, -1, -1, -1);
+}
+
+}  // namespace
+
+HanabiMove RandomPolicy::Act(const HanabiObservation& obs, HanabiRng* rng) {
+  const auto& legal_moves = obs.LegalMoves();
+  REQUIRE(!legal_moves.empty());
+  std::uniform_int_distribution<int> dist(0, legal_moves.size() - 1);
+  return legal_moves[dist(*rng)];
+}
+
+HanabiMove SimplePolicy::Act(const HanabiObservation& obs,
+                             HanabiRng* /*rng*/) {
+  const auto& hands = obs.Hands();
+  const auto& own_knowledge = hands[0].Knowledge();
+  for (int i = 0; i < own_knowledge.size(); ++i) {
+    if (own_knowledge[i].ColorHinted() || own_knowledge[i].RankHinted()) {
+      return HanabiMove(HanabiMove::kPlay, i, -1, -1, -1);
+    }
+  }
+
+  if (obs.InformationTokens() > 0) {
+    for (int offset = 1; offset < hands.size(); ++offset) {
+      const auto& cards = hands[offset].Cards();
+      const auto& knowledge = hands[offset].Knowledge();
+      for (int i = 0; i < cards.size(); ++i) {
+        if (obs.CardPlayableOnFireworks(cards[i]) &&
+            !knowledge[i].ColorHinted()) {
+          return HanabiMove(HanabiMove::kRevealColor, -1, offset,
+                            cards[i].Color(), -1);
+        }
+      }
+    }
+  }
+
+  if (obs.InformationTokens() < obs.ParentGame()->MaxInformationTokens()) {
+    return HanabiMove(HanabiMove::kDiscard, 0, -1, -1, -1);
+  }
+  return HanabiMove(HanabiMove::kPlay, 0, -1, -1, -1);
+}
+
+HanabiMove HintPlayablePolicy::Act(const HanabiObservation& obs,
+                                   HanabiRng* /*rng*/) {
+  HanabiMove move = PlayKnownPlayable(obs);
+  if (move.MoveType() == HanabiMove::kInvalid) {
+    move = HintPlayable(obs);
+  }
+  if (move.MoveType() == HanabiMove::kInvalid) {
+    move = Discard(obs);
+  }
+  if (move.MoveType() == HanabiMove::kInvalid) {
+    move = AnyHintOrPlay(obs);
+  }
+  return move;
+}
+
+HanabiMove SafeDiscardPolicy::Act(const HanabiObservation& obs,
+                                  HanabiRng* /*rng*/) {
+  HanabiMove move = PlayKnownPlayable(obs);
+  if (move.MoveType() == HanabiMove::kInvalid) {
+    move = HintPlayable(obs);
+  }
+  if (move.MoveType() != HanabiMove::kInvalid) {
+    return move;
+  }
+  if (obs.InformationTokens() > 0 && obs.Hands().size() > 1) {
+    const HanabiHand& next = obs.Hands()[1];
+    const int chop = Chop(next.Knowledge());
+    if (chop >= 0 && Critical(obs, next.Cards()[chop])) {
+      return HanabiMove(HanabiMove::kRevealRank, -1, 1, -1,
+                        next.Cards()[chop].Rank());
+    }
+  }
+  move = Discard(obs);
+  if (move.MoveType() == HanabiMove::kInvalid) {
+    move = AnyHintOrPlay(obs);
+  }
+  return move;
+}
+
+std::unique_ptr<HanabiPolicy> MakePolicy(const std::string& name) {
+  if (name == "random") {
+    return std::unique_ptr<HanabiPolicy>(new RandomPolicy());
+  } else if (name == "simple") {
+    return std::unique_ptr<HanabiPolicy>(new SimplePolicy());
+  } else if (name == "hint_playable") {
+    return std::unique_ptr<HanabiPolicy>(new HintPlayablePolicy());
+  } else if (name == "safe_discard") {
+    return std::unique_ptr<HanabiPolicy>(new SafeDiscardPolicy());
+  }
+  return nullptr;
+}
+
+std::vector<std::string> PolicyNames() {
+  return {"random", "simple", "hint_playable", "safe_discard"};
+}
+
+HanabiState PlayGame(const HanabiGame* game,
+                     const std::vector<HanabiPolicy*>& policies,
+                     const HanabiRng& rng) {
+  REQUIRE(policies.size() == game->NumPlayers());
+  HanabiState state(game, rng);
+  HanabiRng policy_rng = rng.Fork(1);
+  while (!state.IsTerminal()) {
+    if (state.CurPlayer() == kChancePlayerId) {
+      state.ApplyRandomChance();
+      continue;
+    }
+    HanabiObservation obs(state, state.CurPlayer());
+    state.ApplyMove(policies[state.CurPlayer()]->Act(obs, &policy_rng));
+  }
+  return state;
+}
+
+}  // namespace hanabi_learning_env
@@ -0,0 +1,87 @@
+// Copyright 2018 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+// Built-in policies for generating games without an external agent.
+
+#ifndef __HANABI_POLICY_H__
+#define __HANABI_POLICY_H__
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "hanabi_game.h"
+#include "hanabi_move.h"
+#include "hanabi_observation.h"
+#include "hanabi_rng.h"
+#include "hanabi_state.h"
+
+namespace hanabi_learning_env {
+
+class HanabiPolicy {
+ public:
+  virtual ~HanabiPolicy() = default;
+  // Returns one of obs.LegalMoves(). Called only when the observing player
+  // is to act. Any randomness must come from rng.
+  virtual HanabiMove Act(const HanabiObservation& obs, HanabiRng* rng) = 0;
+};
+
+// Picks a legal move uniformly at random.
+class RandomPolicy : public HanabiPolicy {
+ public:
+  HanabiMove Act(const HanabiObservation& obs, HanabiRng* rng) override;
+};
+
+// Port of agents/simple_agent.py. Plays a card once anything about it was
+// hinted, otherwise hints the color of another player's playable card,
+// otherwise discards the first card (or plays it, with all information
+// tokens available).
+class SimplePolicy : public HanabiPolicy {
+ public:
+  HanabiMove Act(const HanabiObservation& obs, HanabiRng* rng) override;
+};
+
+// Plays a card its holder knows to be playable, otherwise hints another
+// player's playable card that its holder does not know to be playable,
+// nearest player first, otherwise discards a card known to be already
+// played or the oldest card without hints. "Known" means true for every
+// color and rank the card knowledge leaves plausible.
+class HintPlayablePolicy : public HanabiPolicy {
+ public:
+  HanabiMove Act(const HanabiObservation& obs, HanabiRng* rng) override;
+};
+
+// HintPlayablePolicy that, with no playable card to hint, first protects the
+// next player's oldest unhinted card (their chop) with a rank hint when it
+// is the last copy of a card still needed.
+class SafeDiscardPolicy : public HanabiPolicy {
+ public:
+  HanabiMove Act(const HanabiObservation& obs, HanabiRng* rng) override;
+};
+
+// Returns the policy registered under name, or nullptr if there is none.
+std::unique_ptr<HanabiPolicy> MakePolicy(const std::string& name);
+std::vector<std::string> PolicyNames();
+
+// Plays a game to the end with policies[p] acting for player p. Chance is
+// drawn from rng, and policies draw from an independent fork of it, so the
+// game is determined by rng alone.
+HanabiState PlayGame(const HanabiGame* game,
+                     const std::vector<HanabiPolicy*>& policies,
+                     const HanabiRng& rng);
+
+}  // namespace hanabi_learning_env
+
+#endif
@@ -0,0 +1,131 @@
+// Copyright 2018 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef __HANABI_RNG_H__
+#define __HANABI_RNG_H__
+
+#include <cstdint>
+
+namespace hanabi_learning_env {
+
+// Counter-based random number generator (Philox4x32-10, Salmon et al. 2011).
+//
+// A stream is identified by (seed, env_id, episode_id): the seed is the
+// Philox key, and the ids are baked into the counter next to the block index.
+// Distinct triples give independent streams, so any game can be reproduced
+// from its ids alone, and states never need to share a generator.
+// HanabiRng is small, trivially copyable, and models UniformRandomBitGenerator
+// so it can be passed to the <random> distributions.
+class HanabiRng {
+ public:
+  using result_type = uint32_t;
+
+  HanabiRng() : HanabiRng(0, 0, 0) {}
+  HanabiRng(uint64_t seed, uint32_t env_id, uint64_t episode_id)
+      : key_{static_cast<uint32_t>(seed), static_cast<uint32_t>(seed >> 32)},
+        env_id_(env_id),
+        episode_id_(episode_id) {}
+
+  static constexpr result_type min() { return 0; }
+  static constexpr result_type max() { return 0xffffffffu; }
+
+  result_type operator()() {
+    if (index_ == 4) {
+      Generate(block_, buffer_);
+      ++block_;
+      index_ = 0;
+    }
+    return buffer_[index_++];
+  }
+
+  // Skips count draws. Only the block index is touched, so this is O(1).
+  void Discard(uint64_t count) {
+    uint64_t position = Position() + count;
+    block_ = static_cast<uint32_t>(position / 4);
+    index_ = 4;
+    if (position % 4 != 0) {
+      Generate(block_, buffer_);
+      ++block_;
+      index_ = position % 4;
+    }
+  }
+
+  // Returns an independent stream keyed by this stream's identity and
+  // branch_id. The result does not depend on how many draws were made.
+  HanabiRng Fork(uint32_t branch_id) const {
+    uint32_t block[4];
+    uint32_t counter[4] = {branch_id, env_id_,
+                           static_cast<uint32_t>(episode_id_),
+                           static_cast<uint32_t>(episode_id_ >> 32) ^
+                               0x80000000u};
+    Philox(counter, key_, block);
+    return HanabiRng(block[0] | static_cast<uint64_t>(block[1]) << 32,
+                     env_id_, episode_id_);
+  }
+
+  uint64_t Seed() const { return key_[0] | static_cast<uint64_t>(key_[1]) << 32; }
+  uint32_t EnvId() const { return env_id_; }
+  uint64_t EpisodeId() const { return episode_id_; }
+  // Number of values drawn so far.
+  uint64_t Position() const {
+    return static_cast<uint64_t>(block_) * 4 - (index_ == 4 ? 0 : 4 - index_);
+  }
+
+ private:
+  void Generate(uint32_t block, uint32_t* out) const {
+    uint32_t counter[4] = {block, env_id_, static_cast<uint32_t>(episode_id_),
+                           static_cast<uint32_t>(episode_id_ >> 32)};
+    Philox(counter, key_, out);
+  }
+
+  static void Philox(const uint32_t* counter, const uint32_t* key,
+                     uint32_t* out) {
+    const uint32_t kMul0 = 0xD2511F53u;
+    const uint32_t kMul1 = 0xCD9E8D57u;
+    const uint32_t kWeyl0 = 0x9E3779B9u;
+    const uint32_t kWeyl1 = 0xBB67AE85u;
+    uint32_t c0 = counter[0], c1 = counter[1], c2 = counter[2],
+             c3 = counter[3];
+    uint32_t k0 = key[0], k1 = key[1];
+    for (int round = 0; round < 10; ++round) {
+      uint64_t p0 = static_cast<uint64_t>(kMul0) * c0;
+      uint64_t p1 = static_cast<uint64_t>(kMul1) * c2;
+      uint32_t hi0 = static_cast<uint32_t>(p0 >> 32);
+      uint32_t lo0 = static_cast<uint32_t>(p0);
+      uint32_t hi1 = static_cast<uint32_t>(p1 >> 32);
+      uint32_t lo1 = static_cast<uint32_t>(p1);
+      c0 = hi1 ^ c1 ^ k0;
+      c1 = lo1;
+      c2 = hi0 ^ c3 ^ k1;
+      c3 = lo0;
+      k0 += kWeyl0;
+      k1 += kWeyl1;
+    }
+    out[0] = c0;
+    out[1] = c1;
+    out[2] = c2;
+    out[3] = c3;
+  }
+
+  uint32_t key_[2];
+  uint32_t env_id_;
+  uint64_t episode_id_;
+  uint32_t block_ = 0;   // Index of the next block to generate.
+  uint32_t index_ = 4;   // Next unread entry of buffer_, 4 when empty.
+  uint32_t buffer_[4] = {0, 0, 0, 0};
+};
+
+}  // namespace hanabi_learning_env
+
+#endif
@@ -18,6 +18,7 @@
 #include <cassert>
 #include <numeric>
 
+#include "instrumentation.h"
 #include "util.h"
 
 namespace hanabi_learning_env {
@@ -64,11 +65,12 @@ HanabiState::HanabiDeck::HanabiDeck(const HanabiGame& game)
   full_deck_card_count_ = card_count_;
 }
 
-HanabiCard HanabiState::HanabiDeck::DealCard(std::mt19937* rng) {
+HanabiCard HanabiState::HanabiDeck::DealCard(HanabiRng* rng) {
+  HANABI_PROBE(kProbeDealCard);
   if (Empty()) {
     return HanabiCard();
   }
-  std::discrete_distribution<std::mt19937::result_type> dist(
+  std::discrete_distribution<int> dist(
       card_count_.begin(), card_count_.end());
   int index = dist(*rng);
   assert(card_count_[index] > 0);
@@ -79,6 +81,7 @@ HanabiCard HanabiState::HanabiDeck::DealCard(std::mt19937* rng) {
 }
 
 HanabiCard HanabiState::HanabiDeck::DealCard(int color, int rank) {
+  HANABI_PROBE(kProbeDealCard);
   int index = CardToIndex(color, rank);
   if (card_count_[index] <= 0) {
     return HanabiCard();
@@ -91,14 +94,19 @@ HanabiCard HanabiState::HanabiDeck::DealCard(int color, int rank) {
 }
 
 HanabiState::HanabiState(const HanabiGame* parent_game, int start_player)
+    : HanabiState(parent_game, parent_game->NextEpisodeRng(), start_player) {}
+
+HanabiState::HanabiState(const HanabiGame* parent_game, const HanabiRng& rng,
+                         int start_player)
     : parent_game_(parent_game),
+      rng_(rng),
       deck_(*parent_game),
       hands_(parent_game->NumPlayers()),
       cur_player_(kChancePlayerId),
       next_non_chance_player_(start_player >= 0 &&
                                       start_player < parent_game->NumPlayers()
                                   ? start_player
-                                  : parent_game->GetSampledStartPlayer()),
+                                  : parent_game->GetSampledStartPlayer(&rng_)),
       information_tokens_(parent_game->MaxInformationTokens()),
       life_tokens_(parent_game->MaxLifeTokens()),
       fireworks_(parent_game->NumColors(), 0),
@@ -222,6 +230,7 @@ bool HanabiState::MoveIsLegal(HanabiMove move) const {
 }
 
 void HanabiState::ApplyMove(HanabiMove move) {
+  HANABI_PROBE(kProbeApplyMove);
   REQUIRE(MoveIsLegal(move));
   if (deck_.Empty()) {
     --turns_to_play_;
@@ -285,10 +294,11 @@ double HanabiState::ChanceOutcomeProb(HanabiMove move) const {
 void HanabiState::ApplyRandomChance() {
   auto chance_outcomes = ChanceOutcomes();
   REQUIRE(!chance_outcomes.second.empty());
-  ApplyMove(ParentGame()->PickRandomChance(chance_outcomes));
+  ApplyMove(ParentGame()->PickRandomChance(chance_outcomes, &rng_));
 }
 
 std::vector<HanabiMove> HanabiState::LegalMoves(int player) const {
+  HANABI_PROBE(kProbeLegalMoves);
   std::vector<HanabiMove> movelist;
   // kChancePlayer=-1 must be handled by ChanceOutcome.
   REQUIRE(player >= 0 && player < ParentGame()->NumPlayers());
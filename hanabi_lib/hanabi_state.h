@@ -24,6 +24,7 @@
 #include "hanabi_hand.h"
 #include "hanabi_history_item.h"
 #include "hanabi_move.h"
+#include "hanabi_rng.h"
 
 #include <iostream>
 #include <sstream>
@@ -40,7 +41,7 @@ class HanabiState {
     explicit HanabiDeck(const HanabiGame& game);
     // DealCard returns invalid card on failure.
     HanabiCard DealCard(int color, int rank);
-    HanabiCard DealCard(std::mt19937* rng);
+    HanabiCard DealCard(HanabiRng* rng);
     int Size() const { return total_count_; }
     bool Empty() const { return total_count_ == 0; }
     int CardCount(int color, int rank) const {
@@ -70,7 +71,7 @@ class HanabiState {
 
     // NOTE: deck history may no longer be legal given we can clone
     // and reset deck, thus this function is disabled for now
-    std::vector<std::string> DeckHistory(std::mt19937* rng) {
+    std::vector<std::string> DeckHistory(HanabiRng* rng) {
       assert(!intervened_);
       // std::cout << "before dealing all: " << deck_history_.size() << std::endl;
       // deal all cards to finish a deck
@@ -119,7 +120,14 @@ class HanabiState {
   // Construct a HanabiState, initialised to the start of the game.
   // If start_player >= 0, the game-provided start player is overridden
   // and the first player after chance is start_player.
+  // The state's random stream is parent_game->NextEpisodeRng().
   explicit HanabiState(const HanabiGame* parent_game, int start_player = -1);
+  // As above, but all randomness of this state (start player and random
+  // chance outcomes) is drawn from rng, e.g.
+  // HanabiRng(global_seed, env_id, episode_id). Does not touch the parent
+  // game's episode counter.
+  HanabiState(const HanabiGame* parent_game, const HanabiRng& rng,
+              int start_player = -1);
   // Copy constructor for recursive game traversals using copy + apply-move.
   HanabiState(const HanabiState& state) = default;
 
@@ -162,9 +170,14 @@ class HanabiState {
   }
 
   std::vector<std::string> DeckHistory() {
-    return deck_.DeckHistory(parent_game_->rng());
+    return deck_.DeckHistory(&rng_);
   }
 
+  // Random stream used by ApplyRandomChance. Copies of a state share their
+  // future random outcomes; use SetRng (e.g. with Rng().Fork(id)) to branch.
+  const HanabiRng& Rng() const { return rng_; }
+  void SetRng(const HanabiRng& rng) { rng_ = rng; }
+
   void SetGame(const HanabiGame* game) {
     parent_game_ = game;
   }
@@ -194,6 +207,7 @@ class HanabiState {
   void DecrementLifeTokens();
 
   const HanabiGame* parent_game_ = nullptr;
+  HanabiRng rng_;
   HanabiDeck deck_;
   // Back element of discard_pile_ is most recently discarded card.
   std::vector<HanabiCard> discard_pile_;
@@ -0,0 +1,191 @@
+// Copyright 2018 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include "instrumentation.h"
+
+#include <atomic>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace hanabi_learning_env {
+
+namespace {
+
+const char* const kProbeNames[kNumProbes] = {
+    "ApplyMove",      "LegalMoves",       "HanabiObservation",
+    "DealCard",       "EncodeHands",      "EncodeBoard",
+    "EncodeDiscards", "EncodeLastAction", "EncodeV0Belief"};
+
+#if defined(HANABI_INSTRUMENTATION)
+
+// Statistics of one thread. Only the owning thread writes, so updates are
+// plain relaxed load/store pairs; atomics make concurrent reads well-defined.
+struct ThreadProbes {
+  std::atomic<uint64_t> count[kNumProbes];
+  std::atomic<uint64_t> cycles[kNumProbes];
+  std::atomic<uint64_t> histogram[kNumProbes][kNumProbeBuckets];
+
+  ThreadProbes() { Reset(); }
+
+  void Reset() {
+    for (int p = 0; p < kNumProbes; ++p) {
+      count[p].store(0, std::memory_order_relaxed);
+      cycles[p].store(0, std::memory_order_relaxed);
+      for (int b = 0; b < kNumProbeBuckets; ++b) {
+        histogram[p][b].store(0, std::memory_order_relaxed);
+      }
+    }
+  }
+};
+
+void Increment(std::atomic<uint64_t>* value, uint64_t delta) {
+  value->store(value->load(std::memory_order_relaxed) + delta,
+               std::memory_order_relaxed);
+}
+
+// Blocks outlive their threads, so statistics of finished threads are kept.
+// The registry is only locked when a thread records its first probe and
+// when reading.
+std::mutex registry_mutex;
+std::vector<std::unique_ptr<ThreadProbes>>& Registry() {
+  static auto* registry = new std::vector<std::unique_ptr<ThreadProbes>>();
+  return *registry;
+}
+
+ThreadProbes* RegisterThread() {
+  std::lock_guard<std::mutex> lock(registry_mutex);
+  Registry().emplace_back(new ThreadProbes());
+  return Registry().back().get();
+}
+
+int Bucket(uint64_t cycles) {
+  int bucket = 0;
+  while (bucket < kNumProbeBuckets - 1 && (cycles >> bucket) != 0) {
+    ++bucket;
+  }
+  return bucket;
+}
+
+#endif
+
+}  // namespace
+
+const char* ProbeName(int probe) {
+  return probe >= 0 && probe < kNumProbes ? kProbeNames[probe] : "Unknown";
+}
+
+uint64_t ProbeStats::Percentile(double fraction) const {
+  uint64_t target = fraction * count;
+  uint64_t seen = 0;
+  for (int b = 0; b < kNumProbeBuckets; ++b) {
+    seen += histogram[b];
+    if (seen > target) {
+      return uint64_t{1} << b;
+    }
+  }
+  return count > 0 ? uint64_t{1} << (kNumProbeBuckets - 1) : 0;
+}
+
+#if defined(HANABI_INSTRUMENTATION)
+
+void RecordProbe(int probe, uint64_t cycles) {
+  thread_local ThreadProbes* probes = RegisterThread();
+  Increment(&probes->count[probe], 1);
+  Increment(&probes->cycles[probe], cycles);
+  Increment(&probes->histogram[probe][Bucket(cycles)], 1);
+}
+
+bool InstrumentationEnabled() { return true; }
+
+ProbeStats GetProbeStats(int probe) {
+  ProbeStats stats;
+  std::lock_guard<std::mutex> lock(registry_mutex);
+  for (const auto& probes : Registry()) {
+    stats.count += probes->count[probe].load(std::memory_order_relaxed);
+    stats.cycles += probes->cycles[probe].load(std::memory_order_relaxed);
+    for (int b = 0; b < kNumProbeBuckets; ++b) {
+      stats.histogram[b] +=
+          probes->histogram[probe][b].load(std::memory_order_relaxed);
+    }
+  }
+  return stats;
+}
+
+void ResetInstrumentation() {
+  std::lock_guard<std::mutex> lock(registry_mutex);
+  for (const auto& probes : Registry()) {
+    probes->Reset();
+  }
+}
+
+#else
+
+bool InstrumentationEnabled() { return false; }
+
+ProbeStats GetProbeStats(int /*probe*/) { return ProbeStats(); }
+
+void ResetInstrumentation() {}
+
+#endif
+
+std::string InstrumentationReport(bool json) {
+  std::string report = json ? "{\"enabled\": " : "";
+  char line[256];
+  if (json) {
+    report += InstrumentationEnabled() ? "true, \"probes\": {" : "false";
+  } else if (!InstrumentationEnabled()) {
+    return "Instrumentation disabled; rebuild with HANABI_INSTRUMENTATION.\n";
+  } else {
+    std::snprintf(line, sizeof(line), "%-20s %12s %14s %12s %12s\n", "probe",
+                  "calls", "mean cycles", "p50 <", "p99 <");
+    report += line;
+  }
+  for (int p = 0; InstrumentationEnabled() && p < kNumProbes; ++p) {
+    ProbeStats stats = GetProbeStats(p);
+    double mean = stats.count > 0
+                      ? static_cast<double>(stats.cycles) / stats.count
+                      : 0;
+    if (json) {
+      std::snprintf(line, sizeof(line),
+                    "%s\"%s\": {\"calls\": %llu, \"cycles\": %llu, "
+                    "\"p50\": %llu, \"p99\": %llu, \"histogram\": [",
+                    p == 0 ? "" : ", ", ProbeName(p),
+                    static_cast<unsigned long long>(stats.count),
+                    static_cast<unsigned long long>(stats.cycles),
+                    static_cast<unsigned long long>(stats.Percentile(0.5)),
+                    static_cast<unsigned long long>(stats.Percentile(0.99)));
+      report += line;
+      for (int b = 0; b < kNumProbeBuckets; ++b) {
+        report += (b == 0 ? "" : ", ") + std::to_string(stats.histogram[b]);
+      }
+      report += "]}";
+    } else {
+      std::snprintf(line, sizeof(line), "%-20s %12llu %14.1f %12llu %12llu\n",
+                    ProbeName(p), static_cast<unsigned long long>(stats.count),
+                    mean,
+                    static_cast<unsigned long long>(stats.Percentile(0.5)),
+                    static_cast<unsigned long long>(stats.Percentile(0.99)));
+      report += line;
+    }
+  }
+  if (json) {
+    report += InstrumentationEnabled() ? "}}\n" : "}\n";
+  }
+  return report;
+}
+
+}  // namespace hanabi_learning_env
@@ -0,0 +1,112 @@
+// Copyright 2018 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+// Optional hot-path instrumentation.
+//
+// Built only with -DHANABI_INSTRUMENTATION=ON. Otherwise HANABI_PROBE
+// expands to nothing and the report functions return empty results, so the
+// engine pays nothing for it.
+//
+// Every probe counts calls and records the duration in timestamp-counter
+// cycles into a log2 histogram. Each thread writes only its own statistics
+// (no atomic read-modify-write, no locks); readers sum over all threads.
+
+#ifndef __INSTRUMENTATION_H__
+#define __INSTRUMENTATION_H__
+
+#include <cstdint>
+#include <string>
+
+#if defined(HANABI_INSTRUMENTATION) && (defined(__x86_64__) || defined(__i386__))
+#include <x86intrin.h>
+#elif defined(HANABI_INSTRUMENTATION)
+#include <chrono>
+#endif
+
+namespace hanabi_learning_env {
+
+enum Probe {
+  kProbeApplyMove = 0,
+  kProbeLegalMoves,
+  // Body of HanabiObservation(state, player); the legal moves it collects
+  // are counted under kProbeLegalMoves.
+  kProbeObservation,
+  kProbeDealCard,
+  kProbeEncodeHands,
+  kProbeEncodeBoard,
+  kProbeEncodeDiscards,
+  kProbeEncodeLastAction,
+  kProbeEncodeV0Belief,
+  kNumProbes
+};
+
+constexpr int kNumProbeBuckets = 40;  // Bucket b counts durations < 2^b.
+
+const char* ProbeName(int probe);
+
+struct ProbeStats {
+  uint64_t count = 0;
+  uint64_t cycles = 0;
+  uint64_t histogram[kNumProbeBuckets] = {};
+
+  // Upper bound of the bucket holding the given fraction of calls.
+  uint64_t Percentile(double fraction) const;
+};
+
+// True if the library was built with HANABI_INSTRUMENTATION.
+bool InstrumentationEnabled();
+// Sums the statistics of all threads. Safe to call while probes run.
+ProbeStats GetProbeStats(int probe);
+// Zeroes all statistics. Probes running concurrently may be lost.
+void ResetInstrumentation();
+// Human-readable table, or JSON if json is set.
+std::string InstrumentationReport(bool json);
+
+#if defined(HANABI_INSTRUMENTATION)
+
+inline uint64_t ProbeClock() {
+#if defined(__x86_64__) || defined(__i386__)
+  return __rdtsc();
+#else
+  return std::chrono::steady_clock::now().time_since_epoch().count();
+#endif
+}
+
+void RecordProbe(int probe, uint64_t cycles);
+
+class ScopedProbe {
+ public:
+  explicit ScopedProbe(int probe) : probe_(probe), start_(ProbeClock()) {}
+  ~ScopedProbe() { RecordProbe(probe_, ProbeClock() - start_); }
+
+ private:
+  int probe_;
+  uint64_t start_;
+};
+
+#define HANABI_PROBE(probe) \
+  ::hanabi_learning_env::ScopedProbe hanabi_scoped_probe(probe)
+
+#else
+
+#define HANABI_PROBE(probe) \
+  do {                      \
+  } while (0)
+
+#endif
+
+}  // namespace hanabi_learning_env
+
+#endif
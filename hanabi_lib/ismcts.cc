@@ -0,0 +1,407 @@
+// Copyright 2018 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "ismcts.h"
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <thread>
+
+#include "hanabi_observation.h"
+#include "hanabi_policy.h"
+#include "util.h"
+
+namespace hanabi_learning_env {
+
+namespace {
+// Node values are accumulated as fixed point integers.
+constexpr double kValueScale = 1 << 20;
+// Number of times a determinization is resampled before giving up.
+constexpr int kMaxDeterminizeAttempts = 64;
+
+// Applies chance moves until a player is to act.
+void ApplyChance(HanabiState* state) {
+  while (!state->IsTerminal() && state->CurPlayer() == kChancePlayerId) {
+    state->ApplyRandomChance();
+  }
+}
+
+float TerminalValue(const HanabiState& state) {
+  return static_cast<float>(state.Score()) / state.ParentGame()->MaxScore();
+}
+
+// Plays every state to the end, choosing player moves with
+// choose(state, &rng), and writes the normalized final scores to values.
+template <typename ChooseMove>
+void RolloutValues(const std::vector<const HanabiState*>& states,
+                   std::vector<float>* values, ChooseMove choose) {
+  for (int i = 0; i < states.size(); ++i) {
+    HanabiState state(*states[i]);
+    HanabiRng rng = state.Rng().Fork(0);
+    while (!state.IsTerminal()) {
+      if (state.CurPlayer() == kChancePlayerId) {
+        state.ApplyRandomChance();
+        continue;
+      }
+      state.ApplyMove(choose(state, &rng));
+    }
+    (*values)[i] = TerminalValue(state);
+  }
+}
+}  // namespace
+
+IsmctsEvaluator RandomRolloutEvaluator() {
+  return [](const std::vector<const HanabiState*>& states,
+            std::vector<float>* priors, std::vector<float>* values) {
+    std::fill(priors->begin(), priors->end(), 1.0f);
+    RolloutValues(states, values,
+                  [](const HanabiState& state, HanabiRng* rng) {
+                    auto legal_moves = state.LegalMoves(state.CurPlayer());
+                    std::uniform_int_distribution<int> dist(
+                        0, legal_moves.size() - 1);
+                    return legal_moves[dist(*rng)];
+                  });
+  };
+}
+
+IsmctsEvaluator PolicyRolloutEvaluator(const std::string& policy_name) {
+  REQUIRE(MakePolicy(policy_name) != nullptr);
+  return [policy_name](const std::vector<const HanabiState*>& states,
+                       std::vector<float>* priors,
+                       std::vector<float>* values) {
+    // One instance per call, as the evaluator runs on every search thread.
+    std::unique_ptr<HanabiPolicy> policy = MakePolicy(policy_name);
+    std::fill(priors->begin(), priors->end(), 1.0f);
+    RolloutValues(states, values,
+                  [&policy](const HanabiState& state, HanabiRng* rng) {
+                    return policy->Act(
+                        HanabiObservation(state, state.CurPlayer()), rng);
+                  });
+  };
+}
+
+IsmctsNodeArena::IsmctsNodeArena(int capacity)
+    : nodes_(new IsmctsNode[capacity]), capacity_(capacity) {
+  REQUIRE(capacity > 0);
+}
+
+int32_t IsmctsNodeArena::Allocate(int count) {
+  // Never advances past capacity, so failed allocations on a full arena
+  // cannot overflow size_.
+  int32_t start = size_.load(std::memory_order_relaxed);
+  do {
+    if (count > capacity_ - start) {
+      return -1;
+    }
+  } while (!size_.compare_exchange_weak(start, start + count,
+                                        std::memory_order_relaxed));
+  return start;
+}
+
+int IsmctsNodeArena::Size() const {
+  return size_.load(std::memory_order_relaxed);
+}
+
+void IsmctsNodeArena::Reset() {
+  int used = Size();
+  for (int i = 0; i < used; ++i) {
+    IsmctsNode& node = nodes_[i];
+    node.visits.store(0, std::memory_order_relaxed);
+    node.virtual_loss.store(0, std::memory_order_relaxed);
+    node.value_sum.store(0, std::memory_order_relaxed);
+    node.expand_state.store(IsmctsNode::kUnexpanded,
+                            std::memory_order_relaxed);
+    node.prior = 0;
+    node.first_child = -1;
+    node.num_children = 0;
+  }
+  size_.store(0, std::memory_order_relaxed);
+}
+
+Ismcts::Ismcts(const HanabiGame* game, const IsmctsOptions& options,
+               IsmctsEvaluator evaluator)
+    : game_(game),
+      options_(options),
+      evaluator_(evaluator ? evaluator : RandomRolloutEvaluator()),
+      arena_(options.max_nodes) {
+  REQUIRE(game_ != nullptr);
+  REQUIRE(options_.num_threads > 0);
+  REQUIRE(options_.batch_size > 0);
+}
+
+IsmctsResult Ismcts::Search(const HanabiState& root) {
+  REQUIRE(root.ParentGame() == game_);
+  REQUIRE(!root.IsTerminal() && root.CurPlayer() != kChancePlayerId);
+  arena_.Reset();
+  root_ = arena_.Allocate(1);
+
+  std::atomic<int> iterations_left(options_.num_iterations);
+  if (options_.num_threads == 1) {
+    SearchThread(root, 0, &iterations_left);
+  } else {
+    std::vector<std::thread> threads;
+    for (int i = 0; i < options_.num_threads; ++i) {
+      threads.emplace_back(&Ismcts::SearchThread, this, std::cref(root), i,
+                           &iterations_left);
+    }
+    for (auto& thread : threads) {
+      thread.join();
+    }
+  }
+
+  IsmctsResult result;
+  const int max_moves = game_->MaxMoves();
+  result.visit_counts.assign(max_moves, 0);
+  result.q_values.assign(max_moves, 0);
+  result.num_nodes = arena_.Size();
+  const IsmctsNode& root_node = arena_[root_];
+  int best_visits = -1;
+  for (int uid = 0; uid < max_moves; ++uid) {
+    HanabiMove move = game_->GetMove(uid);
+    if (!root.MoveIsLegal(move)) {
+      continue;
+    }
+    int visits = 0;
+    if (root_node.expand_state.load() == IsmctsNode::kExpanded) {
+      const IsmctsNode& child = arena_[root_node.first_child + uid];
+      visits = child.visits.load();
+      if (visits > 0) {
+        result.q_values[uid] = child.value_sum.load() / kValueScale / visits;
+      }
+    }
+    result.visit_counts[uid] = visits;
+    if (visits > best_visits) {
+      best_visits = visits;
+      result.best_move = move;
+    }
+  }
+  return result;
+}
+
+void Ismcts::SearchThread(const HanabiState& root, int thread_id,
+                          std::atomic<int>* iterations_left) {
+  uint64_t iteration = 0;
+  const int observer = root.CurPlayer();
+  const int max_moves = game_->MaxMoves();
+
+  std::vector<HanabiState> states;
+  std::vector<Leaf> leaves(options_.batch_size);
+  std::vector<const HanabiState*> batch;
+  std::vector<int> batch_leaves;
+  std::vector<float> priors;
+  std::vector<float> values;
+  while (true) {
+    int claimed = iterations_left->fetch_sub(options_.batch_size);
+    if (claimed <= 0) {
+      break;
+    }
+    int batch_size = std::min(options_.batch_size, claimed);
+
+    states.clear();
+    states.reserve(batch_size);
+    for (int i = 0; i < batch_size; ++i) {
+      HanabiRng rng(options_.seed, thread_id, iteration++);
+      states.push_back(root);
+      Determinize(observer, &states.back(), &rng);
+      states.back().SetRng(rng);
+      SelectLeaf(&states.back(), &leaves[i]);
+    }
+
+    batch.clear();
+    batch_leaves.clear();
+    for (int i = 0; i < batch_size; ++i) {
+      if (!leaves[i].terminal) {
+        batch.push_back(&states[i]);
+        batch_leaves.push_back(i);
+      }
+    }
+    if (!batch.empty()) {
+      priors.assign(batch.size() * max_moves, 0);
+      values.assign(batch.size(), 0);
+      evaluator_(batch, &priors, &values);
+      for (int j = 0; j < batch_leaves.size(); ++j) {
+        Leaf* leaf = &leaves[batch_leaves[j]];
+        leaf->value = values[j];
+        Expand(leaf->path.back(), &priors[j * max_moves]);
+      }
+    }
+    for (int i = 0; i < batch_size; ++i) {
+      Backup(leaves[i], leaves[i].value);
+    }
+  }
+}
+
+void Ismcts::Determinize(int player, HanabiState* state,
+                         HanabiRng* rng) const {
+  if (game_->ObservationType() == HanabiGame::kSeer) {
+    return;
+  }
+  HanabiHand& hand = state->Hands()[player];
+  const std::vector<HanabiCard> original = hand.Cards();
+  if (original.empty()) {
+    return;
+  }
+  const bool use_knowledge = game_->ObservationType() != HanabiGame::kMinimal;
+  const int num_colors = game_->NumColors();
+  const int num_ranks = game_->NumRanks();
+  const auto& knowledge = hand.Knowledge();
+  auto& deck = state->Deck();
+  deck.PutCardsBack(original);
+
+  std::vector<HanabiCard> sampled;
+  std::vector<int> counts;
+  std::vector<double> weights(num_colors * num_ranks);
+  for (int attempt = 0; attempt < kMaxDeterminizeAttempts; ++attempt) {
+    counts = deck.CardCount();
+    sampled.clear();
+    for (int i = 0; i < knowledge.size(); ++i) {
+      double total = 0;
+      for (int color = 0; color < num_colors; ++color) {
+        for (int rank = 0; rank < num_ranks; ++rank) {
+          int index = color * num_ranks + rank;
+          bool plausible =
+              !use_knowledge || knowledge[i].IsCardPlausible(color, rank);
+          weights[index] = plausible ? counts[index] : 0;
+          total += weights[index];
+        }
+      }
+      if (total <= 0) {
+        break;
+      }
+      std::discrete_distribution<int> dist(weights.begin(), weights.end());
+      int index = dist(*rng);
+      --counts[index];
+      sampled.push_back(HanabiCard(index / num_ranks, index % num_ranks));
+    }
+    if (sampled.size() == original.size()) {
+      deck.DealCards(sampled);
+      hand.SetCards(sampled);
+      return;
+    }
+  }
+  // Earlier draws can make later slots impossible to fill. The actual hand
+  // is always consistent, so fall back to it.
+  deck.DealCards(original);
+}
+
+void Ismcts::SelectLeaf(HanabiState* state, Leaf* leaf) {
+  leaf->path.clear();
+  leaf->terminal = false;
+  leaf->value = 0;
+  int32_t node_index = root_;
+  arena_[node_index].virtual_loss.fetch_add(options_.virtual_loss,
+                                            std::memory_order_relaxed);
+  leaf->path.push_back(node_index);
+  while (true) {
+    ApplyChance(state);
+    if (state->IsTerminal()) {
+      leaf->terminal = true;
+      leaf->value = TerminalValue(*state);
+      return;
+    }
+    const IsmctsNode& node = arena_[node_index];
+    if (node.expand_state.load(std::memory_order_acquire) !=
+        IsmctsNode::kExpanded) {
+      return;
+    }
+    int32_t child_index = SelectChild(node, *state);
+    REQUIRE(child_index >= 0);
+    arena_[child_index].virtual_loss.fetch_add(options_.virtual_loss,
+                                               std::memory_order_relaxed);
+    state->ApplyMove(game_->GetMove(child_index - node.first_child));
+    node_index = child_index;
+    leaf->path.push_back(node_index);
+  }
+}
+
+int32_t Ismcts::SelectChild(const IsmctsNode& node,
+                            const HanabiState& state) const {
+  // Which children are available depends on the determinization (e.g. hints
+  // towards the root player), so priors are renormalized over legal moves.
+  double prior_sum = 0;
+  int num_legal = 0;
+  for (int i = 0; i < node.num_children; ++i) {
+    if (state.MoveIsLegal(game_->GetMove(i))) {
+      prior_sum += arena_[node.first_child + i].prior;
+      ++num_legal;
+    }
+  }
+
+  int parent_visits = node.visits.load(std::memory_order_relaxed);
+  double parent_q =
+      parent_visits > 0 ? node.value_sum.load(std::memory_order_relaxed) /
+                              kValueScale / parent_visits
+                        : 0;
+  double sqrt_n = std::sqrt(static_cast<double>(
+      parent_visits + node.virtual_loss.load(std::memory_order_relaxed)));
+
+  int32_t best = -1;
+  double best_score = -1;
+  for (int i = 0; i < node.num_children; ++i) {
+    if (!state.MoveIsLegal(game_->GetMove(i))) {
+      continue;
+    }
+    const IsmctsNode& child = arena_[node.first_child + i];
+    int visits = child.visits.load(std::memory_order_relaxed);
+    int pending = visits + child.virtual_loss.load(std::memory_order_relaxed);
+    // Pending visits count with value 0.
+    double q = pending > 0 ? child.value_sum.load(std::memory_order_relaxed) /
+                                 kValueScale / pending
+                           : parent_q;
+    double p = prior_sum > 0 ? child.prior / prior_sum : 1.0 / num_legal;
+    double score = q + options_.puct_c * p * sqrt_n / (1 + pending);
+    if (score > best_score) {
+      best_score = score;
+      best = node.first_child + i;
+    }
+  }
+  return best;
+}
+
+void Ismcts::Expand(int32_t node_index, const float* priors) {
+  IsmctsNode& node = arena_[node_index];
+  int32_t expected = IsmctsNode::kUnexpanded;
+  if (!node.expand_state.compare_exchange_strong(expected,
+                                                 IsmctsNode::kExpanding)) {
+    // Another thread reached the same leaf and owns the expansion.
+    return;
+  }
+  const int max_moves = game_->MaxMoves();
+  int32_t first_child = arena_.Allocate(max_moves);
+  if (first_child < 0) {
+    node.expand_state.store(IsmctsNode::kUnexpanded,
+                            std::memory_order_release);
+    return;
+  }
+  for (int i = 0; i < max_moves; ++i) {
+    arena_[first_child + i].prior = std::max(0.0f, priors[i]);
+  }
+  node.first_child = first_child;
+  node.num_children = max_moves;
+  node.expand_state.store(IsmctsNode::kExpanded, std::memory_order_release);
+}
+
+void Ismcts::Backup(const Leaf& leaf, float value) {
+  int64_t fixed_value = std::llround(value * kValueScale);
+  for (int32_t node_index : leaf.path) {
+    IsmctsNode& node = arena_[node_index];
+    node.value_sum.fetch_add(fixed_value, std::memory_order_relaxed);
+    node.visits.fetch_add(1, std::memory_order_relaxed);
+    node.virtual_loss.fetch_sub(options_.virtual_loss,
+                                std::memory_order_relaxed);
+  }
+}
+
+}  // namespace hanabi_learning_env
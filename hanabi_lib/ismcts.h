@@ -0,0 +1,166 @@
+// Copyright 2018 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Information-set Monte Carlo tree search over HanabiState.
+//
+// The tree is built over the root player's information set: every iteration
+// resamples the root player's own (hidden) hand consistently with their card
+// knowledge, and then descends the shared tree applying moves with
+// HanabiState::ApplyMove. Chance moves are sampled on the way down and are
+// not part of the tree (open-loop search).
+//
+// Search is tree-parallel. All threads share one tree whose nodes live in a
+// fixed-capacity arena, node statistics are updated with atomics only, and
+// virtual loss keeps concurrent descents from piling onto the same path.
+// Leaves are collected into batches and evaluated with a single call to a
+// user-supplied prior/value callback.
+
+#ifndef __ISMCTS_H__
+#define __ISMCTS_H__
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "hanabi_game.h"
+#include "hanabi_move.h"
+#include "hanabi_rng.h"
+#include "hanabi_state.h"
+
+namespace hanabi_learning_env {
+
+// Batched prior/value callback. For the i-th state of the batch, the callback
+// writes MaxMoves() prior weights, indexed by move uid, to
+// (*priors)[i * MaxMoves() ...] and a value in [0, 1] (expected final score
+// divided by MaxScore()) to (*values)[i]. Both outputs are pre-sized.
+// States are determinizations, so an evaluator must only use what the current
+// player can see, e.g. through HanabiObservation(state, state.CurPlayer()).
+// The callback is invoked concurrently from all search threads.
+using IsmctsEvaluator =
+    std::function<void(const std::vector<const HanabiState*>& states,
+                       std::vector<float>* priors,
+                       std::vector<float>* values)>;
+
+// Uniform priors, and the value of a single uniformly random rollout.
+// Rollout randomness is forked from each state's own stream.
+IsmctsEvaluator RandomRolloutEvaluator();
+
+// Uniform priors, and the value of one rollout in which every player acts
+// with the policy registered under policy_name (see MakePolicy).
+IsmctsEvaluator PolicyRolloutEvaluator(const std::string& policy_name);
+
+struct IsmctsOptions {
+  // Number of search threads sharing the tree.
+  int num_threads = 1;
+  // Total number of leaf evaluations across all threads.
+  int num_iterations = 1000;
+  // Leaves gathered per thread before calling the evaluator.
+  int batch_size = 8;
+  // Arena capacity. Expansion stops silently once it is exhausted.
+  int max_nodes = 1 << 20;
+  // Exploration constant of the PUCT selection rule.
+  float puct_c = 1.5;
+  // Number of pending visits (with value 0) added along an in-flight path.
+  int virtual_loss = 3;
+  // Iteration i of thread t draws from HanabiRng(seed, t, i), so a
+  // single-threaded search is reproducible.
+  uint64_t seed = 0;
+};
+
+// Search statistics at the root, indexed by move uid.
+struct IsmctsResult {
+  std::vector<int> visit_counts;
+  std::vector<float> q_values;  // Mean value, 0 for unvisited moves.
+  HanabiMove best_move{HanabiMove::kInvalid, -1, -1, -1, -1};
+  int num_nodes = 0;
+};
+
+// Tree node. Statistics are lock-free: value_sum is a fixed point sum so
+// it can be accumulated with a single fetch_add.
+struct IsmctsNode {
+  enum ExpandState { kUnexpanded = 0, kExpanding = 1, kExpanded = 2 };
+
+  std::atomic<int32_t> visits{0};
+  std::atomic<int32_t> virtual_loss{0};
+  std::atomic<int64_t> value_sum{0};
+  std::atomic<int32_t> expand_state{kUnexpanded};
+  // Written by the expanding thread before expand_state becomes kExpanded.
+  float prior = 0;
+  int32_t first_child = -1;
+  int32_t num_children = 0;
+};
+
+// Bump allocator for IsmctsNodes. Allocation is a single fetch_add, nodes are
+// never freed individually and the whole arena is recycled by Reset().
+class IsmctsNodeArena {
+ public:
+  explicit IsmctsNodeArena(int capacity);
+  // Returns the index of the first of count contiguous nodes, or -1 if the
+  // arena is exhausted.
+  int32_t Allocate(int count);
+  IsmctsNode& operator[](int32_t index) { return nodes_[index]; }
+  const IsmctsNode& operator[](int32_t index) const { return nodes_[index]; }
+  int Size() const;
+  int Capacity() const { return capacity_; }
+  // Not thread-safe. Must not be called while a search is running.
+  void Reset();
+
+ private:
+  std::unique_ptr<IsmctsNode[]> nodes_;
+  int capacity_;
+  std::atomic<int32_t> size_{0};
+};
+
+class Ismcts {
+ public:
+  // If evaluator is empty, RandomRolloutEvaluator() is used.
+  Ismcts(const HanabiGame* game, const IsmctsOptions& options,
+         IsmctsEvaluator evaluator = IsmctsEvaluator());
+
+  // Runs a search from the information set of root.CurPlayer(). Root must be
+  // a non-terminal state where a player (not chance) is to act.
+  IsmctsResult Search(const HanabiState& root);
+
+ private:
+  struct Leaf {
+    std::vector<int32_t> path;  // Node indices from the root to the leaf.
+    bool terminal = false;
+    float value = 0;
+  };
+
+  void SearchThread(const HanabiState& root, int thread_id,
+                    std::atomic<int>* iterations_left);
+  // Replaces root player's own cards with a sample consistent with their
+  // card knowledge and the cards they cannot see.
+  void Determinize(int player, HanabiState* state, HanabiRng* rng) const;
+  // Descends from the root, applying virtual loss, until an unexpanded node
+  // or a terminal state is reached.
+  void SelectLeaf(HanabiState* state, Leaf* leaf);
+  int32_t SelectChild(const IsmctsNode& node, const HanabiState& state) const;
+  void Expand(int32_t node_index, const float* priors);
+  void Backup(const Leaf& leaf, float value);
+
+  const HanabiGame* game_;
+  IsmctsOptions options_;
+  IsmctsEvaluator evaluator_;
+  IsmctsNodeArena arena_;
+  int32_t root_ = -1;
+};
+
+}  // namespace hanabi_learning_env
+
+#endif
@@ -0,0 +1,71 @@
+// Copyright 2018 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include "npy_writer.h"
+
+#include <string>
+
+#include "util.h"
+
+namespace hanabi_learning_env {
+
+NpyWriter::NpyWriter(const std::string& path, const std::string& descr,
+                     int row_size, int item_size)
+    : descr_(descr), row_size_(row_size), item_size_(item_size) {
+  file_ = std::fopen(path.c_str(), "wb");
+  REQUIRE(file_ != nullptr);
+  WriteHeader();
+}
+
+NpyWriter::~NpyWriter() { Close(); }
+
+void NpyWriter::Append(const void* rows, int64_t num_rows) {
+  REQUIRE(file_ != nullptr);
+  size_t count = num_rows * row_size_;
+  REQUIRE(std::fwrite(rows, item_size_, count, file_) == count);
+  num_rows_ += num_rows;
+}
+
+void NpyWriter::Close() {
+  if (file_ == nullptr) {
+    return;
+  }
+  std::fseek(file_, 0, SEEK_SET);
+  WriteHeader();
+  std::fclose(file_);
+  file_ = nullptr;
+}
+
+void NpyWriter::WriteHeader() {
+  std::string dict = "{'descr': '" + descr_ +
+                     "', 'fortran_order': False, 'shape': (" +
+                     std::to_string(num_rows_) + ", " +
+                     std::to_string(row_size_) + "), }";
+  // Magic string, version 1.0, little-endian header length, then the
+  // dictionary padded with spaces and terminated by a newline.
+  const int kPreambleSize = 10;
+  REQUIRE(kPreambleSize + dict.size() + 1 <= kHeaderSize);
+  dict.resize(kHeaderSize - kPreambleSize - 1, ' ');
+  dict += '\n';
+  const int header_len = kHeaderSize - kPreambleSize;
+  const char preamble[kPreambleSize] = {
+      '\x93', 'N', 'U', 'M', 'P', 'Y', 1, 0,
+      static_cast<char>(header_len & 0xff),
+      static_cast<char>(header_len >> 8)};
+  REQUIRE(std::fwrite(preamble, 1, kPreambleSize, file_) == kPreambleSize);
+  REQUIRE(std::fwrite(dict.data(), 1, dict.size(), file_) == dict.size());
+}
+
+}  // namespace hanabi_learning_env
@@ -0,0 +1,59 @@
+// Copyright 2018 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+// Streaming writer for 2-D numpy .npy (format 1.0) files.
+
+#ifndef __NPY_WRITER_H__
+#define __NPY_WRITER_H__
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+
+namespace hanabi_learning_env {
+
+// Rows are appended as they are produced. The header is written with a fixed
+// size (kHeaderSize bytes) and rewritten with the final row count on Close(),
+// so the data always starts at the same offset and the file can be loaded
+// with numpy.load(path, mmap_mode="r").
+class NpyWriter {
+ public:
+  static constexpr int kHeaderSize = 128;
+
+  // descr is the numpy type string, e.g. "<f4", "|u1" or "<i2".
+  NpyWriter(const std::string& path, const std::string& descr, int row_size,
+            int item_size);
+  ~NpyWriter();
+  NpyWriter(const NpyWriter&) = delete;
+  NpyWriter& operator=(const NpyWriter&) = delete;
+
+  // Appends num_rows rows of row_size items each.
+  void Append(const void* rows, int64_t num_rows);
+  int64_t NumRows() const { return num_rows_; }
+  void Close();
+
+ private:
+  void WriteHeader();
+
+  FILE* file_ = nullptr;
+  std::string descr_;
+  int row_size_;
+  int item_size_;
+  int64_t num_rows_ = 0;
+};
+
+}  // namespace hanabi_learning_env
+
+#endif
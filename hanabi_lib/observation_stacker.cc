@@ -0,0 +1,66 @@
+// Copyright 2018 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include "observation_stacker.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include "util.h"
+
+namespace hanabi_learning_env {
+
+ObservationStacker::ObservationStacker(int num_players, int history_size,
+                                       int observation_size)
+    : num_players_(num_players),
+      history_size_(history_size),
+      observation_size_(observation_size),
+      frames_(static_cast<size_t>(num_players) * 2 * history_size *
+              observation_size),
+      next_(num_players) {
+  REQUIRE(num_players > 0 && history_size > 0 && observation_size > 0);
+}
+
+void ObservationStacker::Reset() {
+  std::fill(frames_.begin(), frames_.end(), 0.0f);
+  std::fill(next_.begin(), next_.end(), 0);
+  episode_over_ = false;
+}
+
+void ObservationStacker::Add(int player, const float* observation) {
+  REQUIRE(player >= 0 && player < num_players_);
+  if (episode_over_) {
+    Reset();
+  }
+  float* frames = &frames_[static_cast<size_t>(player) * 2 * StackSize()];
+  int slot = next_[player];
+  std::memcpy(frames + slot * observation_size_, observation,
+              observation_size_ * sizeof(float));
+  std::memcpy(frames + (slot + history_size_) * observation_size_,
+              observation, observation_size_ * sizeof(float));
+  next_[player] = (slot + 1) % history_size_;
+}
+
+const float* ObservationStacker::Stack(int player) const {
+  REQUIRE(player >= 0 && player < num_players_);
+  return &frames_[static_cast<size_t>(player) * 2 * StackSize() +
+                  next_[player] * observation_size_];
+}
+
+void ObservationStacker::CopyStack(int player, float* out) const {
+  std::memcpy(out, Stack(player), StackSize() * sizeof(float));
+}
+
+}  // namespace hanabi_learning_env
@@ -0,0 +1,66 @@
+// Copyright 2018 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+// Per-player history of the last history_size observations.
+//
+// Each player's history is a ring of history_size frames in which every
+// frame is also written history_size frames further on. The last
+// history_size frames, oldest first, are then always a contiguous window of
+// the ring, so Stack() can return a pointer without rotating anything, and
+// adding an observation copies one frame instead of the whole stack.
+
+#ifndef __OBSERVATION_STACKER_H__
+#define __OBSERVATION_STACKER_H__
+
+#include <vector>
+
+namespace hanabi_learning_env {
+
+class ObservationStacker {
+ public:
+  ObservationStacker(int num_players, int history_size, int observation_size);
+
+  int NumPlayers() const { return num_players_; }
+  int HistorySize() const { return history_size_; }
+  int ObservationSize() const { return observation_size_; }
+  // Length of a stacked observation, history_size * observation_size.
+  int StackSize() const { return history_size_ * observation_size_; }
+
+  // Clears every history to zeros.
+  void Reset();
+  // Marks the end of an episode. The next Add() first calls Reset().
+  void EndEpisode() { episode_over_ = true; }
+  // Appends observation_size values to the history of player.
+  void Add(int player, const float* observation);
+  // Returns StackSize() values, the history of player oldest first. Valid
+  // until the next Add() or Reset().
+  const float* Stack(int player) const;
+  // Copies Stack(player) to out.
+  void CopyStack(int player, float* out) const;
+
+ private:
+  int num_players_;
+  int history_size_;
+  int observation_size_;
+  bool episode_over_ = false;
+  // Per player, 2 * history_size frames.
+  std::vector<float> frames_;
+  // Per player, ring slot of the oldest frame, where the next one goes.
+  std::vector<int> next_;
+};
+
+}  // namespace hanabi_learning_env
+
+#endif
@@ -0,0 +1,441 @@
+// Copyright 2018 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include "prioritized_replay.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <limits>
+#include <random>
+
+#include "util.h"
+
+namespace hanabi_learning_env {
+
+namespace {
+
+constexpr int kCacheLine = 64;
+constexpr char kMagic[4] = {'H', 'R', 'P', 'L'};
+constexpr uint32_t kVersion = 1;
+
+int RoundUp(int value, int multiple) {
+  return (value + multiple - 1) / multiple * multiple;
+}
+
+bool GetBit(const uint8_t* bits, int index) {
+  return (bits[index >> 3] >> (7 - (index & 7))) & 1;
+}
+
+// kUnpackedBytes.bits[v] holds the eight bits of v, most significant first.
+struct UnpackTable {
+  UnpackTable() {
+    for (int v = 0; v < 256; ++v) {
+      for (int b = 0; b < 8; ++b) {
+        bits[v][b] = (v >> (7 - b)) & 1;
+      }
+    }
+  }
+  uint8_t bits[256][8];
+};
+const UnpackTable kUnpackedBytes;
+
+template <typename T>
+void WriteArray(const std::vector<T>& values, FILE* file) {
+  REQUIRE(std::fwrite(values.data(), sizeof(T), values.size(), file) ==
+          values.size());
+}
+
+template <typename T>
+void ReadArray(std::vector<T>* values, FILE* file) {
+  REQUIRE(std::fread(values->data(), sizeof(T), values->size(), file) ==
+          values->size());
+}
+
+}  // namespace
+
+constexpr int SumTree::kFanout;
+constexpr float PrioritizedReplayMemory::kDefaultPriority;
+constexpr int PrioritizedReplayMemory::kMaxSampleAttempts;
+
+SumTree::SumTree(int capacity) : capacity_(capacity) {
+  REQUIRE(capacity > 0);
+  // Level sizes from the leaves up, each padded to whole child blocks.
+  std::vector<int> sizes = {RoundUp(capacity, kFanout)};
+  while (sizes.back() > kFanout) {
+    sizes.push_back(RoundUp(sizes.back() / kFanout, kFanout));
+  }
+  sizes.push_back(kFanout);  // The root, padded to keep levels aligned.
+  std::reverse(sizes.begin(), sizes.end());
+  int offset = 0;
+  for (int size : sizes) {
+    level_offsets_.push_back(offset);
+    offset += size;
+  }
+  constexpr int kLineValues = kCacheLine / sizeof(double);
+  storage_.assign(offset + kLineValues, 0.0);
+  uintptr_t address = reinterpret_cast<uintptr_t>(storage_.data());
+  nodes_ = storage_.data() +
+           (kCacheLine - address % kCacheLine) % kCacheLine / sizeof(double);
+}
+
+double SumTree::Get(int index) const {
+  REQUIRE(index >= 0 && index < capacity_);
+  return Level(level_offsets_.size() - 1)[index];
+}
+
+void SumTree::UpdateParent(int depth, int node) {
+  const double* children = Level(depth + 1) + node * kFanout;
+  double sum = 0;
+  for (int i = 0; i < kFanout; ++i) {
+    sum += children[i];
+  }
+  Level(depth)[node] = sum;
+}
+
+void SumTree::Set(int index, double value) {
+  REQUIRE(index >= 0 && index < capacity_);
+  REQUIRE(value >= 0);
+  max_recorded_priority_ = std::max(max_recorded_priority_, value);
+  int depth = level_offsets_.size() - 1;
+  Level(depth)[index] = value;
+  for (int node = index / kFanout; depth > 0; node /= kFanout) {
+    UpdateParent(--depth, node);
+  }
+}
+
+void SumTree::SetBatch(int num_values, const int* indices,
+                       const float* values) {
+  int depth = level_offsets_.size() - 1;
+  std::vector<int> nodes(indices, indices + num_values);
+  for (int i = 0; i < num_values; ++i) {
+    REQUIRE(indices[i] >= 0 && indices[i] < capacity_);
+    REQUIRE(values[i] >= 0);
+    max_recorded_priority_ =
+        std::max(max_recorded_priority_, static_cast<double>(values[i]));
+    Level(depth)[indices[i]] = values[i];
+  }
+  while (depth > 0) {
+    for (int& node : nodes) {
+      node /= kFanout;
+    }
+    std::sort(nodes.begin(), nodes.end());
+    nodes.erase(std::unique(nodes.begin(), nodes.end()), nodes.end());
+    --depth;
+    for (int node : nodes) {
+      UpdateParent(depth, node);
+    }
+  }
+}
+
+int SumTree::Find(double query) const {
+  REQUIRE(Total() > 0);
+  int node = 0;
+  for (int depth = 1; depth < level_offsets_.size(); ++depth) {
+    const double* children = Level(depth) + node * kFanout;
+    // Rounding can leave query at or past the sum of the children; then
+    // take the last child that has any priority.
+    int chosen = -1;
+    for (int i = 0; i < kFanout; ++i) {
+      if (children[i] > 0) {
+        chosen = i;
+        if (query < children[i]) {
+          break;
+        }
+        query -= children[i];
+      }
+    }
+    REQUIRE(chosen >= 0);
+    node = node * kFanout + chosen;
+  }
+  return node;
+}
+
+void SumTree::StratifiedSample(int num_samples, HanabiRng* rng,
+                               int* indices) const {
+  std::uniform_real_distribution<double> uniform(0.0, 1.0);
+  double segment = Total() / num_samples;
+  for (int i = 0; i < num_samples; ++i) {
+    indices[i] = Find((i + uniform(*rng)) * segment);
+  }
+}
+
+PrioritizedReplayMemory::PrioritizedReplayMemory(
+    int num_actions, int observation_size, int stack_size, int capacity,
+    int update_horizon, float gamma, uint64_t seed)
+    : num_actions_(num_actions),
+      observation_size_(observation_size),
+      stack_size_(stack_size),
+      capacity_(capacity),
+      update_horizon_(update_horizon),
+      observation_bytes_((observation_size + 7) / 8),
+      legal_action_bytes_((num_actions + 7) / 8),
+      observations_(static_cast<size_t>(capacity) * observation_bytes_),
+      actions_(capacity),
+      rewards_(capacity),
+      terminals_(capacity),
+      legal_actions_(static_cast<size_t>(capacity) * legal_action_bytes_),
+      tree_(capacity),
+      rng_(seed, 0, 0) {
+  REQUIRE(num_actions > 0 && observation_size > 0 && stack_size > 0);
+  REQUIRE(update_horizon >= 1 && capacity > update_horizon);
+  REQUIRE(gamma >= 0 && gamma <= 1);
+  for (int n = 0; n < update_horizon; ++n) {
+    cumulative_discount_.push_back(std::pow(gamma, n));
+  }
+}
+
+int64_t PrioritizedReplayMemory::AddCount() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return add_count_;
+}
+
+void PrioritizedReplayMemory::Add(const uint8_t* observation, int action,
+                                  float reward, bool terminal,
+                                  const uint8_t* legal_actions) {
+  REQUIRE(observation != nullptr && legal_actions != nullptr);
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (add_count_ == 0 || terminals_[(Cursor() + capacity_ - 1) % capacity_]) {
+    // Padding frames mark every action legal, like the zero vector of the
+    // Python memory, so a terminal transition never bootstraps from a row
+    // of -inf values.
+    std::vector<uint8_t> padding(observation_bytes_, 0);
+    std::vector<uint8_t> all_legal(legal_action_bytes_, 0xff);
+    for (int i = 0; i < stack_size_ - 1; ++i) {
+      AddFrame(padding.data(), 0, 0, false, all_legal.data(), 0);
+    }
+  }
+  AddFrame(observation, action, reward, terminal, legal_actions,
+           kDefaultPriority);
+}
+
+void PrioritizedReplayMemory::AddFrame(const uint8_t* observation, int action,
+                                       float reward, bool terminal,
+                                       const uint8_t* legal_actions,
+                                       float priority) {
+  int cursor = Cursor();
+  std::memcpy(&observations_[static_cast<size_t>(cursor) * observation_bytes_],
+              observation, observation_bytes_);
+  std::memcpy(
+      &legal_actions_[static_cast<size_t>(cursor) * legal_action_bytes_],
+      legal_actions, legal_action_bytes_);
+  actions_[cursor] = action;
+  rewards_[cursor] = reward;
+  terminals_[cursor] = terminal;
+  tree_.Set(cursor, priority);
+  ++add_count_;
+}
+
+bool PrioritizedReplayMemory::IsValidTransition(int index) const {
+  if (index < 0 || index >= capacity_) {
+    return false;
+  }
+  int cursor = Cursor();
+  if (!IsFull()) {
+    // The transition and its next state must have been added, and the
+    // first indices hold the padding of the first episode.
+    if (index >= cursor - update_horizon_ || index < stack_size_ - 1) {
+      return false;
+    }
+  }
+  // Skip the stack_size indices from cursor - 1 on, whose stacks straddle
+  // the cursor.
+  if ((index - (cursor - 1) + capacity_) % capacity_ < stack_size_) {
+    return false;
+  }
+  // A terminal flag in any frame but the last means the stack spans two
+  // episodes.
+  for (int i = 1; i < stack_size_; ++i) {
+    if (terminals_[(index - i + capacity_) % capacity_]) {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool PrioritizedReplayMemory::SampleIndicesLocked(int batch_size,
+                                                  int* indices) {
+  if (tree_.Total() <= 0) {
+    return false;
+  }
+  tree_.StratifiedSample(batch_size, &rng_, indices);
+  // Redraw invalid samples from the same segment.
+  std::uniform_real_distribution<double> uniform(0.0, 1.0);
+  double segment = tree_.Total() / batch_size;
+  int attempts = kMaxSampleAttempts;
+  for (int i = 0; i < batch_size; ++i) {
+    while (!IsValidTransition(indices[i])) {
+      if (--attempts < 0) {
+        return false;
+      }
+      indices[i] = tree_.Find((i + uniform(rng_)) * segment);
+    }
+  }
+  return true;
+}
+
+bool PrioritizedReplayMemory::SampleIndexBatch(int batch_size, int* indices) {
+  REQUIRE(batch_size > 0 && indices != nullptr);
+  std::lock_guard<std::mutex> lock(mutex_);
+  return SampleIndicesLocked(batch_size, indices);
+}
+
+void PrioritizedReplayMemory::GetObservationStack(int index,
+                                                  uint8_t* out) const {
+  for (int k = 0; k < stack_size_; ++k) {
+    int frame = (index - stack_size_ + 1 + k + capacity_) % capacity_;
+    const uint8_t* bits =
+        &observations_[static_cast<size_t>(frame) * observation_bytes_];
+    for (int byte = 0; byte < observation_bytes_; ++byte) {
+      const uint8_t* unpacked = kUnpackedBytes.bits[bits[byte]];
+      int count = std::min(8, observation_size_ - byte * 8);
+      if (stack_size_ == 1) {
+        std::memcpy(out + byte * 8, unpacked, count);
+      } else {
+        for (int b = 0; b < count; ++b) {
+          out[(byte * 8 + b) * stack_size_ + k] = unpacked[b];
+        }
+      }
+    }
+  }
+}
+
+bool PrioritizedReplayMemory::SampleTransitionBatch(int batch_size,
+                                                    const int* indices,
+                                                    const ReplayBatch& batch) {
+  REQUIRE(batch_size > 0);
+  std::lock_guard<std::mutex> lock(mutex_);
+  std::vector<int> sampled;
+  if (indices == nullptr) {
+    sampled.resize(batch_size);
+    if (!SampleIndicesLocked(batch_size, sampled.data())) {
+      return false;
+    }
+    indices = sampled.data();
+  }
+  const size_t stack_bytes =
+      static_cast<size_t>(observation_size_) * stack_size_;
+  for (int b = 0; b < batch_size; ++b) {
+    int index = indices[b];
+    REQUIRE(index >= 0 && index < capacity_);
+    batch.indices[b] = index;
+    batch.actions[b] = actions_[index];
+    GetObservationStack(index, batch.states + b * stack_bytes);
+    // Sum the discounted rewards up to and including the first terminal.
+    float reward = 0;
+    bool terminal = false;
+    for (int j = 0; j < update_horizon_ && !terminal; ++j) {
+      int step = (index + j) % capacity_;
+      reward += cumulative_discount_[j] * rewards_[step];
+      terminal = terminals_[step];
+    }
+    batch.rewards[b] = reward;
+    batch.terminals[b] = terminal;
+    int bootstrap = (index + update_horizon_) % capacity_;
+    GetObservationStack(bootstrap, batch.next_states + b * stack_bytes);
+    const uint8_t* legal =
+        &legal_actions_[static_cast<size_t>(bootstrap) * legal_action_bytes_];
+    float* next_legal = batch.next_legal_actions + b * num_actions_;
+    for (int a = 0; a < num_actions_; ++a) {
+      next_legal[a] =
+          GetBit(legal, a) ? 0 : -std::numeric_limits<float>::infinity();
+    }
+  }
+  return true;
+}
+
+void PrioritizedReplayMemory::SetPriorities(int num_indices,
+                                            const int* indices,
+                                            const float* priorities) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  tree_.SetBatch(num_indices, indices, priorities);
+}
+
+void PrioritizedReplayMemory::GetPriorities(int num_indices,
+                                            const int* indices,
+                                            float* priorities) const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  for (int i = 0; i < num_indices; ++i) {
+    priorities[i] = tree_.Get(indices[i]);
+  }
+}
+
+// File layout (host byte order):
+//   "HRPL" uint32 version
+//   int32 num_actions, observation_size, stack_size, capacity,
+//         update_horizon
+//   int64 add_count
+//   observations, actions, rewards, terminals, legal_actions as stored
+//   float priorities[capacity]
+void PrioritizedReplayMemory::Save(const std::string& path) const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  FILE* file = std::fopen(path.c_str(), "wb");
+  REQUIRE(file != nullptr);
+  REQUIRE(std::fwrite(kMagic, 1, 4, file) == 4);
+  std::vector<uint32_t> version = {kVersion};
+  WriteArray(version, file);
+  std::vector<int32_t> params = {num_actions_, observation_size_, stack_size_,
+                                 capacity_, update_horizon_};
+  WriteArray(params, file);
+  std::vector<int64_t> add_count = {add_count_};
+  WriteArray(add_count, file);
+  WriteArray(observations_, file);
+  WriteArray(actions_, file);
+  WriteArray(rewards_, file);
+  WriteArray(terminals_, file);
+  WriteArray(legal_actions_, file);
+  std::vector<float> priorities(capacity_);
+  for (int i = 0; i < capacity_; ++i) {
+    priorities[i] = tree_.Get(i);
+  }
+  WriteArray(priorities, file);
+  REQUIRE(std::fclose(file) == 0);
+}
+
+void PrioritizedReplayMemory::Load(const std::string& path) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  FILE* file = std::fopen(path.c_str(), "rb");
+  REQUIRE(file != nullptr);
+  char magic[4];
+  REQUIRE(std::fread(magic, 1, 4, file) == 4);
+  REQUIRE(std::memcmp(magic, kMagic, 4) == 0);
+  std::vector<uint32_t> version(1);
+  ReadArray(&version, file);
+  REQUIRE(version[0] == kVersion);
+  std::vector<int32_t> params(5);
+  ReadArray(&params, file);
+  REQUIRE(params == std::vector<int32_t>({num_actions_, observation_size_,
+                                          stack_size_, capacity_,
+                                          update_horizon_}));
+  std::vector<int64_t> add_count(1);
+  ReadArray(&add_count, file);
+  add_count_ = add_count[0];
+  ReadArray(&observations_, file);
+  ReadArray(&actions_, file);
+  ReadArray(&rewards_, file);
+  ReadArray(&terminals_, file);
+  ReadArray(&legal_actions_, file);
+  std::vector<float> priorities(capacity_);
+  ReadArray(&priorities, file);
+  std::fclose(file);
+  std::vector<int> indices(capacity_);
+  for (int i = 0; i < capacity_; ++i) {
+    indices[i] = i;
+  }
+  tree_.SetBatch(capacity_, indices.data(), priorities.data());
+}
+
+}  // namespace hanabi_learning_env
@@ -0,0 +1,182 @@
+// Copyright 2018 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+// Prioritized experience replay (Schaul et al. 2015) for packed Hanabi
+// observations.
+//
+// PrioritizedReplayMemory has the semantics of the rainbow agent's
+// OutOfGraphPrioritizedReplayMemory: frame stacking with padding frames at
+// episode starts, n-step discounted returns and the same validity rules for
+// sampled transitions. Observations are stored one bit per value, as written
+// by EncodeObservationsPacked, and legal actions one bit per action.
+//
+// Sampling is stratified as in the paper: [0, total priority) is split into
+// batch_size equal segments and one transition is drawn from each.
+
+#ifndef __PRIORITIZED_REPLAY_H__
+#define __PRIORITIZED_REPLAY_H__
+
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "hanabi_rng.h"
+
+namespace hanabi_learning_env {
+
+// Sum tree over non-negative leaf priorities.
+//
+// Every internal node has kFanout children, stored contiguously and aligned
+// so that the children of a node fill exactly one cache line. A descent
+// reads one line per level, and a capacity of one million needs 7 levels
+// rather than the 20 of a binary tree. Parents are recomputed from their
+// children instead of being adjusted by a delta, so sums do not drift.
+class SumTree {
+ public:
+  static constexpr int kFanout = 8;
+
+  explicit SumTree(int capacity);
+  SumTree(const SumTree&) = delete;
+  SumTree& operator=(const SumTree&) = delete;
+
+  int Capacity() const { return capacity_; }
+  double Total() const { return Level(0)[0]; }
+  double Get(int index) const;
+  // Largest priority ever set, starting at 1.
+  double MaxRecordedPriority() const { return max_recorded_priority_; }
+
+  void Set(int index, double value);
+  // Sets num_values leaves and recomputes each affected internal node once.
+  void SetBatch(int num_values, const int* indices, const float* values);
+  // Returns the leaf whose cumulative priority range contains query, which
+  // must be in [0, Total()). Leaves with zero priority are never returned.
+  int Find(double query) const;
+  // Draws one leaf from each of num_samples equal segments of [0, Total()).
+  void StratifiedSample(int num_samples, HanabiRng* rng, int* indices) const;
+
+ private:
+  double* Level(int depth) { return nodes_ + level_offsets_[depth]; }
+  const double* Level(int depth) const {
+    return nodes_ + level_offsets_[depth];
+  }
+  void UpdateParent(int depth, int node);
+
+  int capacity_;
+  // level_offsets_[0] is the root, the last level holds the leaves.
+  std::vector<int> level_offsets_;
+  std::vector<double> storage_;
+  // Cache-line aligned start of storage_.
+  double* nodes_;
+  double max_recorded_priority_ = 1.0;
+};
+
+// Caller-owned output arrays for one sampled batch. The shapes match the
+// tensors of the rainbow agent's WrappedReplayMemory.
+struct ReplayBatch {
+  uint8_t* states;            // batch x observation_size x stack_size
+  int32_t* actions;           // batch
+  float* rewards;             // batch, discounted n-step returns
+  uint8_t* next_states;       // batch x observation_size x stack_size
+  uint8_t* terminals;         // batch
+  int32_t* indices;           // batch
+  float* next_legal_actions;  // batch x num_actions, 0 if legal else -inf
+};
+
+// All methods may be called concurrently, e.g. by actor threads adding
+// transitions while a learner samples and updates priorities.
+class PrioritizedReplayMemory {
+ public:
+  // Priority of newly added transitions.
+  static constexpr float kDefaultPriority = 100.0f;
+  static constexpr int kMaxSampleAttempts = 1000000;
+
+  PrioritizedReplayMemory(int num_actions, int observation_size,
+                          int stack_size, int capacity, int update_horizon,
+                          float gamma, uint64_t seed);
+  PrioritizedReplayMemory(const PrioritizedReplayMemory&) = delete;
+  PrioritizedReplayMemory& operator=(const PrioritizedReplayMemory&) = delete;
+
+  int NumActions() const { return num_actions_; }
+  int ObservationSize() const { return observation_size_; }
+  int StackSize() const { return stack_size_; }
+  int Capacity() const { return capacity_; }
+  // Bytes of a packed observation, (observation_size + 7) / 8.
+  int ObservationBytes() const { return observation_bytes_; }
+  // Bytes of a packed legal action mask, (num_actions + 7) / 8.
+  int LegalActionBytes() const { return legal_action_bytes_; }
+  int64_t AddCount() const;
+
+  // Adds a transition with kDefaultPriority. observation and legal_actions
+  // are bit-packed, most significant bit first, with legal actions set. The
+  // next observation is the one added next. A new episode (the first add,
+  // or the add after a terminal one) is preceded by stack_size - 1 padding
+  // frames with zero priority.
+  void Add(const uint8_t* observation, int action, float reward,
+           bool terminal, const uint8_t* legal_actions);
+
+  // Writes batch_size valid transition indices drawn in proportion to their
+  // priorities. Returns false if not enough valid transitions were found in
+  // kMaxSampleAttempts draws.
+  bool SampleIndexBatch(int batch_size, int* indices);
+  // Fills batch with the transitions at indices, or with sampled ones if
+  // indices is null. Returns false if sampling failed.
+  bool SampleTransitionBatch(int batch_size, const int* indices,
+                             const ReplayBatch& batch);
+
+  void SetPriorities(int num_indices, const int* indices,
+                     const float* priorities);
+  void GetPriorities(int num_indices, const int* indices,
+                     float* priorities) const;
+
+  // Writes or restores the complete contents, including priorities. Load
+  // requires a memory constructed with the same parameters.
+  void Save(const std::string& path) const;
+  void Load(const std::string& path);
+
+ private:
+  void AddFrame(const uint8_t* observation, int action, float reward,
+                bool terminal, const uint8_t* legal_actions, float priority);
+  bool IsValidTransition(int index) const;
+  bool SampleIndicesLocked(int batch_size, int* indices);
+  // Unpacks the stack_size frames ending at index into
+  // observation_size x stack_size bytes.
+  void GetObservationStack(int index, uint8_t* out) const;
+  int Cursor() const { return add_count_ % capacity_; }
+  bool IsFull() const { return add_count_ >= capacity_; }
+
+  int num_actions_;
+  int observation_size_;
+  int stack_size_;
+  int capacity_;
+  int update_horizon_;
+  int observation_bytes_;
+  int legal_action_bytes_;
+  // gamma^0 .. gamma^(update_horizon - 1).
+  std::vector<float> cumulative_discount_;
+  std::vector<uint8_t> observations_;
+  std::vector<int32_t> actions_;
+  std::vector<float> rewards_;
+  std::vector<uint8_t> terminals_;
+  std::vector<uint8_t> legal_actions_;
+  int64_t add_count_ = 0;
+  SumTree tree_;
+  HanabiRng rng_;
+  mutable std::mutex mutex_;
+};
+
+}  // namespace hanabi_learning_env
+
+#endif
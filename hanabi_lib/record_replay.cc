@@ -0,0 +1,271 @@
+// Copyright 2018 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include "record_replay.h"
+
+#include <algorithm>
+#include <cstring>
+#include <random>
+
+#include "hanabi_observation.h"
+#include "util.h"
+
+namespace hanabi_learning_env {
+
+RecordReplay::RecordReplay(const HanabiGame* game, int capacity,
+                           int num_threads, uint64_t seed)
+    : game_(game),
+      encoder_(game),
+      capacity_(capacity),
+      num_threads_(num_threads),
+      records_(capacity),
+      tree_(capacity),
+      rng_(seed, 0, 0),
+      cursors_(num_threads) {
+  REQUIRE(game != nullptr);
+  REQUIRE(num_threads > 0);
+  for (int t = 1; t < num_threads; ++t) {
+    threads_.emplace_back(&RecordReplay::WorkerLoop, this, t);
+  }
+}
+
+RecordReplay::~RecordReplay() {
+  {
+    std::lock_guard<std::mutex> lock(pool_mutex_);
+    stop_ = true;
+  }
+  work_cv_.notify_all();
+  for (auto& thread : threads_) {
+    thread.join();
+  }
+}
+
+void RecordReplay::WorkerLoop(int thread) {
+  int64_t num_served = 0;
+  std::unique_lock<std::mutex> lock(pool_mutex_);
+  while (true) {
+    work_cv_.wait(lock, [&]() { return stop_ || num_jobs_ > num_served; });
+    if (stop_) {
+      return;
+    }
+    num_served = num_jobs_;
+    const Job job = job_;
+    lock.unlock();
+    EncodeRequests((*job.requests)[thread], *job.records, &cursors_[thread],
+                   *job.batch);
+    lock.lock();
+    if (--num_busy_ == 0) {
+      done_cv_.notify_one();
+    }
+  }
+}
+
+int64_t RecordReplay::AddCount() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return add_count_;
+}
+
+int64_t RecordReplay::NumTimesteps() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return static_cast<int64_t>(tree_.Total());
+}
+
+int64_t RecordReplay::AddGame(const HanabiState& state) {
+  REQUIRE(state.ParentGame() == game_);
+  return AddRecord(GameRecord::FromState(state, 0));
+}
+
+int64_t RecordReplay::AddRecord(const GameRecord& record) {
+  if (record.moves.empty()) {
+    return -1;
+  }
+  std::lock_guard<std::mutex> lock(mutex_);
+  int slot = add_count_ % capacity_;
+  records_[slot] = record;
+  tree_.Set(slot, record.moves.size());
+  return add_count_++;
+}
+
+bool RecordReplay::Sample(int batch_size, const RecordBatch& batch) {
+  REQUIRE(batch_size > 0);
+  std::vector<GameRecord> records;
+  std::vector<std::vector<Request>> requests;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (tree_.Total() <= 0) {
+      return false;
+    }
+    std::vector<int> slots(batch_size);
+    tree_.StratifiedSample(batch_size, &rng_, slots.data());
+    for (int i = 0; i < batch_size; ++i) {
+      // The newest game in the slot.
+      batch.game_ids[i] =
+          add_count_ - 1 - (add_count_ - 1 - slots[i]) % capacity_;
+      std::uniform_int_distribution<int> step(
+          0, records_[slots[i]].moves.size() - 1);
+      batch.steps[i] = step(rng_);
+    }
+    // Under the same lock, so that the sampled games cannot be overwritten
+    // before they are copied.
+    CopyRequestsLocked(batch_size, batch, &records, &requests);
+  }
+  EncodeCopied(records, &requests, batch);
+  return true;
+}
+
+void RecordReplay::Encode(int batch_size, const RecordBatch& batch) {
+  std::vector<GameRecord> records;
+  std::vector<std::vector<Request>> requests;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    CopyRequestsLocked(batch_size, batch, &records, &requests);
+  }
+  EncodeCopied(records, &requests, batch);
+}
+
+void RecordReplay::CopyRequestsLocked(
+    int batch_size, const RecordBatch& batch,
+    std::vector<GameRecord>* records,
+    std::vector<std::vector<Request>>* requests) const {
+  requests->assign(num_threads_, std::vector<Request>());
+  std::vector<std::pair<int64_t, int>> copied;
+  for (int i = 0; i < batch_size; ++i) {
+    int64_t game_id = batch.game_ids[i];
+    REQUIRE(game_id >= 0 && game_id < add_count_ &&
+            game_id >= add_count_ - capacity_);
+    const GameRecord& record = records_[game_id % capacity_];
+    REQUIRE(batch.steps[i] >= 0 && batch.steps[i] < record.moves.size());
+    int record_index = -1;
+    for (const auto& entry : copied) {
+      if (entry.first == game_id) {
+        record_index = entry.second;
+      }
+    }
+    if (record_index < 0) {
+      record_index = records->size();
+      records->push_back(record);
+      copied.emplace_back(game_id, record_index);
+    }
+    (*requests)[game_id % num_threads_].push_back(
+        {game_id, batch.steps[i], i, record_index});
+  }
+}
+
+void RecordReplay::EncodeCopied(
+    const std::vector<GameRecord>& records,
+    std::vector<std::vector<Request>>* requests, const RecordBatch& batch) {
+  for (auto& thread_requests : *requests) {
+    std::sort(thread_requests.begin(), thread_requests.end(),
+              [](const Request& a, const Request& b) {
+                return a.game_id != b.game_id ? a.game_id < b.game_id
+                                              : a.step < b.step;
+              });
+  }
+  std::lock_guard<std::mutex> encode_lock(encode_mutex_);
+  if (!threads_.empty()) {
+    {
+      std::lock_guard<std::mutex> lock(pool_mutex_);
+      job_.requests = requests;
+      job_.records = &records;
+      job_.batch = &batch;
+      ++num_jobs_;
+      num_busy_ = threads_.size();
+    }
+    work_cv_.notify_all();
+  }
+  EncodeRequests((*requests)[0], records, &cursors_[0], batch);
+  if (!threads_.empty()) {
+    std::unique_lock<std::mutex> lock(pool_mutex_);
+    done_cv_.wait(lock, [this]() { return num_busy_ == 0; });
+  }
+}
+
+void RecordReplay::Advance(const GameRecord& record, int step,
+                           Cursor* cursor) const {
+  HanabiState* state = cursor->state.get();
+  while (!state->IsTerminal()) {
+    if (state->CurPlayer() == kChancePlayerId) {
+      if (cursor->next_card == record.dealt.size()) {
+        break;
+      }
+      int index = record.dealt[cursor->next_card++];
+      state->ApplyMove(HanabiMove(HanabiMove::kDeal, -1, -1,
+                                  index / game_->NumRanks(),
+                                  index % game_->NumRanks()));
+      continue;
+    }
+    if (cursor->next_move == step) {
+      break;
+    }
+    state->ApplyMove(game_->GetMove(record.moves[cursor->next_move++]));
+  }
+}
+
+void RecordReplay::EncodeRequests(const std::vector<Request>& requests,
+                                  const std::vector<GameRecord>& records,
+                                  Cursor* cursor,
+                                  const RecordBatch& batch) const {
+  const int length = encoder_.EncodingLength();
+  const int max_moves = game_->MaxMoves();
+  const Request* previous = nullptr;
+  for (const Request& request : requests) {
+    const int i = request.index;
+    if (previous != nullptr && previous->game_id == request.game_id &&
+        previous->step == request.step) {
+      // Sampled again in this batch: copy the row encoded for it.
+      const int j = previous->index;
+      std::memcpy(batch.observations + static_cast<size_t>(i) * length,
+                  batch.observations + static_cast<size_t>(j) * length,
+                  length * sizeof(float));
+      std::memcpy(batch.legal_masks + i * max_moves,
+                  batch.legal_masks + j * max_moves, max_moves);
+      batch.actions[i] = batch.actions[j];
+      batch.rewards[i] = batch.rewards[j];
+      batch.terminals[i] = batch.terminals[j];
+      std::memcpy(batch.next_observations + static_cast<size_t>(i) * length,
+                  batch.next_observations + static_cast<size_t>(j) * length,
+                  length * sizeof(float));
+      continue;
+    }
+    previous = &request;
+    const GameRecord& record = records[request.record];
+    if (cursor->game_id != request.game_id ||
+        cursor->next_move > request.step) {
+      cursor->game_id = request.game_id;
+      cursor->state.reset(
+          new HanabiState(game_, HanabiRng(), record.start_player));
+      cursor->next_card = 0;
+      cursor->next_move = 0;
+    }
+    Advance(record, request.step, cursor);
+    HanabiState* state = cursor->state.get();
+    const int player = state->CurPlayer();
+    HanabiObservation observation(*state, player);
+    encoder_.EncodeInto(observation, false, {}, false, {}, {}, false,
+                        batch.observations + static_cast<size_t>(i) * length);
+    encoder_.EncodeLegalMoves(observation,
+                              batch.legal_masks + i * max_moves);
+    const int score = state->Score();
+    batch.actions[i] = record.moves[request.step];
+    Advance(record, request.step + 1, cursor);
+    batch.rewards[i] = state->Score() - score;
+    batch.terminals[i] = state->IsTerminal();
+    encoder_.EncodeInto(
+        HanabiObservation(*state, player), false, {}, false, {}, {}, false,
+        batch.next_observations + static_cast<size_t>(i) * length);
+  }
+}
+
+}  // namespace hanabi_learning_env
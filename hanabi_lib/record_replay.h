@@ -0,0 +1,161 @@
+// Copyright 2018 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+// Replay memory that stores whole games as GameRecords and re-encodes the
+// sampled timesteps on demand.
+//
+// A 2-player canonical observation is about 650 floats while a record of the
+// whole game is under 200 bytes, so this keeps far more experience in the
+// same memory. Timestep t of a game is the state before its t-th player
+// move. Timesteps are sampled uniformly over all stored timesteps, through a
+// sum tree weighted by each game's number of moves, and regenerated by
+// replaying the record with CanonicalObservationEncoder.
+//
+// Replaying is split by game across the calling thread and a pool of
+// threads owned by the replay, and every thread keeps the state it last
+// replayed. Requests for the same game are served in step order from that
+// state, so consecutive timesteps, in one batch or across batches, only
+// replay the moves in between. A timestep requested twice in a batch is
+// encoded once and copied.
+
+#ifndef __RECORD_REPLAY_H__
+#define __RECORD_REPLAY_H__
+
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "canonical_encoders.h"
+#include "game_record.h"
+#include "hanabi_game.h"
+#include "hanabi_rng.h"
+#include "hanabi_state.h"
+#include "prioritized_replay.h"
+
+namespace hanabi_learning_env {
+
+// Caller-owned outputs for a batch of timesteps. Observations are from the
+// view of the player acting at the timestep.
+struct RecordBatch {
+  int64_t* game_ids;             // batch
+  int32_t* steps;                // batch
+  float* observations;           // batch x EncodingLength()
+  uint8_t* legal_masks;          // batch x MaxMoves()
+  int32_t* actions;              // batch, move uid played at the timestep
+  float* rewards;                // batch, score change of that move
+  uint8_t* terminals;            // batch, whether the move ended the game
+  float* next_observations;      // batch x EncodingLength(), same player,
+                                 // after the move and any deal
+};
+
+// All methods may be called concurrently. Encoding does not hold the lock
+// that guards the records, so actors can keep adding games meanwhile.
+class RecordReplay {
+ public:
+  RecordReplay(const HanabiGame* game, int capacity, int num_threads,
+               uint64_t seed);
+  ~RecordReplay();
+  RecordReplay(const RecordReplay&) = delete;
+  RecordReplay& operator=(const RecordReplay&) = delete;
+
+  int EncodingLength() const { return encoder_.EncodingLength(); }
+  // Number of games added so far, including overwritten ones. Game ids are
+  // assigned in order from 0.
+  int64_t AddCount() const;
+  int64_t NumTimesteps() const;
+
+  // Stores the game played so far in state and returns its id. Games
+  // without player moves are not stored and get id -1.
+  int64_t AddGame(const HanabiState& state);
+  int64_t AddRecord(const GameRecord& record);
+
+  // Fills batch with batch_size uniformly sampled timesteps. Returns false
+  // if no timestep is stored.
+  bool Sample(int batch_size, const RecordBatch& batch);
+  // Fills batch with the given timesteps, read from batch.game_ids and
+  // batch.steps. Every game must still be stored.
+  void Encode(int batch_size, const RecordBatch& batch);
+
+ private:
+  // A replayed game, positioned before its next_move-th player move.
+  struct Cursor {
+    int64_t game_id = -1;
+    std::unique_ptr<HanabiState> state;
+    int next_card = 0;
+    int next_move = 0;
+  };
+  struct Request {
+    int64_t game_id;
+    int step;
+    int index;   // Position in the batch.
+    int record;  // Index into the copied records.
+  };
+
+  // Copies the records of the requested timesteps and splits the requests
+  // by game across threads. mutex_ must be held.
+  void CopyRequestsLocked(int batch_size, const RecordBatch& batch,
+                          std::vector<GameRecord>* records,
+                          std::vector<std::vector<Request>>* requests) const;
+  // Encodes the copied requests without holding mutex_, sorting each
+  // thread's requests by game and step.
+  void EncodeCopied(const std::vector<GameRecord>& records,
+                    std::vector<std::vector<Request>>* requests,
+                    const RecordBatch& batch);
+  // Serves the requests of thread from each encoding job until destruction.
+  void WorkerLoop(int thread);
+  void EncodeRequests(const std::vector<Request>& requests,
+                      const std::vector<GameRecord>& records, Cursor* cursor,
+                      const RecordBatch& batch) const;
+  // Applies deals and moves until the state is before player move step.
+  void Advance(const GameRecord& record, int step, Cursor* cursor) const;
+
+  const HanabiGame* game_;
+  CanonicalObservationEncoder encoder_;
+  int capacity_;
+  int num_threads_;
+  std::vector<GameRecord> records_;
+  int64_t add_count_ = 0;
+  SumTree tree_;
+  HanabiRng rng_;
+  // Guards the records, the tree and the random stream.
+  mutable std::mutex mutex_;
+  // Serializes encoding, which owns the cursors.
+  std::mutex encode_mutex_;
+  // One per thread, each used only by the thread serving its games.
+  std::vector<Cursor> cursors_;
+
+  // Current encoding job of the pool, whose thread t serves requests[t]
+  // while the calling thread serves requests[0].
+  struct Job {
+    const std::vector<std::vector<Request>>* requests = nullptr;
+    const std::vector<GameRecord>* records = nullptr;
+    const RecordBatch* batch = nullptr;
+  };
+  std::mutex pool_mutex_;
+  std::condition_variable work_cv_;
+  std::condition_variable done_cv_;
+  Job job_;
+  int64_t num_jobs_ = 0;
+  int num_busy_ = 0;
+  bool stop_ = false;
+  std::vector<std::thread> threads_;
+};
+
+}  // namespace hanabi_learning_env
+
+#endif
@@ -0,0 +1,215 @@
+// Copyright 2018 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include "sequence_replay.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include "util.h"
+
+namespace hanabi_learning_env {
+
+namespace {
+
+// Packs values > 0 into bits, most significant first.
+template <typename T>
+void PackBits(const T* values, int count, uint8_t* bits) {
+  std::memset(bits, 0, (count + 7) / 8);
+  for (int i = 0; i < count; ++i) {
+    bits[i / 8] |= (values[i] > 0) << (7 - i % 8);
+  }
+}
+
+// Copies the first count values of source to out and zeros the rest of
+// out's size values.
+template <typename T>
+void CopyPadded(const std::vector<T>& source, int count, int size, T* out) {
+  std::copy(source.begin(), source.begin() + count, out);
+  std::fill(out + count, out + size, T());
+}
+
+template <typename T>
+void UnpackBits(const uint8_t* bits, int count, T* values) {
+  for (int i = 0; i < count; ++i) {
+    values[i] = (bits[i / 8] >> (7 - i % 8)) & 1;
+  }
+}
+
+}  // namespace
+
+SequenceReplay::SequenceReplay(int num_streams, int observation_size,
+                               int num_actions, int sequence_length,
+                               int overlap, int burn_in, int capacity,
+                               uint64_t seed)
+    : num_streams_(num_streams),
+      observation_size_(observation_size),
+      num_actions_(num_actions),
+      sequence_length_(sequence_length),
+      overlap_(overlap),
+      burn_in_(burn_in),
+      capacity_(capacity),
+      observation_bytes_((observation_size + 7) / 8),
+      legal_mask_bytes_((num_actions + 7) / 8),
+      streams_(num_streams),
+      observations_(static_cast<size_t>(capacity) * sequence_length *
+                    observation_bytes_),
+      legal_masks_(static_cast<size_t>(capacity) * sequence_length *
+                   legal_mask_bytes_),
+      actions_(static_cast<size_t>(capacity) * sequence_length),
+      rewards_(static_cast<size_t>(capacity) * sequence_length),
+      terminals_(static_cast<size_t>(capacity) * sequence_length),
+      lengths_(capacity),
+      tree_(capacity),
+      rng_(seed, 0, 0) {
+  REQUIRE(num_streams > 0 && observation_size > 0 && num_actions > 0);
+  REQUIRE(sequence_length > 0);
+  REQUIRE(overlap >= 0 && overlap < sequence_length);
+  REQUIRE(burn_in >= 0 && burn_in < sequence_length);
+  for (Stream& stream : streams_) {
+    stream.observations.resize(sequence_length * observation_bytes_);
+    stream.legal_masks.resize(sequence_length * legal_mask_bytes_);
+    stream.actions.resize(sequence_length);
+    stream.rewards.resize(sequence_length);
+    stream.terminals.resize(sequence_length);
+  }
+}
+
+int64_t SequenceReplay::AddCount() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return add_count_;
+}
+
+void SequenceReplay::AddSteps(int num_steps, const int* streams,
+                              const float* observations,
+                              const uint8_t* legal_masks, const int* actions,
+                              const float* rewards,
+                              const uint8_t* terminals) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  for (int i = 0; i < num_steps; ++i) {
+    REQUIRE(streams[i] >= 0 && streams[i] < num_streams_);
+    AddStep(&streams_[streams[i]],
+            observations + static_cast<size_t>(i) * observation_size_,
+            legal_masks + static_cast<size_t>(i) * num_actions_, actions[i],
+            rewards[i], terminals[i]);
+  }
+}
+
+void SequenceReplay::AddStep(Stream* stream, const float* observation,
+                             const uint8_t* legal_mask, int action,
+                             float reward, bool terminal) {
+  int step = stream->length;
+  PackBits(observation, observation_size_,
+           &stream->observations[step * observation_bytes_]);
+  PackBits(legal_mask, num_actions_,
+           &stream->legal_masks[step * legal_mask_bytes_]);
+  stream->actions[step] = action;
+  stream->rewards[step] = reward;
+  stream->terminals[step] = terminal;
+  ++stream->length;
+  ++stream->fresh;
+  if (stream->length == sequence_length_) {
+    StoreSequence(*stream);
+    stream->fresh = 0;
+    DropFront(stream, sequence_length_ - overlap_);
+  }
+  if (terminal) {
+    // The rest of the episode is a shorter sequence, unless it was all
+    // stored already or would be all burn-in.
+    if (stream->fresh > 0 && stream->length > burn_in_) {
+      StoreSequence(*stream);
+    }
+    stream->length = 0;
+    stream->fresh = 0;
+  }
+}
+
+void SequenceReplay::DropFront(Stream* stream, int count) {
+  int keep = stream->length - count;
+  std::memmove(stream->observations.data(),
+               stream->observations.data() + count * observation_bytes_,
+               keep * observation_bytes_);
+  std::memmove(stream->legal_masks.data(),
+               stream->legal_masks.data() + count * legal_mask_bytes_,
+               keep * legal_mask_bytes_);
+  std::memmove(stream->actions.data(), stream->actions.data() + count,
+               keep * sizeof(int32_t));
+  std::memmove(stream->rewards.data(), stream->rewards.data() + count,
+               keep * sizeof(float));
+  std::memmove(stream->terminals.data(), stream->terminals.data() + count,
+               keep);
+  stream->length = keep;
+}
+
+void SequenceReplay::StoreSequence(const Stream& stream) {
+  int slot = add_count_ % capacity_;
+  size_t step = static_cast<size_t>(slot) * sequence_length_;
+  CopyPadded(stream.observations, stream.length * observation_bytes_,
+             sequence_length_ * observation_bytes_,
+             &observations_[step * observation_bytes_]);
+  CopyPadded(stream.legal_masks, stream.length * legal_mask_bytes_,
+             sequence_length_ * legal_mask_bytes_,
+             &legal_masks_[step * legal_mask_bytes_]);
+  CopyPadded(stream.actions, stream.length, sequence_length_,
+             &actions_[step]);
+  CopyPadded(stream.rewards, stream.length, sequence_length_,
+             &rewards_[step]);
+  CopyPadded(stream.terminals, stream.length, sequence_length_,
+             &terminals_[step]);
+  lengths_[slot] = stream.length;
+  tree_.Set(slot, tree_.MaxRecordedPriority());
+  ++add_count_;
+}
+
+bool SequenceReplay::Sample(int batch_size, const SequenceBatch& batch) {
+  REQUIRE(batch_size > 0);
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (tree_.Total() <= 0) {
+    return false;
+  }
+  tree_.StratifiedSample(batch_size, &rng_, batch.indices);
+  for (int b = 0; b < batch_size; ++b) {
+    int slot = batch.indices[b];
+    size_t step = static_cast<size_t>(slot) * sequence_length_;
+    size_t out = static_cast<size_t>(b) * sequence_length_;
+    for (int t = 0; t < sequence_length_; ++t) {
+      UnpackBits(&observations_[(step + t) * observation_bytes_],
+                 observation_size_,
+                 batch.observations + (out + t) * observation_size_);
+      UnpackBits(&legal_masks_[(step + t) * legal_mask_bytes_], num_actions_,
+                 batch.legal_masks + (out + t) * num_actions_);
+    }
+    std::copy(actions_.begin() + step,
+              actions_.begin() + step + sequence_length_,
+              batch.actions + out);
+    std::copy(rewards_.begin() + step,
+              rewards_.begin() + step + sequence_length_,
+              batch.rewards + out);
+    std::copy(terminals_.begin() + step,
+              terminals_.begin() + step + sequence_length_,
+              batch.terminals + out);
+    batch.lengths[b] = lengths_[slot];
+    batch.probabilities[b] = tree_.Get(slot) / tree_.Total();
+  }
+  return true;
+}
+
+void SequenceReplay::SetPriorities(int num_indices, const int* indices,
+                                   const float* priorities) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  tree_.SetBatch(num_indices, indices, priorities);
+}
+
+}  // namespace hanabi_learning_env
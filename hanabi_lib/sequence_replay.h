@@ -0,0 +1,128 @@
+// Copyright 2018 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+// Prioritized replay of fixed-length step sequences for recurrent agents,
+// in the style of R2D2 (Kapturowski et al. 2019).
+//
+// Steps arrive per stream, one stream per player of each environment. A
+// stream is cut into sequences of sequence_length steps, consecutive ones
+// sharing overlap steps, and the first burn_in steps of a sequence are only
+// used to warm up the recurrent state. The end of an episode closes the
+// current sequence early, padded with zeros, and drops it if it has no steps
+// past burn_in. Observations and legal move masks are stored one bit per
+// value.
+
+#ifndef __SEQUENCE_REPLAY_H__
+#define __SEQUENCE_REPLAY_H__
+
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+#include "hanabi_rng.h"
+#include "prioritized_replay.h"
+
+namespace hanabi_learning_env {
+
+// Caller-owned output arrays for one sampled batch of sequences. Steps past
+// a sequence's length are zero.
+struct SequenceBatch {
+  float* observations;    // batch x sequence_length x observation_size
+  int32_t* actions;       // batch x sequence_length
+  float* rewards;         // batch x sequence_length
+  uint8_t* terminals;     // batch x sequence_length
+  uint8_t* legal_masks;   // batch x sequence_length x num_actions
+  int32_t* lengths;       // batch, number of valid steps
+  int32_t* indices;       // batch, for SetPriorities
+  float* probabilities;   // batch, sampling probability of each sequence
+};
+
+// All methods may be called concurrently.
+class SequenceReplay {
+ public:
+  SequenceReplay(int num_streams, int observation_size, int num_actions,
+                 int sequence_length, int overlap, int burn_in, int capacity,
+                 uint64_t seed);
+  SequenceReplay(const SequenceReplay&) = delete;
+  SequenceReplay& operator=(const SequenceReplay&) = delete;
+
+  int SequenceLength() const { return sequence_length_; }
+  int Overlap() const { return overlap_; }
+  int BurnIn() const { return burn_in_; }
+  int Capacity() const { return capacity_; }
+  // Number of sequences stored so far, including overwritten ones.
+  int64_t AddCount() const;
+
+  // Appends num_steps steps. Step i belongs to streams[i] and holds the
+  // observation (observation_size values, stored as the bit value > 0), the
+  // legal move mask of that observation (num_actions bytes), the action
+  // taken, the reward that followed and whether it ended the episode.
+  // Completed sequences are stored with the largest priority seen so far,
+  // except episode-closing ones of at most burn_in steps.
+  void AddSteps(int num_steps, const int* streams, const float* observations,
+                const uint8_t* legal_masks, const int* actions,
+                const float* rewards, const uint8_t* terminals);
+
+  // Fills batch with batch_size sequences drawn in proportion to their
+  // priorities. Returns false if nothing is stored yet.
+  bool Sample(int batch_size, const SequenceBatch& batch);
+  void SetPriorities(int num_indices, const int* indices,
+                     const float* priorities);
+
+ private:
+  // Steps of a stream that are not complete sequences yet, packed like the
+  // stored sequences.
+  struct Stream {
+    std::vector<uint8_t> observations;
+    std::vector<uint8_t> legal_masks;
+    std::vector<int32_t> actions;
+    std::vector<float> rewards;
+    std::vector<uint8_t> terminals;
+    int length = 0;
+    // Steps added since the last stored sequence.
+    int fresh = 0;
+  };
+
+  void AddStep(Stream* stream, const float* observation,
+               const uint8_t* legal_mask, int action, float reward,
+               bool terminal);
+  void StoreSequence(const Stream& stream);
+  void DropFront(Stream* stream, int count);
+
+  int num_streams_;
+  int observation_size_;
+  int num_actions_;
+  int sequence_length_;
+  int overlap_;
+  int burn_in_;
+  int capacity_;
+  int observation_bytes_;
+  int legal_mask_bytes_;
+  std::vector<Stream> streams_;
+  std::vector<uint8_t> observations_;
+  std::vector<uint8_t> legal_masks_;
+  std::vector<int32_t> actions_;
+  std::vector<float> rewards_;
+  std::vector<uint8_t> terminals_;
+  std::vector<int32_t> lengths_;
+  int64_t add_count_ = 0;
+  SumTree tree_;
+  HanabiRng rng_;
+  mutable std::mutex mutex_;
+};
+
+}  // namespace hanabi_learning_env
+
+#endif
@@ -0,0 +1,330 @@
+// Copyright 2018 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include "shared_ring.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#if defined(__linux__)
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#endif
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <climits>
+#include <cstring>
+#include <new>
+#include <thread>
+
+#include "util.h"
+
+namespace hanabi_learning_env {
+
+static_assert(ATOMIC_INT_LOCK_FREE == 2 && ATOMIC_LLONG_LOCK_FREE == 2,
+              "ring atomics are shared between processes");
+static_assert(sizeof(std::atomic<uint32_t>) == sizeof(uint32_t),
+              "futex words must be plain 32-bit ints");
+
+// Lives at the start of the mapping. Each counter has its own cache line.
+struct SharedRing::Header {
+  char magic[4];
+  uint32_t version;
+  uint32_t num_slots;
+  uint32_t slot_bytes;
+  char padding0[48];
+  std::atomic<uint64_t> enqueue_position;
+  char padding1[56];
+  std::atomic<uint64_t> dequeue_position;
+  char padding2[56];
+  // Futex words, bumped on every publish and every release.
+  std::atomic<uint32_t> published;
+  std::atomic<uint32_t> consumer_waiting;
+  char padding3[56];
+  std::atomic<uint32_t> released;
+  std::atomic<uint32_t> producers_waiting;
+  char padding4[56];
+};
+
+namespace {
+
+constexpr char kMagic[4] = {'H', 'R', 'N', 'G'};
+constexpr uint32_t kVersion = 1;
+// Upper bound of a single sleep, so that waits without a timeout still
+// recheck their condition now and then.
+constexpr int64_t kMaxSleepUs = 100000;
+
+using Clock = std::chrono::steady_clock;
+
+size_t SequencesBytes(int num_slots) {
+  return (static_cast<size_t>(num_slots) * sizeof(uint64_t) + 63) / 64 * 64;
+}
+
+class Deadline {
+ public:
+  explicit Deadline(int64_t timeout_us)
+      : forever_(timeout_us < 0),
+        end_(Clock::now() +
+             std::chrono::microseconds(std::max<int64_t>(timeout_us, 0))) {}
+
+  // Returns false once the deadline has passed, and otherwise how long to
+  // sleep at most.
+  bool Remaining(int64_t* sleep_us) const {
+    if (forever_) {
+      *sleep_us = kMaxSleepUs;
+      return true;
+    }
+    const int64_t left = std::chrono::duration_cast<std::chrono::microseconds>(
+                             end_ - Clock::now())
+                             .count();
+    *sleep_us = std::min(left, kMaxSleepUs);
+    return left > 0;
+  }
+
+ private:
+  bool forever_;
+  Clock::time_point end_;
+};
+
+// Sleeps while *word == value, for at most sleep_us or until woken.
+void WaitOn(std::atomic<uint32_t>* word, uint32_t value, int64_t sleep_us) {
+#if defined(__linux__)
+  timespec timeout;
+  timeout.tv_sec = sleep_us / 1000000;
+  timeout.tv_nsec = sleep_us % 1000000 * 1000;
+  // Not FUTEX_PRIVATE_FLAG: waiters and wakers are in different processes.
+  syscall(SYS_futex, reinterpret_cast<uint32_t*>(word), FUTEX_WAIT, value,
+          &timeout, nullptr, 0);
+#else
+  if (word->load() == value) {
+    std::this_thread::sleep_for(
+        std::chrono::microseconds(std::min<int64_t>(sleep_us, 50)));
+  }
+#endif
+}
+
+void WakeAll(std::atomic<uint32_t>* word) {
+#if defined(__linux__)
+  syscall(SYS_futex, reinterpret_cast<uint32_t*>(word), FUTEX_WAKE, INT_MAX,
+          nullptr, nullptr, 0);
+#else
+  (void)word;
+#endif
+}
+
+}  // namespace
+
+size_t SharedRing::MappingSize(int num_slots, int slot_bytes) {
+  return sizeof(Header) + SequencesBytes(num_slots) +
+         static_cast<size_t>(num_slots) * slot_bytes;
+}
+
+SharedRing::SharedRing(const std::string& path, int num_slots,
+                       int slot_bytes) {
+  REQUIRE(num_slots > 0 && (num_slots & (num_slots - 1)) == 0);
+  REQUIRE(slot_bytes > 0 && slot_bytes % 8 == 0);
+  // A fresh inode rather than truncating the old file, so processes still
+  // mapping an old ring at path keep their own mapping intact.
+  REQUIRE(unlink(path.c_str()) == 0 || errno == ENOENT);
+  int fd = open(path.c_str(), O_RDWR | O_CREAT | O_EXCL, 0644);
+  REQUIRE(fd >= 0);
+  const size_t size = MappingSize(num_slots, slot_bytes);
+  REQUIRE(ftruncate(fd, size) == 0);
+  Map(fd, size);
+  header_ = new (mapping_) Header();
+  header_->version = kVersion;
+  header_->num_slots = num_slots;
+  header_->slot_bytes = slot_bytes;
+  SetLayout(num_slots, slot_bytes);
+  // Slot i is free for the producer at position i.
+  for (int i = 0; i < num_slots; ++i) {
+    new (&sequences_[i]) std::atomic<uint64_t>(i);
+  }
+  // The magic goes last, so a process that sees it sees a complete ring.
+  std::atomic_thread_fence(std::memory_order_release);
+  std::memcpy(header_->magic, kMagic, 4);
+}
+
+SharedRing::SharedRing(const std::string& path) {
+  int fd = open(path.c_str(), O_RDWR);
+  REQUIRE(fd >= 0);
+  struct stat st;
+  REQUIRE(fstat(fd, &st) == 0);
+  REQUIRE(st.st_size >= static_cast<off_t>(sizeof(Header)));
+  Map(fd, st.st_size);
+  header_ = reinterpret_cast<Header*>(mapping_);
+  REQUIRE(std::memcmp(header_->magic, kMagic, 4) == 0);
+  std::atomic_thread_fence(std::memory_order_acquire);
+  REQUIRE(header_->version == kVersion);
+  REQUIRE(size_ == MappingSize(header_->num_slots, header_->slot_bytes));
+  SetLayout(header_->num_slots, header_->slot_bytes);
+}
+
+SharedRing::~SharedRing() { munmap(mapping_, size_); }
+
+void SharedRing::Map(int fd, size_t size) {
+  void* mapping =
+      mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close(fd);
+  REQUIRE(mapping != MAP_FAILED);
+  mapping_ = static_cast<uint8_t*>(mapping);
+  size_ = size;
+}
+
+void SharedRing::SetLayout(int num_slots, int slot_bytes) {
+  num_slots_ = num_slots;
+  slot_bytes_ = slot_bytes;
+  sequences_ =
+      reinterpret_cast<std::atomic<uint64_t>*>(mapping_ + sizeof(Header));
+  data_ = mapping_ + sizeof(Header) + SequencesBytes(num_slots);
+}
+
+std::atomic<uint64_t>& SharedRing::Sequence(uint64_t position) const {
+  return sequences_[position & (num_slots_ - 1)];
+}
+
+uint8_t* SharedRing::Reserve(int64_t timeout_us, uint64_t* ticket) {
+  REQUIRE(ticket != nullptr);
+  Deadline deadline(timeout_us);
+  uint64_t position =
+      header_->enqueue_position.load(std::memory_order_relaxed);
+  while (true) {
+    const uint64_t sequence =
+        Sequence(position).load(std::memory_order_acquire);
+    const int64_t lag = static_cast<int64_t>(sequence - position);
+    if (lag == 0) {
+      if (header_->enqueue_position.compare_exchange_weak(
+              position, position + 1, std::memory_order_relaxed)) {
+        *ticket = position;
+        return data_ + (position & (num_slots_ - 1)) * slot_bytes_;
+      }
+    } else if (lag < 0) {
+      // The slot still holds the item from one lap ago: the ring is full.
+      int64_t sleep_us;
+      if (!deadline.Remaining(&sleep_us)) {
+        return nullptr;
+      }
+      const uint32_t released = header_->released.load();
+      header_->producers_waiting.fetch_add(1);
+      if (Sequence(position).load() == sequence) {
+        WaitOn(&header_->released, released, sleep_us);
+      }
+      header_->producers_waiting.fetch_sub(1);
+      position = header_->enqueue_position.load(std::memory_order_relaxed);
+    } else {
+      // Another producer took this position.
+      position = header_->enqueue_position.load(std::memory_order_relaxed);
+    }
+  }
+}
+
+void SharedRing::Publish(uint64_t ticket) {
+  Sequence(ticket).store(ticket + 1, std::memory_order_release);
+  header_->published.fetch_add(1);
+  if (header_->consumer_waiting.load() != 0) {
+    WakeAll(&header_->published);
+  }
+}
+
+bool SharedRing::Push(const void* data, int size, int64_t timeout_us) {
+  REQUIRE(size >= 0 && size <= slot_bytes_);
+  uint64_t ticket;
+  uint8_t* slot = Reserve(timeout_us, &ticket);
+  if (slot == nullptr) {
+    return false;
+  }
+  std::memcpy(slot, data, size);
+  Publish(ticket);
+  return true;
+}
+
+int SharedRing::Peek(int max_slots, int64_t timeout_us,
+                     const uint8_t** slots) {
+  REQUIRE(max_slots > 0);
+  REQUIRE(slots != nullptr);
+  const uint64_t position =
+      header_->dequeue_position.load(std::memory_order_relaxed);
+  Deadline deadline(timeout_us);
+  while (Sequence(position).load(std::memory_order_acquire) != position + 1) {
+    int64_t sleep_us;
+    if (!deadline.Remaining(&sleep_us)) {
+      header_->consumer_waiting.store(0);
+      return 0;
+    }
+    const uint32_t published = header_->published.load();
+    header_->consumer_waiting.store(1);
+    if (Sequence(position).load() != position + 1) {
+      WaitOn(&header_->published, published, sleep_us);
+    }
+  }
+  header_->consumer_waiting.store(0, std::memory_order_relaxed);
+  const uint64_t first = position & (num_slots_ - 1);
+  const uint64_t end =
+      position + std::min<uint64_t>(max_slots, num_slots_ - first);
+  uint64_t next = position + 1;
+  while (next < end &&
+         Sequence(next).load(std::memory_order_acquire) == next + 1) {
+    ++next;
+  }
+  *slots = data_ + first * slot_bytes_;
+  return next - position;
+}
+
+void SharedRing::Release(int num_slots) {
+  REQUIRE(num_slots >= 0 && num_slots <= num_slots_);
+  const uint64_t position =
+      header_->dequeue_position.load(std::memory_order_relaxed);
+  for (uint64_t i = position; i < position + num_slots; ++i) {
+    REQUIRE(Sequence(i).load(std::memory_order_relaxed) == i + 1);
+    Sequence(i).store(i + num_slots_, std::memory_order_release);
+  }
+  header_->dequeue_position.store(position + num_slots,
+                                  std::memory_order_relaxed);
+  header_->released.fetch_add(1);
+  if (header_->producers_waiting.load() != 0) {
+    WakeAll(&header_->released);
+  }
+}
+
+int TransitionSlotBytes(int observation_bytes, int legal_action_bytes) {
+  REQUIRE(observation_bytes >= 0 && legal_action_bytes >= 0);
+  return (sizeof(TransitionHeader) + observation_bytes + legal_action_bytes +
+          7) / 8 * 8;
+}
+
+bool PushTransition(SharedRing* ring, const TransitionHeader& header,
+                    const uint8_t* observation, int observation_bytes,
+                    const uint8_t* legal_actions, int legal_action_bytes,
+                    int64_t timeout_us) {
+  REQUIRE(ring != nullptr);
+  REQUIRE(TransitionSlotBytes(observation_bytes, legal_action_bytes) <=
+          ring->SlotBytes());
+  uint64_t ticket;
+  uint8_t* slot = ring->Reserve(timeout_us, &ticket);
+  if (slot == nullptr) {
+    return false;
+  }
+  std::memcpy(slot, &header, sizeof(header));
+  slot += sizeof(header);
+  std::memcpy(slot, observation, observation_bytes);
+  std::memcpy(slot + observation_bytes, legal_actions, legal_action_bytes);
+  ring->Publish(ticket);
+  return true;
+}
+
+}  // namespace hanabi_learning_env
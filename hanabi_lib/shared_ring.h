@@ -0,0 +1,112 @@
+// Copyright 2018 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+// Ring buffer in a shared file mapping, for sending trajectories from actor
+// processes to a learner process on the same host.
+//
+// The ring holds num_slots fixed-size slots. Any number of producers, in any
+// number of processes, reserve a slot, write it in place and publish it; a
+// single consumer reads published slots in place and releases them. Slot
+// ownership follows Vyukov's bounded queue, with one sequence number per
+// slot, so neither side takes a lock. Waiting for a free or a published slot
+// sleeps on a futex in the mapping, on Linux, and polls elsewhere.
+//
+// Slot data is contiguous, so a run of published slots is one
+// n x SlotBytes() array the learner can wrap without copying. A producer
+// that dies between Reserve() and Publish() stalls the consumer at its slot.
+
+#ifndef __SHARED_RING_H__
+#define __SHARED_RING_H__
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace hanabi_learning_env {
+
+class SharedRing {
+ public:
+  // Creates the ring file at path, replacing any existing file by a new one,
+  // so rings already mapped from the old file are unaffected. num_slots must
+  // be a power of two and slot_bytes a multiple of 8.
+  SharedRing(const std::string& path, int num_slots, int slot_bytes);
+  // Maps a ring created by another SharedRing.
+  explicit SharedRing(const std::string& path);
+  ~SharedRing();
+  SharedRing(const SharedRing&) = delete;
+  SharedRing& operator=(const SharedRing&) = delete;
+
+  int NumSlots() const { return num_slots_; }
+  int SlotBytes() const { return slot_bytes_; }
+
+  // Producer side. Reserves the next slot, waiting up to timeout_us (forever
+  // if negative) while the ring is full, and returns its data, or nullptr on
+  // timeout. The slot reaches the consumer once Publish(*ticket) is called.
+  uint8_t* Reserve(int64_t timeout_us, uint64_t* ticket);
+  void Publish(uint64_t ticket);
+  // Copies size bytes into a new slot and publishes it. Returns false on
+  // timeout.
+  bool Push(const void* data, int size, int64_t timeout_us);
+
+  // Consumer side, for a single consumer. Waits up to timeout_us for the
+  // next slot to be published, then points *slots at it and returns the
+  // number of consecutive published slots, at most max_slots and never
+  // wrapping around the end of the ring. Returns 0 on timeout. The slots
+  // stay valid until released.
+  int Peek(int max_slots, int64_t timeout_us, const uint8_t** slots);
+  // Releases the oldest num_slots peeked slots to the producers.
+  void Release(int num_slots);
+
+ private:
+  struct Header;
+
+  static size_t MappingSize(int num_slots, int slot_bytes);
+  // Maps size bytes of fd and closes it.
+  void Map(int fd, size_t size);
+  void SetLayout(int num_slots, int slot_bytes);
+  std::atomic<uint64_t>& Sequence(uint64_t position) const;
+
+  uint8_t* mapping_ = nullptr;
+  size_t size_ = 0;
+  Header* header_ = nullptr;
+  std::atomic<uint64_t>* sequences_ = nullptr;
+  uint8_t* data_ = nullptr;
+  int num_slots_ = 0;
+  int slot_bytes_ = 0;
+};
+
+// Slot layout for transitions in PrioritizedReplayMemory's packed format: a
+// TransitionHeader, the bit-packed observation and the bit-packed legal
+// action mask. stream tells apart the trajectories of different actors.
+struct TransitionHeader {
+  int32_t stream;
+  int32_t action;
+  float reward;
+  int32_t terminal;
+};
+
+// Slot size for transitions, rounded up to a multiple of 8.
+int TransitionSlotBytes(int observation_bytes, int legal_action_bytes);
+
+// Writes one transition into a new slot of ring. Returns false on timeout.
+bool PushTransition(SharedRing* ring, const TransitionHeader& header,
+                    const uint8_t* observation, int observation_bytes,
+                    const uint8_t* legal_actions, int legal_action_bytes,
+                    int64_t timeout_us);
+
+}  // namespace hanabi_learning_env
+
+#endif
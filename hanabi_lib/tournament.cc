@@ -0,0 +1,292 @@
+// Copyright 2018 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include "tournament.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <memory>
+#include <random>
+#include <thread>
+
+#include "hanabi_observation.h"
+#include "hanabi_policy.h"
+#include "hanabi_state.h"
+#include "util.h"
+
+namespace hanabi_learning_env {
+
+namespace {
+
+// Shared by the tournament threads. Job j plays deck j % decks.size() with
+// lineup j / decks.size().
+struct TournamentContext {
+  const HanabiGame* game;
+  const std::vector<TournamentEntrant>* entrants;
+  const std::vector<TournamentDeck>* decks;
+  const TournamentOptions* options;
+  TournamentResult* result;
+  int64_t num_jobs;
+  std::atomic<int64_t> next_job{0};
+  // First batched entrant that left a move unanswered, or -1.
+  std::atomic<int> failed_entrant{-1};
+};
+
+struct Table {
+  std::unique_ptr<HanabiState> state;
+  int64_t job = -1;
+  int next_card = 0;
+  HanabiRng rng;
+};
+
+class TournamentThread {
+ public:
+  explicit TournamentThread(TournamentContext* context)
+      : context_(context),
+        game_(context->game),
+        decks_(*context->decks),
+        result_(context->result) {
+    const auto& entrants = *context_->entrants;
+    for (const TournamentEntrant& entrant : entrants) {
+      if (entrant.make_batch_policy) {
+        policies_.push_back(nullptr);
+        batch_policies_.push_back(entrant.make_batch_policy());
+        REQUIRE(batch_policies_.back());
+      } else {
+        policies_.push_back(MakePolicy(entrant.policy));
+        batch_policies_.push_back(BatchPolicy());
+      }
+    }
+    pending_.resize(entrants.size());
+  }
+
+  void Run() {
+    std::vector<Table> tables(context_->options->games_per_thread);
+    int num_tables = 0;
+    while (num_tables < tables.size() && StartJob(&tables[num_tables])) {
+      ++num_tables;
+    }
+    tables.resize(num_tables);
+    std::vector<MoveRequest> requests;
+    std::vector<int> moves;
+    while (!tables.empty() && context_->failed_entrant.load() < 0) {
+      for (auto& pending : pending_) {
+        pending.clear();
+      }
+      for (int i = 0; i < tables.size(); ++i) {
+        Table& table = tables[i];
+        const int player = table.state->CurPlayer();
+        const int entrant = Lineup(table)[player];
+        if (policies_[entrant] != nullptr) {
+          Apply(policies_[entrant]->Act(
+                    HanabiObservation(*table.state, player), &table.rng),
+                &table);
+        } else {
+          pending_[entrant].push_back(i);
+        }
+      }
+      for (int entrant = 0; entrant < pending_.size(); ++entrant) {
+        const std::vector<int>& pending = pending_[entrant];
+        if (pending.empty()) {
+          continue;
+        }
+        requests.clear();
+        for (int i : pending) {
+          MoveRequest request;
+          request.state = tables[i].state.get();
+          request.player = request.state->CurPlayer();
+          requests.push_back(request);
+        }
+        moves.assign(pending.size(), -1);
+        batch_policies_[entrant](requests, &moves);
+        if (std::find(moves.begin(), moves.end(), -1) != moves.end()) {
+          int none = -1;
+          context_->failed_entrant.compare_exchange_strong(none, entrant);
+          return;
+        }
+        for (int k = 0; k < pending.size(); ++k) {
+          REQUIRE(moves[k] >= 0 && moves[k] < game_->MaxMoves());
+          Apply(game_->GetMove(moves[k]), &tables[pending[k]]);
+        }
+      }
+      // Record finished games and replace them with new jobs.
+      for (int i = 0; i < tables.size();) {
+        Table& table = tables[i];
+        if (table.state->IsTerminal()) {
+          result_->scores[table.job / decks_.size()]
+                         [table.job % decks_.size()] = table.state->Score();
+          if (!StartJob(&table)) {
+            std::swap(table, tables.back());
+            tables.pop_back();
+            continue;
+          }
+        }
+        ++i;
+      }
+    }
+  }
+
+ private:
+  const std::vector<int>& Lineup(const Table& table) const {
+    return result_->lineups[table.job / decks_.size()];
+  }
+
+  bool StartJob(Table* table) {
+    const int64_t job = context_->next_job.fetch_add(1);
+    if (job >= context_->num_jobs) {
+      return false;
+    }
+    const TournamentDeck& deck = decks_[job % decks_.size()];
+    table->job = job;
+    table->state.reset(new HanabiState(game_, HanabiRng(), deck.start_player));
+    table->next_card = 0;
+    table->rng = HanabiRng(context_->options->seed, 1, job % decks_.size());
+    Deal(table);
+    return true;
+  }
+
+  void Apply(HanabiMove move, Table* table) {
+    REQUIRE(table->state->MoveIsLegal(move));
+    table->state->ApplyMove(move);
+    Deal(table);
+  }
+
+  // Deals from the table's deck until a player is to act.
+  void Deal(Table* table) {
+    const TournamentDeck& deck = decks_[table->job % decks_.size()];
+    HanabiState* state = table->state.get();
+    while (!state->IsTerminal() && state->CurPlayer() == kChancePlayerId) {
+      REQUIRE(table->next_card < deck.cards.size());
+      const int index = deck.cards[table->next_card++];
+      state->ApplyMove(HanabiMove(HanabiMove::kDeal, -1, -1,
+                                  index / game_->NumRanks(),
+                                  index % game_->NumRanks()));
+    }
+  }
+
+  TournamentContext* context_;
+  const HanabiGame* game_;
+  const std::vector<TournamentDeck>& decks_;
+  TournamentResult* result_;
+  // Built-in policy of each entrant, null for batched entrants.
+  std::vector<std::unique_ptr<HanabiPolicy>> policies_;
+  // This thread's batched policy of each batched entrant.
+  std::vector<BatchPolicy> batch_policies_;
+  // Tables waiting for each batched entrant.
+  std::vector<std::vector<int>> pending_;
+};
+
+}  // namespace
+
+std::vector<TournamentDeck> MakeDecks(const HanabiGame* game, int num_decks,
+                                      uint64_t seed) {
+  REQUIRE(game != nullptr);
+  REQUIRE(num_decks >= 0);
+  std::vector<uint8_t> cards;
+  for (int color = 0; color < game->NumColors(); ++color) {
+    for (int rank = 0; rank < game->NumRanks(); ++rank) {
+      cards.insert(cards.end(), game->NumberCardInstances(color, rank),
+                   color * game->NumRanks() + rank);
+    }
+  }
+  std::vector<TournamentDeck> decks(num_decks);
+  for (int d = 0; d < num_decks; ++d) {
+    HanabiRng rng(seed, 0, d);
+    decks[d].start_player = game->GetSampledStartPlayer(&rng);
+    decks[d].cards = cards;
+    // Fisher-Yates, so decks do not depend on the std::shuffle in use.
+    for (int i = cards.size() - 1; i > 0; --i) {
+      std::uniform_int_distribution<int> dist(0, i);
+      std::swap(decks[d].cards[i], decks[d].cards[dist(rng)]);
+    }
+  }
+  return decks;
+}
+
+double TournamentResult::Mean(int lineup) const {
+  const std::vector<int>& values = scores[lineup];
+  double sum = 0;
+  for (int score : values) {
+    sum += score;
+  }
+  return values.empty() ? 0 : sum / values.size();
+}
+
+double TournamentResult::StdErr(int lineup) const {
+  const std::vector<int>& values = scores[lineup];
+  if (values.size() < 2) {
+    return 0;
+  }
+  const double mean = Mean(lineup);
+  double sum_squares = 0;
+  for (int score : values) {
+    sum_squares += (score - mean) * (score - mean);
+  }
+  return std::sqrt(sum_squares / (values.size() - 1) / values.size());
+}
+
+TournamentResult RunTournament(const HanabiGame* game,
+                               const std::vector<TournamentEntrant>& entrants,
+                               const std::vector<TournamentDeck>& decks,
+                               const TournamentOptions& options) {
+  REQUIRE(game != nullptr);
+  REQUIRE(!entrants.empty());
+  REQUIRE(options.num_threads > 0 && options.games_per_thread > 0);
+  for (const TournamentEntrant& entrant : entrants) {
+    REQUIRE(entrant.make_batch_policy ||
+            MakePolicy(entrant.policy) != nullptr);
+  }
+  TournamentResult result;
+  const int num_players = game->NumPlayers();
+  std::vector<int> lineup(num_players, 0);
+  while (true) {
+    result.lineups.push_back(lineup);
+    int seat = num_players - 1;
+    while (seat >= 0 && ++lineup[seat] == entrants.size()) {
+      lineup[seat--] = 0;
+    }
+    if (seat < 0) {
+      break;
+    }
+  }
+  result.scores.assign(result.lineups.size(),
+                       std::vector<int>(decks.size(), 0));
+
+  TournamentContext context;
+  context.game = game;
+  context.entrants = &entrants;
+  context.decks = &decks;
+  context.options = &options;
+  context.result = &result;
+  context.num_jobs = static_cast<int64_t>(result.lineups.size()) *
+                     decks.size();
+  auto run = [&context]() { TournamentThread(&context).Run(); };
+  if (options.num_threads == 1) {
+    run();
+  } else {
+    std::vector<std::thread> threads;
+    for (int i = 0; i < options.num_threads; ++i) {
+      threads.emplace_back(run);
+    }
+    for (auto& thread : threads) {
+      thread.join();
+    }
+  }
+  result.failed_entrant = context.failed_entrant.load();
+  return result;
+}
+
+}  // namespace hanabi_learning_env
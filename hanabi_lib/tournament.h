@@ -0,0 +1,90 @@
+// Copyright 2018 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+// Cross-play tournaments over common decks.
+//
+// Every lineup, i.e. assignment of entrants to seats with repetition, plays
+// the same pre-shuffled decks. Deals are then identical across lineups, so
+// score differences between lineups carry no deal luck (common random
+// numbers), and per-deck scores allow paired comparisons.
+//
+// Games are spread over threads. Each thread keeps several games running
+// and collects the requests of each batched entrant across them, so one
+// callback call serves many games.
+
+#ifndef __TOURNAMENT_H__
+#define __TOURNAMENT_H__
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "game_task.h"
+#include "hanabi_game.h"
+
+namespace hanabi_learning_env {
+
+struct TournamentDeck {
+  int start_player = 0;
+  // All cards in deal order, as color * num_ranks + rank.
+  std::vector<uint8_t> cards;
+};
+
+// Deck d is shuffled with HanabiRng(seed, 0, d).
+std::vector<TournamentDeck> MakeDecks(const HanabiGame* game, int num_decks,
+                                      uint64_t seed);
+
+struct TournamentEntrant {
+  std::string name;
+  // Built-in policy (see MakePolicy), used if make_batch_policy is empty.
+  std::string policy;
+  // Called once by every tournament thread, which then is the only caller of
+  // the returned policy. Factories may thus return policies that are not
+  // thread-safe, such as EncodedBatchPolicy or NativeBatchPolicy.
+  std::function<BatchPolicy()> make_batch_policy;
+};
+
+struct TournamentOptions {
+  int num_threads = 1;
+  // Games each thread keeps running, i.e. the largest batch it can gather.
+  int games_per_thread = 64;
+  // Built-in policies playing deck d draw from HanabiRng(seed, 1, d).
+  uint64_t seed = 0;
+};
+
+struct TournamentResult {
+  // lineups[l][seat] is the entrant in seat, in lexicographic order.
+  std::vector<std::vector<int>> lineups;
+  // scores[l][d] is the score of lineup l on deck d.
+  std::vector<std::vector<int>> scores;
+  // Batched entrant that answered a request with move -1, which stops the
+  // tournament and leaves the remaining scores 0, or -1 if none did.
+  int failed_entrant = -1;
+
+  double Mean(int lineup) const;
+  // Standard error of Mean(lineup).
+  double StdErr(int lineup) const;
+};
+
+// Plays all NumPlayers()-seat lineups of entrants on every deck.
+TournamentResult RunTournament(const HanabiGame* game,
+                               const std::vector<TournamentEntrant>& entrants,
+                               const std::vector<TournamentDeck>& decks,
+                               const TournamentOptions& options);
+
+}  // namespace hanabi_learning_env
+
+#endif
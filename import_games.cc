@@ -0,0 +1,159 @@
+// Copyright 2018 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+// Imports hanab.live JSON game logs (see hanabi_lib/hanab_live_importer.h)
+// into a step dataset, and optionally a game-record file.
+//
+//   import_games --out_dir=data --records=human.hrec
+//       --config.hanabi.players=2 games_0.json games_1.json ...
+//
+// Files are parsed in parallel. Games keep the order of the files on the
+// command line, so the output does not depend on the number of threads.
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <iostream>
+#include <iterator>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "dataset_writer.h"
+#include "game_record.h"
+#include "hanab_live_importer.h"
+#include "hanabi_game.h"
+
+constexpr const char* kGameParamArgPrefix = "--config.hanabi.";
+
+struct ImportOptions {
+  std::vector<std::string> inputs;
+  std::string out_dir;
+  std::string records;
+  int games_per_shard = 10000;
+  int num_threads = std::max(1u, std::thread::hardware_concurrency());
+};
+
+void ImportGames(
+    const std::unordered_map<std::string, std::string>& game_params,
+    const ImportOptions& options) {
+  hanabi_learning_env::HanabiGame game(game_params);
+  hanabi_learning_env::HanabLiveImporter importer(&game);
+
+  std::vector<std::vector<hanabi_learning_env::GameRecord>> file_games(
+      options.inputs.size());
+  std::vector<hanabi_learning_env::HanabLiveImportStats> file_stats(
+      options.inputs.size());
+  std::atomic<int> next_file(0);
+  std::vector<std::thread> threads;
+  for (int t = 0; t < std::min<int>(options.num_threads,
+                                    options.inputs.size());
+       ++t) {
+    threads.emplace_back([&] {
+      for (int i = next_file++; i < options.inputs.size(); i = next_file++) {
+        file_stats[i] = importer.ImportFile(
+            options.inputs[i],
+            [&file_games, i](hanabi_learning_env::GameRecord&& record) {
+              file_games[i].push_back(std::move(record));
+            });
+      }
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+
+  std::vector<hanabi_learning_env::GameRecord> games;
+  int64_t num_skipped = 0;
+  for (int i = 0; i < options.inputs.size(); ++i) {
+    if (!file_stats[i].error.empty()) {
+      std::cerr << options.inputs[i] << ": " << file_stats[i].error << "\n";
+    }
+    num_skipped += file_stats[i].num_skipped;
+    std::move(file_games[i].begin(), file_games[i].end(),
+              std::back_inserter(games));
+    file_games[i].clear();
+  }
+  std::cout << "Imported " << games.size() << " games, skipped "
+            << num_skipped << "\n";
+
+  if (!options.records.empty()) {
+    hanabi_learning_env::GameRecordWriter writer(options.records);
+    for (const auto& record : games) {
+      writer.Append(record);
+    }
+  }
+  if (!options.out_dir.empty()) {
+    auto shards = hanabi_learning_env::WriteDataset(
+        game, options.out_dir, games.size(), options.games_per_shard,
+        options.num_threads,
+        [&games](int64_t episode) { return games[episode]; });
+    int64_t num_steps = 0;
+    for (const auto& shard : shards) {
+      num_steps += shard.num_steps;
+    }
+    std::cout << "Wrote " << num_steps << " steps in " << shards.size()
+              << " shards to " << options.out_dir << "\n";
+  }
+}
+
+void ParseArguments(int argc, char** argv,
+                    std::unordered_map<std::string, std::string>* game_params,
+                    ImportOptions* options) {
+  const auto prefix_len = strlen(kGameParamArgPrefix);
+  for (int i = 1; i < argc; ++i) {
+    std::string param = argv[i];
+    if (param.compare(0, 2, "--") != 0) {
+      options->inputs.push_back(param);
+      continue;
+    }
+    std::string value;
+    auto value_pos = param.find("=");
+    if (value_pos != std::string::npos) {
+      value = param.substr(value_pos + 1, std::string::npos);
+      param = param.substr(0, value_pos);
+    }
+    if (param.compare(0, prefix_len, kGameParamArgPrefix) == 0 &&
+        param.size() > prefix_len) {
+      (*game_params)[param.substr(prefix_len, std::string::npos)] = value;
+    } else if (param == "--out_dir") {
+      options->out_dir = value;
+    } else if (param == "--records") {
+      options->records = value;
+    } else if (param == "--games_per_shard") {
+      options->games_per_shard = std::stoi(value);
+    } else if (param == "--num_threads") {
+      options->num_threads = std::stoi(value);
+    } else {
+      std::cerr << "Unknown argument " << argv[i] << "\n";
+      std::exit(1);
+    }
+  }
+}
+
+int main(int argc, char** argv) {
+  std::unordered_map<std::string, std::string> game_params;
+  ImportOptions options;
+  ParseArguments(argc, argv, &game_params, &options);
+  if (options.inputs.empty() ||
+      (options.out_dir.empty() && options.records.empty())) {
+    std::cerr << "Usage: import_games [--out_dir=DIR] [--records=FILE] "
+                 "[--config.hanabi.KEY=VALUE ...] FILE.json ...\n";
+    return 1;
+  }
+  ImportGames(game_params, options);
+  return 0;
+}
@@ -14,21 +14,34 @@
 
 #include "pyhanabi.h"
 
+#include <algorithm>
 #include <cstdlib>
 #include <cstring>
 #include <iostream>
 #include <memory>
+#include <sstream>
 #include <string>
 #include <unordered_map>
+#include <vector>
 
+#include "hanabi_lib/actor_pipeline.h"
 #include "hanabi_lib/canonical_encoders.h"
+#include "hanabi_lib/game_record.h"
 #include "hanabi_lib/hanabi_card.h"
 #include "hanabi_lib/hanabi_game.h"
 #include "hanabi_lib/hanabi_history_item.h"
 #include "hanabi_lib/hanabi_move.h"
 #include "hanabi_lib/hanabi_observation.h"
+#include "hanabi_lib/hanabi_policy.h"
 #include "hanabi_lib/hanabi_state.h"
+#include "hanabi_lib/instrumentation.h"
 #include "hanabi_lib/observation_encoder.h"
+#include "hanabi_lib/observation_stacker.h"
+#include "hanabi_lib/prioritized_replay.h"
+#include "hanabi_lib/record_replay.h"
+#include "hanabi_lib/sequence_replay.h"
+#include "hanabi_lib/shared_ring.h"
+#include "hanabi_lib/tournament.h"
 #include "hanabi_lib/util.h"
 
 extern "C" {
@@ -296,6 +309,17 @@ void NewState(pyhanabi_game_t* game, pyhanabi_state_t* state) {
       static_cast<hanabi_learning_env::HanabiGame*>(game->game));
 }
 
+void NewStateFromStream(pyhanabi_game_t* game, unsigned long long seed,
+                        unsigned int env_id, unsigned long long episode_id,
+                        pyhanabi_state_t* state) {
+  REQUIRE(state != nullptr);
+  REQUIRE(game != nullptr);
+  REQUIRE(game->game != nullptr);
+  state->state = new hanabi_learning_env::HanabiState(
+      static_cast<hanabi_learning_env::HanabiGame*>(game->game),
+      hanabi_learning_env::HanabiRng(seed, env_id, episode_id));
+}
+
 void CopyState(const pyhanabi_state_t* src, pyhanabi_state_t* dest) {
   REQUIRE(src != nullptr);
   REQUIRE(src->state != nullptr);
@@ -842,21 +866,950 @@ char* EncodeObservation(pyhanabi_observation_encoder_t* encoder,
   REQUIRE(encoder->encoder != nullptr);
   REQUIRE(observation != nullptr);
   REQUIRE(observation->observation != nullptr);
-  return nullptr;
-  // auto obs_enc = reinterpret_cast<hanabi_learning_env::ObservationEncoder*>(
-  //     encoder->encoder);
-  // auto obs = reinterpret_cast<hanabi_learning_env::HanabiObservation*>(
-  //     observation->observation);
-  // // TODO: this is changed to float, making str repr not accurate
-  // std::vector<float> encoding = obs_enc->Encode(*obs);
-  // std::string obs_str = "";
-  // for (int i = 0; i < encoding.size(); i++) {
-  //   obs_str += (encoding[i] ? "1" : "0");
-  //   if (i != encoding.size() - 1) {
-  //     obs_str += ",";
-  //   }
-  // }
-  // return strdup(obs_str.c_str());
+  std::vector<float> encoding(ObservationEncodingLength(encoder));
+  EncodeObservationsInto(encoder, observation, 1, false, nullptr, nullptr,
+                         false, encoding.data(), nullptr);
+  std::ostringstream obs_str;
+  for (int i = 0; i < encoding.size(); i++) {
+    obs_str << (i == 0 ? "" : ",") << encoding[i];
+  }
+  return strdup(obs_str.str().c_str());
+}
+
+static const hanabi_learning_env::CanonicalObservationEncoder*
+CanonicalEncoder(pyhanabi_observation_encoder_t* encoder) {
+  REQUIRE(encoder != nullptr);
+  REQUIRE(encoder->encoder != nullptr);
+  auto obs_enc = reinterpret_cast<hanabi_learning_env::ObservationEncoder*>(
+      encoder->encoder);
+  REQUIRE(obs_enc->type() ==
+          hanabi_learning_env::ObservationEncoder::Type::kCanonical);
+  return static_cast<hanabi_learning_env::CanonicalObservationEncoder*>(
+      obs_enc);
+}
+
+int ObservationEncodingLength(pyhanabi_observation_encoder_t* encoder) {
+  return CanonicalEncoder(encoder)->EncodingLength();
+}
+
+// Loads the permutations of the index-th observation of a batch.
+static void LoadPermutations(const hanabi_learning_env::HanabiGame& game,
+                             int index, const int* orders,
+                             const int* color_permutes,
+                             std::vector<int>* order,
+                             std::vector<int>* color_permute,
+                             std::vector<int>* inv_color_permute) {
+  if (orders != nullptr) {
+    const int* begin = orders + index * game.HandSize();
+    order->assign(begin, begin + game.HandSize());
+  }
+  if (color_permutes != nullptr) {
+    const int* begin = color_permutes + index * game.NumColors();
+    color_permute->assign(begin, begin + game.NumColors());
+    inv_color_permute->resize(game.NumColors());
+    for (int c = 0; c < game.NumColors(); ++c) {
+      REQUIRE((*color_permute)[c] >= 0 &&
+              (*color_permute)[c] < game.NumColors());
+      (*inv_color_permute)[(*color_permute)[c]] = c;
+    }
+  }
+}
+
+void EncodeObservationsInto(pyhanabi_observation_encoder_t* encoder,
+                            pyhanabi_observation_t* observations,
+                            int num_observations, int show_own_cards,
+                            const int* orders, const int* color_permutes,
+                            int hide_action, float* out,
+                            unsigned char* legal_masks) {
+  auto obs_enc = CanonicalEncoder(encoder);
+  REQUIRE(observations != nullptr || num_observations == 0);
+  REQUIRE(out != nullptr || num_observations == 0);
+  const int length = obs_enc->EncodingLength();
+  std::vector<int> order;
+  std::vector<int> color_permute;
+  std::vector<int> inv_color_permute;
+  for (int i = 0; i < num_observations; ++i) {
+    REQUIRE(observations[i].observation != nullptr);
+    auto obs = reinterpret_cast<hanabi_learning_env::HanabiObservation*>(
+        observations[i].observation);
+    LoadPermutations(*obs->ParentGame(), i, orders, color_permutes, &order,
+                     &color_permute, &inv_color_permute);
+    obs_enc->EncodeInto(*obs, show_own_cards, order, color_permutes != nullptr,
+                        color_permute, inv_color_permute, hide_action,
+                        out + i * length);
+    if (legal_masks != nullptr) {
+      const int max_moves = obs->ParentGame()->MaxMoves();
+      obs_enc->EncodeLegalMoves(*obs, legal_masks + i * max_moves);
+    }
+  }
+}
+
+void EncodeObservationsPacked(pyhanabi_observation_encoder_t* encoder,
+                              pyhanabi_observation_t* observations,
+                              int num_observations, int show_own_cards,
+                              const int* orders, const int* color_permutes,
+                              int hide_action, unsigned char* out,
+                              unsigned char* legal_masks) {
+  auto obs_enc = CanonicalEncoder(encoder);
+  REQUIRE(observations != nullptr || num_observations == 0);
+  REQUIRE(out != nullptr || num_observations == 0);
+  const int length = obs_enc->EncodingLength();
+  const int row_bytes = (length + 7) / 8;
+  std::vector<float> encoding(length);
+  std::vector<int> order;
+  std::vector<int> color_permute;
+  std::vector<int> inv_color_permute;
+  for (int i = 0; i < num_observations; ++i) {
+    REQUIRE(observations[i].observation != nullptr);
+    auto obs = reinterpret_cast<hanabi_learning_env::HanabiObservation*>(
+        observations[i].observation);
+    LoadPermutations(*obs->ParentGame(), i, orders, color_permutes, &order,
+                     &color_permute, &inv_color_permute);
+    obs_enc->EncodeInto(*obs, show_own_cards, order, color_permutes != nullptr,
+                        color_permute, inv_color_permute, hide_action,
+                        encoding.data());
+    if (legal_masks != nullptr) {
+      const int max_moves = obs->ParentGame()->MaxMoves();
+      obs_enc->EncodeLegalMoves(*obs, legal_masks + i * max_moves);
+    }
+    unsigned char* row = out + i * row_bytes;
+    std::memset(row, 0, row_bytes);
+    for (int j = 0; j < length; ++j) {
+      if (encoding[j] > 0) {
+        row[j / 8] |= 0x80 >> (j % 8);
+      }
+    }
+  }
+}
+
+void EncodeObservationColorPermutations(
+    pyhanabi_observation_encoder_t* encoder,
+    pyhanabi_observation_t* observation, int show_own_cards,
+    const int* order, int num_permutations, const int* color_permutes,
+    int hide_action, float* out) {
+  auto obs_enc = CanonicalEncoder(encoder);
+  REQUIRE(observation != nullptr);
+  REQUIRE(observation->observation != nullptr);
+  REQUIRE(color_permutes != nullptr || num_permutations == 0);
+  REQUIRE(out != nullptr || num_permutations == 0);
+  auto obs = reinterpret_cast<hanabi_learning_env::HanabiObservation*>(
+      observation->observation);
+  const hanabi_learning_env::HanabiGame& game = *obs->ParentGame();
+  std::vector<int> hand_order;
+  if (order != nullptr) {
+    hand_order.assign(order, order + game.HandSize());
+  }
+  std::vector<std::vector<int>> gathers(num_permutations);
+  std::vector<int> color_permute;
+  for (int k = 0; k < num_permutations; ++k) {
+    const int* begin = color_permutes + k * game.NumColors();
+    color_permute.assign(begin, begin + game.NumColors());
+    for (int c : color_permute) {
+      REQUIRE(c >= 0 && c < game.NumColors());
+    }
+    gathers[k] = obs_enc->ColorPermutationGather(color_permute);
+  }
+  obs_enc->EncodeColorPermutations(*obs, show_own_cards, hand_order,
+                                   hide_action, gathers, out);
+}
+
+void StateStepEncoded(pyhanabi_state_t* state,
+                      pyhanabi_observation_encoder_t* encoder, int move_uid,
+                      float* observations, unsigned char* legal_mask,
+                      int* reward, int* done, int* cur_player) {
+  REQUIRE(state != nullptr);
+  REQUIRE(state->state != nullptr);
+  REQUIRE(observations != nullptr);
+  REQUIRE(legal_mask != nullptr);
+  REQUIRE(reward != nullptr && done != nullptr && cur_player != nullptr);
+  auto obs_enc = CanonicalEncoder(encoder);
+  auto hanabi_state =
+      reinterpret_cast<hanabi_learning_env::HanabiState*>(state->state);
+  const hanabi_learning_env::HanabiGame* game = hanabi_state->ParentGame();
+  int last_score = hanabi_state->Score();
+  if (move_uid >= 0) {
+    StateApplyMoveUid(state, move_uid);
+  }
+  while (hanabi_state->CurPlayer() == hanabi_learning_env::kChancePlayerId &&
+         !hanabi_state->IsTerminal()) {
+    hanabi_state->ApplyRandomChance();
+  }
+  const int length = obs_enc->EncodingLength();
+  *done = hanabi_state->IsTerminal();
+  std::memset(legal_mask, 0, game->MaxMoves());
+  for (int player = 0; player < game->NumPlayers(); ++player) {
+    hanabi_learning_env::HanabiObservation observation(*hanabi_state, player);
+    obs_enc->EncodeInto(observation, false, {}, false, {}, {}, false,
+                        observations + player * length);
+    if (player == hanabi_state->CurPlayer() && !*done) {
+      obs_enc->EncodeLegalMoves(observation, legal_mask);
+    }
+  }
+  *reward = hanabi_state->Score() - last_score;
+  *cur_player = hanabi_state->CurPlayer();
+}
+
+static hanabi_learning_env::ObservationStacker* Stacker(
+    pyhanabi_observation_stacker_t* stacker) {
+  REQUIRE(stacker != nullptr);
+  REQUIRE(stacker->stacker != nullptr);
+  return static_cast<hanabi_learning_env::ObservationStacker*>(
+      stacker->stacker);
+}
+
+void StateStepStacked(pyhanabi_state_t* state,
+                      pyhanabi_observation_encoder_t* encoder,
+                      pyhanabi_observation_stacker_t* stacker, int move_uid,
+                      float* observations, unsigned char* legal_mask,
+                      int* reward, int* done, int* cur_player) {
+  hanabi_learning_env::ObservationStacker* history = Stacker(stacker);
+  if (move_uid < 0) {
+    history->Reset();
+  }
+  StateStepEncoded(state, encoder, move_uid, observations, legal_mask, reward,
+                   done, cur_player);
+  REQUIRE(history->ObservationSize() ==
+          CanonicalEncoder(encoder)->EncodingLength());
+  if (*done) {
+    history->EndEpisode();
+  } else {
+    history->Add(*cur_player,
+                 observations + *cur_player * history->ObservationSize());
+  }
+}
+
+/* Observation stacker functions. */
+void NewObservationStacker(int num_players, int history_size,
+                           int observation_size,
+                           pyhanabi_observation_stacker_t* stacker) {
+  REQUIRE(stacker != nullptr);
+  stacker->stacker = new hanabi_learning_env::ObservationStacker(
+      num_players, history_size, observation_size);
+}
+
+void DeleteObservationStacker(pyhanabi_observation_stacker_t* stacker) {
+  delete Stacker(stacker);
+  stacker->stacker = nullptr;
+}
+
+void ObservationStackerReset(pyhanabi_observation_stacker_t* stacker) {
+  Stacker(stacker)->Reset();
+}
+
+void ObservationStackerAdd(pyhanabi_observation_stacker_t* stacker,
+                           int player, const float* observation) {
+  REQUIRE(observation != nullptr);
+  Stacker(stacker)->Add(player, observation);
+}
+
+const float* ObservationStackerView(pyhanabi_observation_stacker_t* stacker,
+                                    int player) {
+  return Stacker(stacker)->Stack(player);
+}
+
+void ObservationStackerCopy(pyhanabi_observation_stacker_t* stacker,
+                            int player, float* out) {
+  REQUIRE(out != nullptr);
+  Stacker(stacker)->CopyStack(player, out);
+}
+
+/* Game record functions. */
+void NewGameRecordWriter(const char* path,
+                         pyhanabi_game_record_writer_t* writer) {
+  REQUIRE(path != nullptr);
+  REQUIRE(writer != nullptr);
+  writer->writer = new hanabi_learning_env::GameRecordWriter(path);
+}
+
+void DeleteGameRecordWriter(pyhanabi_game_record_writer_t* writer) {
+  REQUIRE(writer != nullptr);
+  REQUIRE(writer->writer != nullptr);
+  delete static_cast<hanabi_learning_env::GameRecordWriter*>(writer->writer);
+  writer->writer = nullptr;
+}
+
+void GameRecordWriterAppend(pyhanabi_game_record_writer_t* writer,
+                            pyhanabi_state_t* state, int config_id) {
+  REQUIRE(writer != nullptr);
+  REQUIRE(writer->writer != nullptr);
+  REQUIRE(state != nullptr);
+  REQUIRE(state->state != nullptr);
+  REQUIRE(config_id >= 0 && config_id < 65536);
+  static_cast<hanabi_learning_env::GameRecordWriter*>(writer->writer)
+      ->Append(*static_cast<hanabi_learning_env::HanabiState*>(state->state),
+               config_id);
+}
+
+void GameRecordWriterFlush(pyhanabi_game_record_writer_t* writer) {
+  REQUIRE(writer != nullptr);
+  REQUIRE(writer->writer != nullptr);
+  static_cast<hanabi_learning_env::GameRecordWriter*>(writer->writer)
+      ->Flush();
+}
+
+void NewGameRecordReader(const char* path,
+                         pyhanabi_game_record_reader_t* reader) {
+  REQUIRE(path != nullptr);
+  REQUIRE(reader != nullptr);
+  reader->reader = new hanabi_learning_env::GameRecordReader(path);
+}
+
+void DeleteGameRecordReader(pyhanabi_game_record_reader_t* reader) {
+  REQUIRE(reader != nullptr);
+  REQUIRE(reader->reader != nullptr);
+  delete static_cast<hanabi_learning_env::GameRecordReader*>(reader->reader);
+  reader->reader = nullptr;
+}
+
+long long GameRecordReaderNumRecords(pyhanabi_game_record_reader_t* reader) {
+  REQUIRE(reader != nullptr);
+  REQUIRE(reader->reader != nullptr);
+  return static_cast<hanabi_learning_env::GameRecordReader*>(reader->reader)
+      ->NumRecords();
+}
+
+int GameRecordReaderConfigId(pyhanabi_game_record_reader_t* reader,
+                             long long index) {
+  REQUIRE(reader != nullptr);
+  REQUIRE(reader->reader != nullptr);
+  return static_cast<hanabi_learning_env::GameRecordReader*>(reader->reader)
+      ->ConfigId(index);
+}
+
+int GameRecordReaderNumMoves(pyhanabi_game_record_reader_t* reader,
+                             long long index) {
+  REQUIRE(reader != nullptr);
+  REQUIRE(reader->reader != nullptr);
+  return static_cast<hanabi_learning_env::GameRecordReader*>(reader->reader)
+      ->NumMoves(index);
+}
+
+void GameRecordReaderReplay(pyhanabi_game_record_reader_t* reader,
+                            long long index, pyhanabi_game_t* game,
+                            int max_moves, pyhanabi_state_t* state) {
+  REQUIRE(reader != nullptr);
+  REQUIRE(reader->reader != nullptr);
+  REQUIRE(game != nullptr);
+  REQUIRE(game->game != nullptr);
+  REQUIRE(state != nullptr);
+  state->state = new hanabi_learning_env::HanabiState(
+      static_cast<hanabi_learning_env::GameRecordReader*>(reader->reader)
+          ->Replay(index,
+                   static_cast<hanabi_learning_env::HanabiGame*>(game->game),
+                   max_moves));
+}
+
+/* Prioritized replay memory functions. */
+static hanabi_learning_env::PrioritizedReplayMemory* ReplayMemory(
+    pyhanabi_replay_memory_t* memory) {
+  REQUIRE(memory != nullptr);
+  REQUIRE(memory->memory != nullptr);
+  return static_cast<hanabi_learning_env::PrioritizedReplayMemory*>(
+      memory->memory);
+}
+
+void NewPrioritizedReplayMemory(int num_actions, int observation_size,
+                                int stack_size, int capacity,
+                                int update_horizon, float gamma,
+                                unsigned long long seed,
+                                pyhanabi_replay_memory_t* memory) {
+  REQUIRE(memory != nullptr);
+  memory->memory = new hanabi_learning_env::PrioritizedReplayMemory(
+      num_actions, observation_size, stack_size, capacity, update_horizon,
+      gamma, seed);
+}
+
+void DeletePrioritizedReplayMemory(pyhanabi_replay_memory_t* memory) {
+  delete ReplayMemory(memory);
+  memory->memory = nullptr;
+}
+
+int ReplayMemoryObservationBytes(pyhanabi_replay_memory_t* memory) {
+  return ReplayMemory(memory)->ObservationBytes();
+}
+
+int ReplayMemoryLegalActionBytes(pyhanabi_replay_memory_t* memory) {
+  return ReplayMemory(memory)->LegalActionBytes();
+}
+
+long long ReplayMemoryAddCount(pyhanabi_replay_memory_t* memory) {
+  return ReplayMemory(memory)->AddCount();
+}
+
+void ReplayMemoryAdd(pyhanabi_replay_memory_t* memory,
+                     const unsigned char* observation, int action,
+                     float reward, int terminal,
+                     const unsigned char* legal_actions) {
+  ReplayMemory(memory)->Add(observation, action, reward, terminal,
+                            legal_actions);
+}
+
+int ReplayMemorySampleIndices(pyhanabi_replay_memory_t* memory,
+                              int batch_size, int* indices) {
+  return ReplayMemory(memory)->SampleIndexBatch(batch_size, indices);
+}
+
+int ReplayMemorySampleTransitions(pyhanabi_replay_memory_t* memory,
+                                  int batch_size, const int* indices,
+                                  unsigned char* states, int* actions,
+                                  float* rewards, unsigned char* next_states,
+                                  unsigned char* terminals, int* out_indices,
+                                  float* next_legal_actions) {
+  REQUIRE(states != nullptr && actions != nullptr && rewards != nullptr);
+  REQUIRE(next_states != nullptr && terminals != nullptr);
+  REQUIRE(out_indices != nullptr && next_legal_actions != nullptr);
+  hanabi_learning_env::ReplayBatch batch = {
+      states,    actions,     rewards,           next_states,
+      terminals, out_indices, next_legal_actions};
+  return ReplayMemory(memory)->SampleTransitionBatch(batch_size, indices,
+                                                     batch);
+}
+
+void ReplayMemorySetPriorities(pyhanabi_replay_memory_t* memory,
+                               int num_indices, const int* indices,
+                               const float* priorities) {
+  ReplayMemory(memory)->SetPriorities(num_indices, indices, priorities);
+}
+
+void ReplayMemoryGetPriorities(pyhanabi_replay_memory_t* memory,
+                               int num_indices, const int* indices,
+                               float* priorities) {
+  ReplayMemory(memory)->GetPriorities(num_indices, indices, priorities);
+}
+
+void ReplayMemorySave(pyhanabi_replay_memory_t* memory, const char* path) {
+  REQUIRE(path != nullptr);
+  ReplayMemory(memory)->Save(path);
+}
+
+void ReplayMemoryLoad(pyhanabi_replay_memory_t* memory, const char* path) {
+  REQUIRE(path != nullptr);
+  ReplayMemory(memory)->Load(path);
+}
+
+/* Sequence replay functions. */
+static hanabi_learning_env::SequenceReplay* Sequences(
+    pyhanabi_sequence_replay_t* replay) {
+  REQUIRE(replay != nullptr);
+  REQUIRE(replay->replay != nullptr);
+  return static_cast<hanabi_learning_env::SequenceReplay*>(replay->replay);
+}
+
+void NewSequenceReplay(int num_streams, int observation_size, int num_actions,
+                       int sequence_length, int overlap, int burn_in,
+                       int capacity, unsigned long long seed,
+                       pyhanabi_sequence_replay_t* replay) {
+  REQUIRE(replay != nullptr);
+  replay->replay = new hanabi_learning_env::SequenceReplay(
+      num_streams, observation_size, num_actions, sequence_length, overlap,
+      burn_in, capacity, seed);
+}
+
+void DeleteSequenceReplay(pyhanabi_sequence_replay_t* replay) {
+  delete Sequences(replay);
+  replay->replay = nullptr;
+}
+
+long long SequenceReplayAddCount(pyhanabi_sequence_replay_t* replay) {
+  return Sequences(replay)->AddCount();
+}
+
+void SequenceReplayAddSteps(pyhanabi_sequence_replay_t* replay, int num_steps,
+                            const int* streams, const float* observations,
+                            const unsigned char* legal_masks,
+                            const int* actions, const float* rewards,
+                            const unsigned char* terminals) {
+  REQUIRE(streams != nullptr && observations != nullptr);
+  REQUIRE(legal_masks != nullptr && actions != nullptr);
+  REQUIRE(rewards != nullptr && terminals != nullptr);
+  Sequences(replay)->AddSteps(num_steps, streams, observations,
+                                   legal_masks, actions, rewards, terminals);
+}
+
+int SequenceReplaySample(pyhanabi_sequence_replay_t* replay, int batch_size,
+                         float* observations, int* actions, float* rewards,
+                         unsigned char* terminals, unsigned char* legal_masks,
+                         int* lengths, int* indices, float* probabilities) {
+  REQUIRE(observations != nullptr && actions != nullptr);
+  REQUIRE(rewards != nullptr && terminals != nullptr);
+  REQUIRE(legal_masks != nullptr && lengths != nullptr);
+  REQUIRE(indices != nullptr && probabilities != nullptr);
+  hanabi_learning_env::SequenceBatch batch = {
+      observations, actions, rewards, terminals,
+      legal_masks,  lengths, indices, probabilities};
+  return Sequences(replay)->Sample(batch_size, batch);
+}
+
+void SequenceReplaySetPriorities(pyhanabi_sequence_replay_t* replay,
+                                 int num_indices, const int* indices,
+                                 const float* priorities) {
+  Sequences(replay)->SetPriorities(num_indices, indices, priorities);
+}
+
+/* Record replay functions. */
+static hanabi_learning_env::RecordReplay* Records(
+    pyhanabi_record_replay_t* replay) {
+  REQUIRE(replay != nullptr);
+  REQUIRE(replay->replay != nullptr);
+  return static_cast<hanabi_learning_env::RecordReplay*>(replay->replay);
+}
+
+void NewRecordReplay(pyhanabi_game_t* game, int capacity, int num_threads,
+                     unsigned long long seed,
+                     pyhanabi_record_replay_t* replay) {
+  REQUIRE(game != nullptr);
+  REQUIRE(game->game != nullptr);
+  REQUIRE(replay != nullptr);
+  replay->replay = new hanabi_learning_env::RecordReplay(
+      static_cast<hanabi_learning_env::HanabiGame*>(game->game), capacity,
+      num_threads, seed);
+}
+
+void DeleteRecordReplay(pyhanabi_record_replay_t* replay) {
+  delete Records(replay);
+  replay->replay = nullptr;
+}
+
+int RecordReplayEncodingLength(pyhanabi_record_replay_t* replay) {
+  return Records(replay)->EncodingLength();
+}
+
+long long RecordReplayAddCount(pyhanabi_record_replay_t* replay) {
+  return Records(replay)->AddCount();
+}
+
+long long RecordReplayNumTimesteps(pyhanabi_record_replay_t* replay) {
+  return Records(replay)->NumTimesteps();
+}
+
+long long RecordReplayAddState(pyhanabi_record_replay_t* replay,
+                               pyhanabi_state_t* state) {
+  REQUIRE(state != nullptr);
+  REQUIRE(state->state != nullptr);
+  return Records(replay)->AddGame(
+      *static_cast<hanabi_learning_env::HanabiState*>(state->state));
+}
+
+int RecordReplayFill(pyhanabi_record_replay_t* replay, int batch_size,
+                     int sample, long long* game_ids, int* steps,
+                     float* observations, unsigned char* legal_masks,
+                     int* actions, float* rewards, unsigned char* terminals,
+                     float* next_observations) {
+  static_assert(sizeof(long long) == sizeof(int64_t),
+                "game ids are passed as long long");
+  REQUIRE(game_ids != nullptr && steps != nullptr);
+  REQUIRE(observations != nullptr && legal_masks != nullptr);
+  REQUIRE(actions != nullptr && rewards != nullptr);
+  REQUIRE(terminals != nullptr && next_observations != nullptr);
+  hanabi_learning_env::RecordBatch batch = {
+      reinterpret_cast<int64_t*>(game_ids),
+      steps,
+      observations,
+      legal_masks,
+      actions,
+      rewards,
+      terminals,
+      next_observations};
+  if (sample) {
+    return Records(replay)->Sample(batch_size, batch);
+  }
+  Records(replay)->Encode(batch_size, batch);
+  return 1;
+}
+
+/* Actor pipeline functions. */
+static hanabi_learning_env::ActorPipeline* Pipeline(
+    pyhanabi_actor_pipeline_t* pipeline) {
+  REQUIRE(pipeline != nullptr);
+  REQUIRE(pipeline->pipeline != nullptr);
+  return static_cast<hanabi_learning_env::ActorPipeline*>(
+      pipeline->pipeline);
+}
+
+void NewActorPipeline(pyhanabi_game_t* game, int num_threads,
+                      int games_per_thread, int batch_size, int timeout_us,
+                      unsigned long long seed,
+                      pyhanabi_inference_fn inference, void* context,
+                      pyhanabi_record_replay_t* records,
+                      pyhanabi_actor_pipeline_t* pipeline) {
+  REQUIRE(game != nullptr);
+  REQUIRE(game->game != nullptr);
+  REQUIRE(inference != nullptr);
+  REQUIRE(pipeline != nullptr);
+  hanabi_learning_env::ActorPipelineOptions options;
+  options.num_threads = num_threads;
+  options.games_per_thread = games_per_thread;
+  options.batch_size = batch_size;
+  options.timeout_us = timeout_us;
+  options.seed = seed;
+  hanabi_learning_env::ActorGameEndFn game_end;
+  if (records != nullptr) {
+    hanabi_learning_env::RecordReplay* replay = Records(records);
+    game_end = [replay](const hanabi_learning_env::HanabiState& state) {
+      replay->AddGame(state);
+    };
+  }
+  pipeline->pipeline = new hanabi_learning_env::ActorPipeline(
+      static_cast<hanabi_learning_env::HanabiGame*>(game->game), options,
+      [inference, context](int n, const float* observations,
+                           const uint8_t* legal_masks, int32_t* moves) {
+        inference(context, n, observations, legal_masks, moves);
+      },
+      game_end);
+}
+
+void DeleteActorPipeline(pyhanabi_actor_pipeline_t* pipeline) {
+  delete Pipeline(pipeline);
+  pipeline->pipeline = nullptr;
+}
+
+int ActorPipelineEncodingLength(pyhanabi_actor_pipeline_t* pipeline) {
+  return Pipeline(pipeline)->EncodingLength();
+}
+
+void ActorPipelineRun(pyhanabi_actor_pipeline_t* pipeline,
+                      long long num_moves, long long* stats) {
+  REQUIRE(stats != nullptr);
+  hanabi_learning_env::ActorPipelineStats result =
+      Pipeline(pipeline)->Run(num_moves);
+  stats[0] = result.moves;
+  stats[1] = result.games;
+  stats[2] = result.total_score;
+  stats[3] = result.batches;
+}
+
+int PlayTournament(pyhanabi_game_t* game, const char** policies,
+                   int num_entrants, pyhanabi_inference_fn inference,
+                   void** contexts, int num_decks, int num_threads,
+                   int games_per_thread, unsigned long long seed,
+                   int* scores) {
+  REQUIRE(game != nullptr);
+  REQUIRE(game->game != nullptr);
+  REQUIRE(policies != nullptr);
+  REQUIRE(num_entrants > 0);
+  REQUIRE(scores != nullptr);
+  auto hanabi_game = static_cast<hanabi_learning_env::HanabiGame*>(game->game);
+  std::vector<hanabi_learning_env::TournamentEntrant> entrants(num_entrants);
+  for (int i = 0; i < num_entrants; ++i) {
+    if (policies[i] != nullptr) {
+      entrants[i].name = policies[i];
+      entrants[i].policy = policies[i];
+      if (hanabi_learning_env::MakePolicy(entrants[i].policy) == nullptr) {
+        return 0;
+      }
+      continue;
+    }
+    REQUIRE(inference != nullptr);
+    REQUIRE(contexts != nullptr);
+    void* context = contexts[i];
+    // EncodedBatchPolicy keeps per-policy buffers, so every thread gets its
+    // own.
+    entrants[i].make_batch_policy = [hanabi_game, inference, context]() {
+      return hanabi_learning_env::EncodedBatchPolicy(
+          hanabi_game,
+          [inference, context](int n, const float* observations,
+                               const uint8_t* legal_masks, int32_t* moves) {
+            inference(context, n, observations, legal_masks, moves);
+          });
+    };
+  }
+  hanabi_learning_env::TournamentOptions options;
+  options.num_threads = num_threads;
+  options.games_per_thread = games_per_thread;
+  options.seed = seed;
+  hanabi_learning_env::TournamentResult result =
+      hanabi_learning_env::RunTournament(
+          hanabi_game, entrants,
+          hanabi_learning_env::MakeDecks(hanabi_game, num_decks, seed),
+          options);
+  if (result.failed_entrant >= 0) {
+    return -1;
+  }
+  for (int l = 0; l < result.scores.size(); ++l) {
+    std::copy(result.scores[l].begin(), result.scores[l].end(),
+              scores + l * num_decks);
+  }
+  return 1;
+}
+
+/* Shared ring functions. */
+static hanabi_learning_env::SharedRing* Ring(pyhanabi_shared_ring_t* ring) {
+  REQUIRE(ring != nullptr);
+  REQUIRE(ring->ring != nullptr);
+  return static_cast<hanabi_learning_env::SharedRing*>(ring->ring);
+}
+
+void NewSharedRing(const char* path, int num_slots, int slot_bytes,
+                   pyhanabi_shared_ring_t* ring) {
+  REQUIRE(path != nullptr);
+  REQUIRE(ring != nullptr);
+  if (num_slots > 0) {
+    ring->ring =
+        new hanabi_learning_env::SharedRing(path, num_slots, slot_bytes);
+  } else {
+    ring->ring = new hanabi_learning_env::SharedRing(path);
+  }
+}
+
+void DeleteSharedRing(pyhanabi_shared_ring_t* ring) {
+  delete Ring(ring);
+  ring->ring = nullptr;
+}
+
+int SharedRingNumSlots(pyhanabi_shared_ring_t* ring) {
+  return Ring(ring)->NumSlots();
+}
+
+int SharedRingSlotBytes(pyhanabi_shared_ring_t* ring) {
+  return Ring(ring)->SlotBytes();
+}
+
+int SharedRingPush(pyhanabi_shared_ring_t* ring, const unsigned char* data,
+                   int size, long long timeout_us) {
+  REQUIRE(data != nullptr || size == 0);
+  return Ring(ring)->Push(data, size, timeout_us);
+}
+
+int SharedRingTransitionBytes(int observation_bytes, int legal_action_bytes) {
+  return hanabi_learning_env::TransitionSlotBytes(observation_bytes,
+                                                  legal_action_bytes);
+}
+
+int SharedRingPushTransition(pyhanabi_shared_ring_t* ring, int stream,
+                             const unsigned char* observation,
+                             int observation_bytes, int action, float reward,
+                             int terminal, const unsigned char* legal_actions,
+                             int legal_action_bytes, long long timeout_us) {
+  REQUIRE(observation != nullptr && legal_actions != nullptr);
+  hanabi_learning_env::TransitionHeader header = {stream, action, reward,
+                                                  terminal};
+  return hanabi_learning_env::PushTransition(
+      Ring(ring), header, observation, observation_bytes, legal_actions,
+      legal_action_bytes, timeout_us);
+}
+
+int SharedRingPeek(pyhanabi_shared_ring_t* ring, int max_slots,
+                   long long timeout_us, const unsigned char** slots) {
+  return Ring(ring)->Peek(max_slots, timeout_us, slots);
+}
+
+void SharedRingRelease(pyhanabi_shared_ring_t* ring, int num_slots) {
+  Ring(ring)->Release(num_slots);
+}
+
+/* Uid-based functions. */
+static void FillHistoryEntry(
+    const hanabi_learning_env::HanabiGame& game,
+    const hanabi_learning_env::HanabiHistoryItem& item,
+    pyhanabi_history_entry_t* entry) {
+  bool deal = item.move.MoveType() == hanabi_learning_env::HanabiMove::kDeal;
+  entry->move_uid = deal ? -1 : game.GetMoveUid(item.move);
+  entry->move_type = item.move.MoveType();
+  entry->move_card_index = item.move.CardIndex();
+  entry->move_target_offset = item.move.TargetOffset();
+  entry->move_color = item.move.Color();
+  entry->move_rank = item.move.Rank();
+  entry->player = item.player;
+  entry->scored = item.scored;
+  entry->information_token = item.information_token;
+  entry->color = item.color;
+  entry->rank = item.rank;
+  entry->reveal_bitmask = item.reveal_bitmask;
+  entry->newly_revealed_bitmask = item.newly_revealed_bitmask;
+  entry->deal_to_player = item.deal_to_player;
+}
+
+int StateMaxMoves(pyhanabi_state_t* state) {
+  REQUIRE(state != nullptr);
+  REQUIRE(state->state != nullptr);
+  return reinterpret_cast<hanabi_learning_env::HanabiState*>(state->state)
+      ->ParentGame()
+      ->MaxMoves();
+}
+
+int StateLegalMoveUids(pyhanabi_state_t* state, int* move_uids) {
+  REQUIRE(state != nullptr);
+  REQUIRE(state->state != nullptr);
+  REQUIRE(move_uids != nullptr);
+  auto hanabi_state =
+      reinterpret_cast<hanabi_learning_env::HanabiState*>(state->state);
+  // Same moves as LegalMoves(), without building a move list.
+  if (hanabi_state->CurPlayer() == hanabi_learning_env::kChancePlayerId) {
+    return 0;
+  }
+  const hanabi_learning_env::HanabiGame* game = hanabi_state->ParentGame();
+  int num_moves = 0;
+  for (int uid = 0; uid < game->MaxMoves(); ++uid) {
+    if (hanabi_state->MoveIsLegal(game->GetMove(uid))) {
+      move_uids[num_moves++] = uid;
+    }
+  }
+  return num_moves;
+}
+
+void StateLegalMoveMask(pyhanabi_state_t* state, unsigned char* mask) {
+  REQUIRE(state != nullptr);
+  REQUIRE(state->state != nullptr);
+  REQUIRE(mask != nullptr);
+  auto hanabi_state =
+      reinterpret_cast<hanabi_learning_env::HanabiState*>(state->state);
+  const hanabi_learning_env::HanabiGame* game = hanabi_state->ParentGame();
+  bool chance =
+      hanabi_state->CurPlayer() == hanabi_learning_env::kChancePlayerId;
+  for (int uid = 0; uid < game->MaxMoves(); ++uid) {
+    mask[uid] = !chance && hanabi_state->MoveIsLegal(game->GetMove(uid));
+  }
+}
+
+void StateApplyMoveUid(pyhanabi_state_t* state, int move_uid) {
+  REQUIRE(state != nullptr);
+  REQUIRE(state->state != nullptr);
+  auto hanabi_state =
+      reinterpret_cast<hanabi_learning_env::HanabiState*>(state->state);
+  REQUIRE(move_uid >= 0 && move_uid < hanabi_state->ParentGame()->MaxMoves());
+  hanabi_state->ApplyMove(hanabi_state->ParentGame()->GetMove(move_uid));
+}
+
+int StateMoveHistoryEntries(pyhanabi_state_t* state, int start,
+                            int max_entries,
+                            pyhanabi_history_entry_t* entries) {
+  REQUIRE(state != nullptr);
+  REQUIRE(state->state != nullptr);
+  REQUIRE(start >= 0);
+  auto hanabi_state =
+      reinterpret_cast<hanabi_learning_env::HanabiState*>(state->state);
+  const auto& history = hanabi_state->MoveHistory();
+  int num_entries = 0;
+  for (int i = start; i < history.size() && num_entries < max_entries; ++i) {
+    FillHistoryEntry(*hanabi_state->ParentGame(), history[i],
+                     &entries[num_entries++]);
+  }
+  return num_entries;
+}
+
+int ObsLegalMoveUids(pyhanabi_observation_t* observation, int* move_uids) {
+  REQUIRE(observation != nullptr);
+  REQUIRE(observation->observation != nullptr);
+  REQUIRE(move_uids != nullptr);
+  auto hanabi_observation =
+      reinterpret_cast<hanabi_learning_env::HanabiObservation*>(
+          observation->observation);
+  const auto& legal_moves = hanabi_observation->LegalMoves();
+  for (int i = 0; i < legal_moves.size(); ++i) {
+    move_uids[i] = hanabi_observation->ParentGame()->GetMoveUid(legal_moves[i]);
+  }
+  return legal_moves.size();
+}
+
+int ObsLastMoveEntries(pyhanabi_observation_t* observation, int max_entries,
+                       pyhanabi_history_entry_t* entries) {
+  REQUIRE(observation != nullptr);
+  REQUIRE(observation->observation != nullptr);
+  auto hanabi_observation =
+      reinterpret_cast<hanabi_learning_env::HanabiObservation*>(
+          observation->observation);
+  const auto& last_moves = hanabi_observation->LastMoves();
+  int num_entries = 0;
+  for (int i = 0; i < last_moves.size() && num_entries < max_entries; ++i) {
+    FillHistoryEntry(*hanabi_observation->ParentGame(), last_moves[i],
+                     &entries[num_entries++]);
+  }
+  return num_entries;
+}
+
+void StatesApplyMoveUids(pyhanabi_state_t* states, int num_states,
+                         const int* move_uids, int deal_cards) {
+  REQUIRE(states != nullptr || num_states == 0);
+  REQUIRE(move_uids != nullptr || num_states == 0);
+  for (int i = 0; i < num_states; ++i) {
+    if (move_uids[i] < 0) {
+      continue;
+    }
+    StateApplyMoveUid(&states[i], move_uids[i]);
+    if (deal_cards) {
+      auto hanabi_state =
+          reinterpret_cast<hanabi_learning_env::HanabiState*>(states[i].state);
+      while (hanabi_state->CurPlayer() ==
+                 hanabi_learning_env::kChancePlayerId &&
+             !hanabi_state->IsTerminal()) {
+        hanabi_state->ApplyRandomChance();
+      }
+    }
+  }
+}
+
+void StatesLegalMoveMasks(pyhanabi_state_t* states, int num_states,
+                          unsigned char* masks) {
+  REQUIRE(states != nullptr || num_states == 0);
+  REQUIRE(masks != nullptr || num_states == 0);
+  int offset = 0;
+  for (int i = 0; i < num_states; ++i) {
+    StateLegalMoveMask(&states[i], masks + offset);
+    offset += reinterpret_cast<hanabi_learning_env::HanabiState*>(
+                  states[i].state)
+                  ->ParentGame()
+                  ->MaxMoves();
+  }
+}
+
+void StatesStatus(pyhanabi_state_t* states, int num_states, int* cur_players,
+                  int* end_of_game_status, int* scores) {
+  REQUIRE(states != nullptr || num_states == 0);
+  for (int i = 0; i < num_states; ++i) {
+    REQUIRE(states[i].state != nullptr);
+    auto hanabi_state =
+        reinterpret_cast<hanabi_learning_env::HanabiState*>(states[i].state);
+    if (cur_players != nullptr) {
+      cur_players[i] = hanabi_state->CurPlayer();
+    }
+    if (end_of_game_status != nullptr) {
+      end_of_game_status[i] = hanabi_state->EndOfGameStatus();
+    }
+    if (scores != nullptr) {
+      scores[i] = hanabi_state->Score();
+    }
+  }
+}
+
+int StatesPolicyMoveUids(const char* policy, pyhanabi_state_t* states,
+                         int num_states, unsigned long long seed,
+                         int* move_uids) {
+  REQUIRE(policy != nullptr);
+  REQUIRE(states != nullptr || num_states == 0);
+  REQUIRE(move_uids != nullptr || num_states == 0);
+  std::unique_ptr<hanabi_learning_env::HanabiPolicy> hanabi_policy =
+      hanabi_learning_env::MakePolicy(policy);
+  if (hanabi_policy == nullptr) {
+    return 0;
+  }
+  for (int i = 0; i < num_states; ++i) {
+    REQUIRE(states[i].state != nullptr);
+    auto hanabi_state =
+        reinterpret_cast<hanabi_learning_env::HanabiState*>(states[i].state);
+    const int player = hanabi_state->CurPlayer();
+    if (hanabi_state->IsTerminal() ||
+        player == hanabi_learning_env::kChancePlayerId) {
+      move_uids[i] = -1;
+      continue;
+    }
+    hanabi_learning_env::HanabiRng rng(seed, i,
+                                       hanabi_state->MoveHistory().size());
+    move_uids[i] = hanabi_state->ParentGame()->GetMoveUid(hanabi_policy->Act(
+        hanabi_learning_env::HanabiObservation(*hanabi_state, player), &rng));
+  }
+  return 1;
+}
+
+/* Instrumentation functions. */
+int InstrumentationAvailable() {
+  return hanabi_learning_env::InstrumentationEnabled();
 }
 
+char* InstrumentationDump(int json) {
+  std::string str = hanabi_learning_env::InstrumentationReport(json);
+  return strdup(str.c_str());
+}
+
+void InstrumentationReset() { hanabi_learning_env::ResetInstrumentation(); }
+
 } /* extern "C" */
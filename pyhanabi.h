@@ -63,6 +63,72 @@ typedef struct PyHanabiObservationEncoder {
   void* encoder;
 } pyhanabi_observation_encoder_t;
 
+typedef struct PyHanabiGameRecordWriter {
+  /* Points to a hanabi_learning_env::GameRecordWriter. */
+  void* writer;
+} pyhanabi_game_record_writer_t;
+
+typedef struct PyHanabiGameRecordReader {
+  /* Points to a hanabi_learning_env::GameRecordReader. */
+  void* reader;
+} pyhanabi_game_record_reader_t;
+
+typedef struct PyHanabiReplayMemory {
+  /* Points to a hanabi_learning_env::PrioritizedReplayMemory. */
+  void* memory;
+} pyhanabi_replay_memory_t;
+
+typedef struct PyHanabiObservationStacker {
+  /* Points to a hanabi_learning_env::ObservationStacker. */
+  void* stacker;
+} pyhanabi_observation_stacker_t;
+
+typedef struct PyHanabiSequenceReplay {
+  /* Points to a hanabi_learning_env::SequenceReplay. */
+  void* replay;
+} pyhanabi_sequence_replay_t;
+
+typedef struct PyHanabiRecordReplay {
+  /* Points to a hanabi_learning_env::RecordReplay. */
+  void* replay;
+} pyhanabi_record_replay_t;
+
+typedef struct PyHanabiActorPipeline {
+  /* Points to a hanabi_learning_env::ActorPipeline. */
+  void* pipeline;
+} pyhanabi_actor_pipeline_t;
+
+typedef struct PyHanabiSharedRing {
+  /* Points to a hanabi_learning_env::SharedRing. */
+  void* ring;
+} pyhanabi_shared_ring_t;
+
+/* Batched inference callback of an actor pipeline or tournament entrant.
+ * Writes one legal move uid per request to moves. */
+typedef void (*pyhanabi_inference_fn)(void* context, int batch_size,
+                                      const float* observations,
+                                      const unsigned char* legal_masks,
+                                      int* moves);
+
+/* A history item as plain data, for the uid-based functions below. */
+typedef struct PyHanabiHistoryEntry {
+  /* Uid of the move in the parent game, or -1 for a deal. */
+  int move_uid;
+  int move_type;
+  int move_card_index;
+  int move_target_offset;
+  int move_color;
+  int move_rank;
+  int player;
+  int scored;
+  int information_token;
+  int color;
+  int rank;
+  int reveal_bitmask;
+  int newly_revealed_bitmask;
+  int deal_to_player;
+} pyhanabi_history_entry_t;
+
 /* Utility Functions. */
 void DeleteString(char* str);
 
@@ -109,6 +175,9 @@ int HistoryItemDealToPlayer(pyhanabi_history_item_t* item);
 
 /* State functions. */
 void NewState(pyhanabi_game_t* game, pyhanabi_state_t* state);
+void NewStateFromStream(pyhanabi_game_t* game, unsigned long long seed,
+                        unsigned int env_id, unsigned long long episode_id,
+                        pyhanabi_state_t* state);
 void CopyState(const pyhanabi_state_t* src, pyhanabi_state_t* dest);
 void DeleteState(pyhanabi_state_t* state);
 const void* StateParentGame(pyhanabi_state_t* state);
@@ -188,6 +257,273 @@ void DeleteObservationEncoder(pyhanabi_observation_encoder_t* encoder);
 char* ObservationShape(pyhanabi_observation_encoder_t* encoder);
 char* EncodeObservation(pyhanabi_observation_encoder_t* encoder,
                         pyhanabi_observation_t* observation);
+int ObservationEncodingLength(pyhanabi_observation_encoder_t* encoder);
+/* Encodes observations[i] into the ObservationEncodingLength() floats at
+ * out + i * length, with the options of CanonicalObservationEncoder::Encode.
+ * orders is NULL or holds HandSize(game) card indices per observation, and
+ * color_permutes is NULL or holds NumColors(game) colors per observation.
+ * Unless legal_masks is NULL, also writes the observing player's legal move
+ * mask to the MaxMoves(game) bytes at legal_masks + i * MaxMoves(game). */
+void EncodeObservationsInto(pyhanabi_observation_encoder_t* encoder,
+                            pyhanabi_observation_t* observations,
+                            int num_observations, int show_own_cards,
+                            const int* orders, const int* color_permutes,
+                            int hide_action, float* out,
+                            unsigned char* legal_masks);
+/* Same as EncodeObservationsInto, but stores each value as the bit
+ * (value > 0), packed into (length + 7) / 8 bytes per observation, most
+ * significant bit first as numpy.unpackbits expects. */
+void EncodeObservationsPacked(pyhanabi_observation_encoder_t* encoder,
+                              pyhanabi_observation_t* observations,
+                              int num_observations, int show_own_cards,
+                              const int* orders, const int* color_permutes,
+                              int hide_action, unsigned char* out,
+                              unsigned char* legal_masks);
+/* Encodes one observation under num_permutations color permutations of
+ * NumColors(game) colors each, into out + k * ObservationEncodingLength(), as
+ * EncodeObservationsInto does with one permutation. The observation is
+ * encoded once and each permutation is applied as a gather. order is NULL or
+ * holds HandSize(game) card indices. */
+void EncodeObservationColorPermutations(
+    pyhanabi_observation_encoder_t* encoder,
+    pyhanabi_observation_t* observation, int show_own_cards,
+    const int* order, int num_permutations, const int* color_permutes,
+    int hide_action, float* out);
+/* One step of an array-based RL loop. Applies move_uid unless it is
+ * negative and deals cards until a player acts. Then writes the encoded
+ * observation of every player to observations (NumPlayers(game) rows), the
+ * legal move mask of the acting player to legal_mask (MaxMoves(game) bytes,
+ * all zero once the game is over), the score change, whether the game is
+ * over and the acting player. */
+void StateStepEncoded(pyhanabi_state_t* state,
+                      pyhanabi_observation_encoder_t* encoder, int move_uid,
+                      float* observations, unsigned char* legal_mask,
+                      int* reward, int* done, int* cur_player);
+/* StateStepEncoded, also appending the acting player's observation to its
+ * history in stacker. The stacker is reset by a negative move_uid and
+ * before the first step after the game is over. */
+void StateStepStacked(pyhanabi_state_t* state,
+                      pyhanabi_observation_encoder_t* encoder,
+                      pyhanabi_observation_stacker_t* stacker, int move_uid,
+                      float* observations, unsigned char* legal_mask,
+                      int* reward, int* done, int* cur_player);
+
+/* Observation stacker functions. A stack holds the last history_size
+ * observations of a player, oldest first. */
+void NewObservationStacker(int num_players, int history_size,
+                           int observation_size,
+                           pyhanabi_observation_stacker_t* stacker);
+void DeleteObservationStacker(pyhanabi_observation_stacker_t* stacker);
+void ObservationStackerReset(pyhanabi_observation_stacker_t* stacker);
+void ObservationStackerAdd(pyhanabi_observation_stacker_t* stacker,
+                           int player, const float* observation);
+/* Returns history_size * observation_size contiguous values, valid until
+ * the stacker is next changed. */
+const float* ObservationStackerView(pyhanabi_observation_stacker_t* stacker,
+                                    int player);
+void ObservationStackerCopy(pyhanabi_observation_stacker_t* stacker,
+                            int player, float* out);
+
+/* Game record functions. */
+void NewGameRecordWriter(const char* path,
+                         pyhanabi_game_record_writer_t* writer);
+void DeleteGameRecordWriter(pyhanabi_game_record_writer_t* writer);
+void GameRecordWriterAppend(pyhanabi_game_record_writer_t* writer,
+                            pyhanabi_state_t* state, int config_id);
+void GameRecordWriterFlush(pyhanabi_game_record_writer_t* writer);
+void NewGameRecordReader(const char* path,
+                         pyhanabi_game_record_reader_t* reader);
+void DeleteGameRecordReader(pyhanabi_game_record_reader_t* reader);
+long long GameRecordReaderNumRecords(pyhanabi_game_record_reader_t* reader);
+int GameRecordReaderConfigId(pyhanabi_game_record_reader_t* reader,
+                             long long index);
+int GameRecordReaderNumMoves(pyhanabi_game_record_reader_t* reader,
+                             long long index);
+void GameRecordReaderReplay(pyhanabi_game_record_reader_t* reader,
+                            long long index, pyhanabi_game_t* game,
+                            int max_moves, pyhanabi_state_t* state);
+
+/* Prioritized replay memory functions. Observations and legal actions are
+ * bit-packed rows as written by EncodeObservationsPacked, with
+ * ReplayMemoryObservationBytes and ReplayMemoryLegalActionBytes bytes. */
+void NewPrioritizedReplayMemory(int num_actions, int observation_size,
+                                int stack_size, int capacity,
+                                int update_horizon, float gamma,
+                                unsigned long long seed,
+                                pyhanabi_replay_memory_t* memory);
+void DeletePrioritizedReplayMemory(pyhanabi_replay_memory_t* memory);
+int ReplayMemoryObservationBytes(pyhanabi_replay_memory_t* memory);
+int ReplayMemoryLegalActionBytes(pyhanabi_replay_memory_t* memory);
+long long ReplayMemoryAddCount(pyhanabi_replay_memory_t* memory);
+void ReplayMemoryAdd(pyhanabi_replay_memory_t* memory,
+                     const unsigned char* observation, int action,
+                     float reward, int terminal,
+                     const unsigned char* legal_actions);
+/* Both sampling functions return 0 if no valid batch could be drawn. */
+int ReplayMemorySampleIndices(pyhanabi_replay_memory_t* memory,
+                              int batch_size, int* indices);
+/* Samples a batch, or reads the one at indices if it is not NULL. states
+ * and next_states hold batch_size x observation_size x stack_size bytes,
+ * next_legal_actions batch_size x num_actions floats (0 or -inf). */
+int ReplayMemorySampleTransitions(pyhanabi_replay_memory_t* memory,
+                                  int batch_size, const int* indices,
+                                  unsigned char* states, int* actions,
+                                  float* rewards, unsigned char* next_states,
+                                  unsigned char* terminals, int* out_indices,
+                                  float* next_legal_actions);
+void ReplayMemorySetPriorities(pyhanabi_replay_memory_t* memory,
+                               int num_indices, const int* indices,
+                               const float* priorities);
+void ReplayMemoryGetPriorities(pyhanabi_replay_memory_t* memory,
+                               int num_indices, const int* indices,
+                               float* priorities);
+void ReplayMemorySave(pyhanabi_replay_memory_t* memory, const char* path);
+void ReplayMemoryLoad(pyhanabi_replay_memory_t* memory, const char* path);
+
+/* Sequence replay functions. Steps are added per stream, e.g. one stream
+ * per player of each environment, and stored as overlapping sequences of
+ * sequence_length steps. */
+void NewSequenceReplay(int num_streams, int observation_size, int num_actions,
+                       int sequence_length, int overlap, int burn_in,
+                       int capacity, unsigned long long seed,
+                       pyhanabi_sequence_replay_t* replay);
+void DeleteSequenceReplay(pyhanabi_sequence_replay_t* replay);
+long long SequenceReplayAddCount(pyhanabi_sequence_replay_t* replay);
+/* observations holds num_steps x observation_size floats and legal_masks
+ * num_steps x num_actions bytes, as written by StateStepEncoded. */
+void SequenceReplayAddSteps(pyhanabi_sequence_replay_t* replay, int num_steps,
+                            const int* streams, const float* observations,
+                            const unsigned char* legal_masks,
+                            const int* actions, const float* rewards,
+                            const unsigned char* terminals);
+/* Returns 0 if no sequence is stored yet. */
+int SequenceReplaySample(pyhanabi_sequence_replay_t* replay, int batch_size,
+                         float* observations, int* actions, float* rewards,
+                         unsigned char* terminals, unsigned char* legal_masks,
+                         int* lengths, int* indices, float* probabilities);
+void SequenceReplaySetPriorities(pyhanabi_sequence_replay_t* replay,
+                                 int num_indices, const int* indices,
+                                 const float* priorities);
+
+/* Record replay functions. Games are stored as game records and the
+ * sampled timesteps are re-encoded with the canonical encoder. Timestep t of
+ * a game is the state before its t-th player move. */
+void NewRecordReplay(pyhanabi_game_t* game, int capacity, int num_threads,
+                     unsigned long long seed,
+                     pyhanabi_record_replay_t* replay);
+void DeleteRecordReplay(pyhanabi_record_replay_t* replay);
+int RecordReplayEncodingLength(pyhanabi_record_replay_t* replay);
+long long RecordReplayAddCount(pyhanabi_record_replay_t* replay);
+long long RecordReplayNumTimesteps(pyhanabi_record_replay_t* replay);
+/* Stores the game played so far in state. Returns its id, or -1 if no
+ * player move was made. */
+long long RecordReplayAddState(pyhanabi_record_replay_t* replay,
+                               pyhanabi_state_t* state);
+/* Samples batch_size timesteps, or encodes the given ones if sample is 0,
+ * reading game_ids and steps. observations and next_observations hold
+ * batch_size x ObservationEncodingLength() floats, legal_masks
+ * batch_size x MaxMoves(game) bytes. Returns 0 if nothing is stored. */
+int RecordReplayFill(pyhanabi_record_replay_t* replay, int batch_size,
+                     int sample, long long* game_ids, int* steps,
+                     float* observations, unsigned char* legal_masks,
+                     int* actions, float* rewards, unsigned char* terminals,
+                     float* next_observations);
+
+/* Actor pipeline functions. Worker threads play num_threads x
+ * games_per_thread games and their move requests are answered in batches of
+ * up to batch_size by inference, called on the thread running
+ * ActorPipelineRun. Finished games are added to records unless it is NULL. */
+void NewActorPipeline(pyhanabi_game_t* game, int num_threads,
+                      int games_per_thread, int batch_size, int timeout_us,
+                      unsigned long long seed,
+                      pyhanabi_inference_fn inference, void* context,
+                      pyhanabi_record_replay_t* records,
+                      pyhanabi_actor_pipeline_t* pipeline);
+void DeleteActorPipeline(pyhanabi_actor_pipeline_t* pipeline);
+int ActorPipelineEncodingLength(pyhanabi_actor_pipeline_t* pipeline);
+/* Plays until at least num_moves moves were chosen. Writes the number of
+ * moves, finished games, their total score and inference calls to stats. */
+void ActorPipelineRun(pyhanabi_actor_pipeline_t* pipeline,
+                      long long num_moves, long long* stats);
+
+/* Plays a cross-play tournament on num_decks common decks shuffled from seed.
+ * Entrant i is the built-in policy named policies[i], or, if that is NULL,
+ * a batched policy that calls inference(contexts[i], ...) with canonical
+ * encodings. Each of the num_threads threads calls inference from itself,
+ * so it may run concurrently. Writes the score of lineup l on deck d to
+ * scores[l * num_decks + d], where lineups are the num_entrants^NumPlayers
+ * seat assignments in lexicographic order. Returns 1 on success, 0 for an
+ * unknown policy, and -1 if inference left a move at -1, which stops the
+ * tournament. */
+int PlayTournament(pyhanabi_game_t* game, const char** policies,
+                   int num_entrants, pyhanabi_inference_fn inference,
+                   void** contexts, int num_decks, int num_threads,
+                   int games_per_thread, unsigned long long seed,
+                   int* scores);
+
+/* Shared ring functions. A ring is a file mapping that actor processes
+ * publish fixed-size slots to and a single learner process reads in place.
+ * Timeouts are in microseconds, negative to wait forever. */
+/* Creates the ring at path if num_slots > 0, and opens it otherwise. */
+void NewSharedRing(const char* path, int num_slots, int slot_bytes,
+                   pyhanabi_shared_ring_t* ring);
+void DeleteSharedRing(pyhanabi_shared_ring_t* ring);
+int SharedRingNumSlots(pyhanabi_shared_ring_t* ring);
+int SharedRingSlotBytes(pyhanabi_shared_ring_t* ring);
+/* Both push functions return 0 on timeout. */
+int SharedRingPush(pyhanabi_shared_ring_t* ring, const unsigned char* data,
+                   int size, long long timeout_us);
+/* Slot size for a transition with the given packed sizes. */
+int SharedRingTransitionBytes(int observation_bytes, int legal_action_bytes);
+/* Publishes a transition as its stream, action, reward and terminal as
+ * 32-bit values, then the packed observation and legal actions. */
+int SharedRingPushTransition(pyhanabi_shared_ring_t* ring, int stream,
+                             const unsigned char* observation,
+                             int observation_bytes, int action, float reward,
+                             int terminal, const unsigned char* legal_actions,
+                             int legal_action_bytes, long long timeout_us);
+/* Points *slots at the next run of published slots and returns its length,
+ * at most max_slots, or 0 on timeout. */
+int SharedRingPeek(pyhanabi_shared_ring_t* ring, int max_slots,
+                   long long timeout_us, const unsigned char** slots);
+void SharedRingRelease(pyhanabi_shared_ring_t* ring, int num_slots);
+
+/* Uid-based functions. Moves are passed as move uids and results are written
+ * to caller-provided arrays, so no handles are created and nothing needs to
+ * be deleted. Move arrays must hold StateMaxMoves(state) entries. */
+int StateMaxMoves(pyhanabi_state_t* state);
+int StateLegalMoveUids(pyhanabi_state_t* state, int* move_uids);
+void StateLegalMoveMask(pyhanabi_state_t* state, unsigned char* mask);
+void StateApplyMoveUid(pyhanabi_state_t* state, int move_uid);
+int StateMoveHistoryEntries(pyhanabi_state_t* state, int start,
+                            int max_entries,
+                            pyhanabi_history_entry_t* entries);
+int ObsLegalMoveUids(pyhanabi_observation_t* observation, int* move_uids);
+int ObsLastMoveEntries(pyhanabi_observation_t* observation, int max_entries,
+                       pyhanabi_history_entry_t* entries);
+/* Applies move_uids[i] to states[i], skipping states with a negative uid.
+ * If deal_cards, then resolves chance until a player is to act. */
+void StatesApplyMoveUids(pyhanabi_state_t* states, int num_states,
+                         const int* move_uids, int deal_cards);
+/* Writes num_states * MaxMoves(game) bytes, one legal move mask per state. */
+void StatesLegalMoveMasks(pyhanabi_state_t* states, int num_states,
+                          unsigned char* masks);
+/* Fills any non-NULL array with one value per state. */
+void StatesStatus(pyhanabi_state_t* states, int num_states, int* cur_players,
+                  int* end_of_game_status, int* scores);
+/* Writes the move uid that the built-in policy named policy ("random",
+ * "simple", "hint_playable" or "safe_discard") picks for the player to act
+ * in each state, or -1 for states where no player acts. State i draws from
+ * HanabiRng(seed, i, its history length). Returns 0 for an unknown policy. */
+int StatesPolicyMoveUids(const char* policy, pyhanabi_state_t* states,
+                         int num_states, unsigned long long seed,
+                         int* move_uids);
+
+/* Instrumentation functions. Only report data when the library was built
+ * with HANABI_INSTRUMENTATION. */
+int InstrumentationAvailable();
+char* InstrumentationDump(int json);
+void InstrumentationReset();
 
 } /* extern "C" */
 
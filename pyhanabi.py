@@ -17,6 +17,7 @@ import os
 import re
 import cffi
 import enum
+import itertools
 import sys
 
 DEFAULT_CDEF_PREFIXES = (None, ".", os.path.dirname(__file__), "/include")
@@ -114,6 +115,25 @@ def lib_loaded():
   return lib_loaded_flag
 
 
+def instrumentation_report(json=False):
+  """Returns per-probe call counts and cycle histograms of the engine.
+
+  Only populated when the library was built with HANABI_INSTRUMENTATION.
+
+  Args:
+    json: if True, return a JSON document instead of a text table.
+  """
+  c_string = lib.InstrumentationDump(json)
+  string = encode_ffi_string(c_string)
+  lib.DeleteString(c_string)
+  return string
+
+
+def reset_instrumentation():
+  """Zeroes all instrumentation counters."""
+  lib.InstrumentationReset()
+
+
 def color_idx_to_char(color_idx):
   """Helper function for converting color index to a character.
 
@@ -502,27 +522,45 @@ class HanabiState(object):
   Python wrapper of C++ HanabiState class.
   """
 
-  def __init__(self, game, c_state=None):
+  def __init__(self, game, c_state=None, stream=None):
     """Returns a new state.
 
     Args:
       game: HanabiGame describing the parameters for a game of Hanabi.
       c_state: C++ state to copy, or None for a new state.
+      stream: optional (seed, env_id, episode_id) tuple identifying the random
+        stream of a new state. The same tuple always gives the same game.
 
-    NOTE: If c_state is supplied, game is ignored and c_state game is used.
+    NOTE: If c_state is supplied, it is copied and game may be None, in which
+    case the parent game of c_state is used.
     """
     self._state = ffi.new("pyhanabi_state_t*")
     if c_state is None:
       self._game = game.c_game
-      lib.NewState(self._game, self._state)
+      if stream is None:
+        lib.NewState(self._game, self._state)
+      else:
+        seed, env_id, episode_id = stream
+        lib.NewStateFromStream(self._game, seed, env_id, episode_id,
+                               self._state)
+    elif game is not None:
+      self._game = game.c_game
+      lib.CopyState(c_state, self._state)
     else:
-      self._game = lib.StateParentGame(c_state)
+      # Borrowed handle to the parent game, which is never deleted here.
+      self._game = ffi.new("pyhanabi_game_t*")
+      self._game.game = ffi.cast("void*", lib.StateParentGame(c_state))
       lib.CopyState(c_state, self._state)
 
   def copy(self):
     """Returns a copy of the state."""
     return HanabiState(None, self._state)
 
+  @property
+  def c_state(self):
+    """Return the C++ HanabiState object."""
+    return self._state
+
   def observation(self, player):
     """Returns player's observed view of current environment state."""
     return HanabiObservation(self._state, self._game, player)
@@ -606,6 +644,66 @@ class HanabiState(object):
     lib.DeleteMoveList(c_movelist)
     return moves
 
+  def legal_move_uids(self):
+    """Returns the uids of the legal moves for the acting player, in order.
+
+    Unlike legal_moves(), this creates no C++ objects.
+    """
+    uids = ffi.new("int[]", lib.StateMaxMoves(self._state))
+    num_moves = lib.StateLegalMoveUids(self._state, uids)
+    return list(uids[0:num_moves])
+
+  def legal_moves_mask(self):
+    """Returns bytes with a 1 at the uid of every legal move, else 0."""
+    mask = ffi.new("unsigned char[]", lib.StateMaxMoves(self._state))
+    lib.StateLegalMoveMask(self._state, mask)
+    return ffi.buffer(mask)[:]
+
+  def apply_move_uid(self, move_uid):
+    """Advance the environment state by the move with uid move_uid."""
+    lib.StateApplyMoveUid(self._state, move_uid)
+
+  def step_encoded(self, encoder, move_uid, observations, legal_mask,
+                   stacker=None):
+    """Applies a move and writes the resulting observations into arrays.
+
+    Applies move_uid unless it is negative, and deals cards until a player
+    acts, so a new state can be passed with move_uid -1.
+
+    Args:
+      encoder: ObservationEncoder of the canonical type.
+      move_uid: uid of the move to apply, or -1 to only write the arrays.
+      observations: writable float32 buffer of num_players() *
+        encoder.encoding_length() values, filled with every player's encoded
+        observation.
+      legal_mask: writable uint8 buffer of max_moves() values, filled with the
+        legal moves of the acting player (all zero once the game is over).
+      stacker: optional ObservationStacker, to which the acting player's
+        observation is appended. It is reset when move_uid is -1, and at the
+        first append after the game is over, so it keeps the finished game's
+        histories until then.
+
+    Returns:
+      Tuple of the score change, whether the game is over, and cur_player().
+    """
+    c_observations = ffi.from_buffer("float[]", observations,
+                                     require_writable=True)
+    c_legal_mask = ffi.from_buffer("unsigned char[]", legal_mask,
+                                   require_writable=True)
+    assert (len(c_observations) >=
+            self.num_players() * encoder.encoding_length())
+    assert len(c_legal_mask) >= lib.StateMaxMoves(self._state)
+    status = ffi.new("int[3]")
+    if stacker is None:
+      lib.StateStepEncoded(self._state, encoder.c_encoder, move_uid,
+                           c_observations, c_legal_mask, status, status + 1,
+                           status + 2)
+    else:
+      lib.StateStepStacked(self._state, encoder.c_encoder, stacker.c_stacker,
+                           move_uid, c_observations, c_legal_mask, status,
+                           status + 1, status + 2)
+    return status[0], bool(status[1]), status[2]
+
   def move_is_legal(self, move):
     """Returns true if and only if move is legal for active agent."""
     return lib.MoveIsLegal(self._state, move.c_move)
@@ -644,6 +742,17 @@ class HanabiState(object):
       history.append(HanabiHistoryItem(c_history_item))
     return history
 
+  def move_history_entries(self, start=0):
+    """Returns moves made from index start on, as plain records.
+
+    The result is a cffi array of pyhanabi_history_entry_t, filled by a single
+    call, whose fields mirror HanabiHistoryItem. move_uid is -1 for deals.
+    """
+    num_entries = max(lib.StateLenMoveHistory(self._state) - start, 0)
+    entries = ffi.new("pyhanabi_history_entry_t[]", num_entries)
+    lib.StateMoveHistoryEntries(self._state, start, num_entries, entries)
+    return entries
+
   def __str__(self):
     c_string = lib.StateToString(self._state)
     string = encode_ffi_string(c_string)
@@ -660,6 +769,63 @@ class HanabiState(object):
     del self
 
 
+def _c_states(states):
+  """Returns a C array of the handles of a list of HanabiState."""
+  return ffi.new("pyhanabi_state_t[]", [state.c_state[0] for state in states])
+
+
+def apply_move_uids(states, move_uids, deal_cards=True):
+  """Applies move_uids[i] to states[i] in one call.
+
+  Args:
+    states: list of HanabiState.
+    move_uids: one uid per state. States with a negative uid are skipped.
+    deal_cards: whether to deal random cards afterwards until a player acts.
+  """
+  assert len(states) == len(move_uids)
+  lib.StatesApplyMoveUids(_c_states(states), len(states),
+                          ffi.new("int[]", list(move_uids)), deal_cards)
+
+
+def legal_move_masks(states):
+  """Returns bytes holding the legal_moves_mask() of every state in turn."""
+  num_bytes = sum(lib.StateMaxMoves(state.c_state) for state in states)
+  masks = ffi.new("unsigned char[]", num_bytes)
+  lib.StatesLegalMoveMasks(_c_states(states), len(states), masks)
+  return ffi.buffer(masks)[:]
+
+
+def policy_move_uids(states, policy, seed=0):
+  """Returns the move uid that a native policy picks in each state.
+
+  Args:
+    states: list of HanabiState.
+    policy: "random", "simple", "hint_playable" or "safe_discard".
+    seed: seed of the random choices.
+
+  Returns:
+    One uid per state, -1 where no player is to act. Pass it to
+    apply_move_uids().
+  """
+  move_uids = ffi.new("int[]", len(states))
+  if not lib.StatesPolicyMoveUids(policy.encode("ascii"), _c_states(states),
+                                  len(states), seed, move_uids):
+    raise ValueError("Unknown policy {}".format(policy))
+  return list(move_uids)
+
+
+def states_status(states):
+  """Returns lists of the current player, end status and score of states."""
+  num_states = len(states)
+  cur_players = ffi.new("int[]", num_states)
+  end_status = ffi.new("int[]", num_states)
+  scores = ffi.new("int[]", num_states)
+  lib.StatesStatus(_c_states(states), num_states, cur_players, end_status,
+                   scores)
+  return (list(cur_players), [HanabiEndOfGameType(s) for s in end_status],
+          list(scores))
+
+
 class AgentObservationType(enum.IntEnum):
   """Possible agent observation types, consistent with hanabi_game.h.
 
@@ -711,8 +877,9 @@ class HanabiGame(object):
       self._game = ffi.new("pyhanabi_game_t*")
       lib.NewGame(self._game, len(param_list), c_array)
 
-  def new_initial_state(self):
-    return HanabiState(self)
+  def new_initial_state(self, stream=None):
+    """Returns a new state, see HanabiState for the stream argument."""
+    return HanabiState(self, stream=stream)
 
   @property
   def c_game(self):
@@ -897,6 +1064,13 @@ class HanabiObservation(object):
       history_items.append(HanabiHistoryItem(history_item))
     return history_items
 
+  def last_move_entries(self):
+    """Returns last_moves() as a cffi array of pyhanabi_history_entry_t."""
+    num_entries = lib.ObsNumLastMoves(self._observation)
+    entries = ffi.new("pyhanabi_history_entry_t[]", num_entries)
+    lib.ObsLastMoveEntries(self._observation, num_entries, entries)
+    return entries
+
   def information_tokens(self):
     """Returns the number of information tokens remaining."""
     return lib.ObsInformationTokens(self._observation)
@@ -917,6 +1091,12 @@ class HanabiObservation(object):
       moves.append(HanabiMove(move))
     return moves
 
+  def legal_move_uids(self):
+    """Returns the uids of legal_moves(), without creating C++ objects."""
+    uids = ffi.new("int[]", lib.MaxMoves(self._game))
+    num_moves = lib.ObsLegalMoveUids(self._observation, uids)
+    return list(uids[0:num_moves])
+
   def card_playable_on_fireworks(self, color, rank):
     """Returns true if and only if card can be successfully played.
 
@@ -960,16 +1140,722 @@ class ObservationEncoder(object):
     shape = [int(x) for x in shape_string.split(",")]
     return shape
 
+  @property
+  def c_encoder(self):
+    """Return the C++ ObservationEncoder object."""
+    return self._encoder
+
+  def encoding_length(self):
+    """Returns the number of values in one encoded observation."""
+    return lib.ObservationEncodingLength(self._encoder)
+
   def encode(self, observation):
-    """Encode the observation as a sequence of bits."""
-    c_encoding_str = lib.EncodeObservation(self._encoder,
-                                           observation.observation())
-    encoding_string = encode_ffi_string(c_encoding_str)
-    lib.DeleteString(c_encoding_str)
-    # Canonical observations are bit strings, so it is ok to encode using a
-    # string. For float or double observations, make a custom object
-    encoding = [int(x) for x in encoding_string.split(",")]
-    return encoding
+    """Encode the observation as a list of floats."""
+    encoding = ffi.new("float[]", self.encoding_length())
+    lib.EncodeObservationsInto(self._encoder, observation.observation(), 1,
+                               False, ffi.NULL, ffi.NULL, False, encoding,
+                               ffi.NULL)
+    return list(encoding)
+
+  def encode_into(self, observations, out, show_own_cards=False, orders=None,
+                  color_permutes=None, hide_action=False, packed=False,
+                  legal_masks=None):
+    """Encodes a batch of observations into a caller-owned buffer.
+
+    Args:
+      observations: list of HanabiObservation.
+      out: writable buffer, e.g. a C-contiguous numpy array. Unless packed,
+        it holds len(observations) * encoding_length() float32 values;
+        otherwise (encoding_length() + 7) // 8 uint8 per observation, with
+        each value stored as the bit value > 0 (see numpy.unpackbits).
+      show_own_cards: whether to encode the observer's own cards.
+      orders: optional card order of the other hands, one list of
+        hand_size() indices per observation.
+      color_permutes: optional color permutation, one list of num_colors()
+        colors per observation.
+      hide_action: whether to leave the last action section empty.
+      packed: whether to write bit-packed uint8 rows instead of float32.
+      legal_masks: optional writable buffer of len(observations) *
+        max_moves() uint8 values, filled with each observing player's legal
+        move mask, indexed by move uid.
+    """
+    num_observations = len(observations)
+    c_observations = ffi.new("pyhanabi_observation_t[]",
+                             [obs.observation()[0] for obs in observations])
+    c_orders = ffi.NULL
+    if orders is not None:
+      c_orders = ffi.new("int[]", [i for order in orders for i in order])
+    c_color_permutes = ffi.NULL
+    if color_permutes is not None:
+      c_color_permutes = ffi.new(
+          "int[]", [c for permute in color_permutes for c in permute])
+    c_legal_masks = ffi.NULL
+    if legal_masks is not None:
+      c_legal_masks = ffi.from_buffer("unsigned char[]", legal_masks,
+                                      require_writable=True)
+      assert len(c_legal_masks) >= num_observations * lib.MaxMoves(self._game)
+    if packed:
+      row_size = (self.encoding_length() + 7) // 8
+      c_out = ffi.from_buffer("unsigned char[]", out, require_writable=True)
+      assert len(c_out) >= num_observations * row_size
+      lib.EncodeObservationsPacked(self._encoder, c_observations,
+                                   num_observations, show_own_cards, c_orders,
+                                   c_color_permutes, hide_action, c_out,
+                                   c_legal_masks)
+    else:
+      c_out = ffi.from_buffer("float[]", out, require_writable=True)
+      assert len(c_out) >= num_observations * self.encoding_length()
+      lib.EncodeObservationsInto(self._encoder, c_observations,
+                                 num_observations, show_own_cards, c_orders,
+                                 c_color_permutes, hide_action, c_out,
+                                 c_legal_masks)
+
+
+  def encode_color_permutations(self, observation, color_permutes, out,
+                                show_own_cards=False, order=None,
+                                hide_action=False):
+    """Encodes one observation under several color permutations.
+
+    Same result as encode_into() with the observation repeated once per
+    permutation, but the observation is only encoded once.
+
+    Args:
+      observation: HanabiObservation.
+      color_permutes: list of K color permutations of num_colors() colors.
+      out: writable buffer of K * encoding_length() float32 values.
+      show_own_cards: whether to encode the observer's own cards.
+      order: optional card order of the other hands (hand_size() indices).
+      hide_action: whether to leave the last action section empty.
+    """
+    num_permutations = len(color_permutes)
+    c_color_permutes = ffi.new(
+        "int[]", [c for permute in color_permutes for c in permute])
+    c_order = ffi.NULL if order is None else ffi.new("int[]", list(order))
+    c_out = ffi.from_buffer("float[]", out, require_writable=True)
+    assert len(c_out) >= num_permutations * self.encoding_length()
+    lib.EncodeObservationColorPermutations(
+        self._encoder, observation.observation(), show_own_cards, c_order,
+        num_permutations, c_color_permutes, hide_action, c_out)
+
+
+class SequenceReplay(object):
+  """Native prioritized replay of overlapping step sequences.
+
+  Steps are added per stream, one stream per player of each environment,
+  and cut into sequences of sequence_length steps, consecutive ones sharing
+  overlap steps. The end of an episode closes the current sequence early,
+  padded with zeros, and drops it if it has at most burn_in steps, which
+  would all be used to warm up the recurrent state. New sequences get the
+  largest priority seen so far.
+  """
+
+  def __init__(self, num_streams, observation_size, num_actions,
+               sequence_length, overlap, burn_in, capacity, seed=0):
+    self._observation_size = observation_size
+    self._num_actions = num_actions
+    self._sequence_length = sequence_length
+    self._replay = ffi.new("pyhanabi_sequence_replay_t*")
+    lib.NewSequenceReplay(num_streams, observation_size, num_actions,
+                          sequence_length, overlap, burn_in, capacity, seed,
+                          self._replay)
+
+  @property
+  def add_count(self):
+    """Number of sequences stored so far, including overwritten ones."""
+    return lib.SequenceReplayAddCount(self._replay)
+
+  def add_steps(self, streams, observations, legal_masks, actions, rewards,
+                terminals):
+    """Appends one step to each of the given streams.
+
+    Args:
+      streams: int32 buffer of N stream ids.
+      observations: float32 buffer of N * observation_size values, e.g. rows
+        written by HanabiState.step_encoded().
+      legal_masks: uint8 buffer of N * num_actions legal move masks.
+      actions: int32 buffer of the N actions taken.
+      rewards: float32 buffer of the N rewards that followed.
+      terminals: uint8 buffer, 1 where the step ended the episode.
+    """
+    c_streams = ffi.from_buffer("int[]", streams)
+    num_steps = len(c_streams)
+    c_observations = ffi.from_buffer("float[]", observations)
+    c_legal_masks = ffi.from_buffer("unsigned char[]", legal_masks)
+    c_actions = ffi.from_buffer("int[]", actions)
+    c_rewards = ffi.from_buffer("float[]", rewards)
+    c_terminals = ffi.from_buffer("unsigned char[]", terminals)
+    assert len(c_observations) >= num_steps * self._observation_size
+    assert len(c_legal_masks) >= num_steps * self._num_actions
+    assert len(c_actions) >= num_steps and len(c_rewards) >= num_steps
+    assert len(c_terminals) >= num_steps
+    lib.SequenceReplayAddSteps(self._replay, num_steps, c_streams,
+                               c_observations, c_legal_masks, c_actions,
+                               c_rewards, c_terminals)
+
+  def sample(self, observations, actions, rewards, terminals, legal_masks,
+             lengths, indices, probabilities):
+    """Fills caller buffers with a batch of sequences.
+
+    The batch size is len(lengths). observations is float32 of shape (batch,
+    sequence_length, observation_size), actions int32, rewards float32 and
+    terminals uint8 of shape (batch, sequence_length), legal_masks uint8 of
+    shape (batch, sequence_length, num_actions); lengths and indices are
+    int32 and probabilities float32 of shape (batch).
+    """
+    c_lengths = ffi.from_buffer("int[]", lengths, require_writable=True)
+    batch_size = len(c_lengths)
+    steps = batch_size * self._sequence_length
+    c_observations = ffi.from_buffer("float[]", observations,
+                                     require_writable=True)
+    c_legal_masks = ffi.from_buffer("unsigned char[]", legal_masks,
+                                    require_writable=True)
+    assert len(c_observations) >= steps * self._observation_size
+    assert len(c_legal_masks) >= steps * self._num_actions
+    if not lib.SequenceReplaySample(
+        self._replay, batch_size, c_observations,
+        ffi.from_buffer("int[]", actions, require_writable=True),
+        ffi.from_buffer("float[]", rewards, require_writable=True),
+        ffi.from_buffer("unsigned char[]", terminals, require_writable=True),
+        c_legal_masks, c_lengths,
+        ffi.from_buffer("int[]", indices, require_writable=True),
+        ffi.from_buffer("float[]", probabilities, require_writable=True)):
+      raise Exception("Cannot sample from an empty sequence replay.")
+
+  def set_priorities(self, indices, priorities):
+    """Sets priorities from an int32 and a float32 buffer, in one update."""
+    c_indices = ffi.from_buffer("int[]", indices)
+    c_priorities = ffi.from_buffer("float[]", priorities)
+    assert len(c_priorities) >= len(c_indices)
+    lib.SequenceReplaySetPriorities(self._replay, len(c_indices), c_indices,
+                                    c_priorities)
+
+  def __del__(self):
+    if self._replay is not None:
+      lib.DeleteSequenceReplay(self._replay)
+      self._replay = None
+    del self
+
+
+class RecordReplay(object):
+  """Replay memory of whole games, re-encoded when sampled.
+
+  Games are stored as compact game records (deal order and move uids).
+  Sampled timesteps are replayed and encoded with the canonical encoder on
+  num_threads threads. Timestep t of a game is the state before its t-th
+  player move, seen by the player making it.
+  """
+
+  def __init__(self, game, capacity, num_threads=1, seed=0):
+    self._max_moves = game.max_moves()
+    self._replay = ffi.new("pyhanabi_record_replay_t*")
+    lib.NewRecordReplay(game.c_game, capacity, num_threads, seed,
+                        self._replay)
+
+  def encoding_length(self):
+    """Returns the length of one encoded observation."""
+    return lib.RecordReplayEncodingLength(self._replay)
+
+  @property
+  def add_count(self):
+    """Number of games added so far, including overwritten ones."""
+    return lib.RecordReplayAddCount(self._replay)
+
+  def num_timesteps(self):
+    """Number of timesteps in the stored games."""
+    return lib.RecordReplayNumTimesteps(self._replay)
+
+  def add_game(self, state):
+    """Stores the game played so far in state and returns its id, or -1 if
+    no player move was made."""
+    return lib.RecordReplayAddState(self._replay, state.c_state)
+
+  def sample(self, game_ids, steps, observations, legal_masks, actions,
+             rewards, terminals, next_observations):
+    """Fills caller buffers with uniformly sampled timesteps.
+
+    The batch size is len(steps). game_ids is int64 and steps, actions are
+    int32 of shape (batch); observations and next_observations (the acting
+    player's view after the move) are float32 of shape (batch, encoding
+    length); legal_masks is uint8 of shape (batch, max_moves()); rewards is
+    float32 and terminals uint8 of shape (batch).
+    """
+    if not self._fill(True, game_ids, steps, observations, legal_masks,
+                      actions, rewards, terminals, next_observations):
+      raise Exception("Cannot sample from an empty record replay.")
+
+  def encode(self, game_ids, steps, observations, legal_masks, actions,
+             rewards, terminals, next_observations):
+    """Like sample(), but encodes the timesteps given in game_ids and
+    steps."""
+    self._fill(False, game_ids, steps, observations, legal_masks, actions,
+               rewards, terminals, next_observations)
+
+  def _fill(self, sample, game_ids, steps, observations, legal_masks,
+            actions, rewards, terminals, next_observations):
+    c_steps = ffi.from_buffer("int[]", steps, require_writable=sample)
+    batch_size = len(c_steps)
+    c_observations = ffi.from_buffer("float[]", observations,
+                                     require_writable=True)
+    c_next_observations = ffi.from_buffer("float[]", next_observations,
+                                          require_writable=True)
+    c_legal_masks = ffi.from_buffer("unsigned char[]", legal_masks,
+                                    require_writable=True)
+    assert len(c_observations) >= batch_size * self.encoding_length()
+    assert len(c_next_observations) >= batch_size * self.encoding_length()
+    assert len(c_legal_masks) >= batch_size * self._max_moves
+    return lib.RecordReplayFill(
+        self._replay, batch_size, sample,
+        ffi.from_buffer("long long[]", game_ids, require_writable=sample),
+        c_steps, c_observations, c_legal_masks,
+        ffi.from_buffer("int[]", actions, require_writable=True),
+        ffi.from_buffer("float[]", rewards, require_writable=True),
+        ffi.from_buffer("unsigned char[]", terminals, require_writable=True),
+        c_next_observations)
+
+  def __del__(self):
+    if self._replay is not None:
+      lib.DeleteRecordReplay(self._replay)
+      self._replay = None
+    del self
+
+
+class ActorPipeline(object):
+  """Plays games on native worker threads with batched move selection.
+
+  num_threads x games_per_thread games are stepped natively. Their move
+  requests are batched and answered by a single call to
+  inference(observations, legal_masks, moves) on the thread calling run().
+  The arguments are buffers of batch_size x encoding_length() float32,
+  batch_size x game.max_moves() uint8, and batch_size int32 that inference
+  fills with legal move uids (e.g. wrap them with numpy.frombuffer). A
+  batch is flushed when full or timeout_us after its first request, and
+  workers keep stepping the other games meanwhile. Finished games are added
+  to records if a RecordReplay is given.
+  """
+
+  def __init__(self, game, inference, num_threads=1, games_per_thread=32,
+               batch_size=32, timeout_us=100, seed=0, records=None):
+    self._max_moves = game.max_moves()
+    self._inference = inference
+    self._callback = ffi.callback(
+        "void(void*, int, const float*, const unsigned char*, int*)",
+        self._on_batch)
+    # Keeps the replay alive as long as the pipeline may add to it.
+    self._records = records
+    self._pipeline = ffi.new("pyhanabi_actor_pipeline_t*")
+    lib.NewActorPipeline(
+        game.c_game, num_threads, games_per_thread, batch_size, timeout_us,
+        seed, self._callback, ffi.NULL,
+        ffi.NULL if records is None else records._replay, self._pipeline)
+    self._encoding_length = lib.ActorPipelineEncodingLength(self._pipeline)
+
+  def encoding_length(self):
+    """Returns the length of one encoded observation."""
+    return self._encoding_length
+
+  def run(self, num_moves):
+    """Plays until at least num_moves moves were chosen. Games in progress
+    carry over to the next call.
+
+    Returns a dict with the number of moves, finished games, their total
+    score and inference calls.
+    """
+    stats = ffi.new("long long[4]")
+    lib.ActorPipelineRun(self._pipeline, num_moves, stats)
+    return {"moves": stats[0], "games": stats[1], "total_score": stats[2],
+            "batches": stats[3]}
+
+  def _on_batch(self, context, batch_size, observations, legal_masks, moves):
+    del context
+    self._inference(
+        ffi.buffer(observations, 4 * batch_size * self._encoding_length),
+        ffi.buffer(legal_masks, batch_size * self._max_moves),
+        ffi.buffer(moves, 4 * batch_size))
+
+  def __del__(self):
+    if self._pipeline is not None:
+      lib.DeleteActorPipeline(self._pipeline)
+      self._pipeline = None
+    del self
+
+
+def play_tournament(game, entrants, num_decks, num_threads=1,
+                    games_per_thread=64, seed=0):
+  """Plays every lineup of entrants on the same num_decks decks.
+
+  Args:
+    game: HanabiGame.
+    entrants: list of built-in policy names ("random", "simple",
+      "hint_playable" or "safe_discard") or batched policies. A batched
+      policy is called as inference(observations, legal_masks, moves) with
+      buffers as in ActorPipeline, from the tournament threads, so it may
+      run concurrently when num_threads > 1.
+    num_decks: number of decks, shuffled from seed.
+    num_threads: number of native threads.
+    games_per_thread: games each thread keeps running, i.e. the largest
+      batch passed to a batched policy.
+    seed: seed of the decks and of the built-in policies.
+
+  Returns:
+    Tuple of the lineups, i.e. tuples of entrant indices per seat in
+    lexicographic order, and a list of num_decks scores per lineup.
+
+  Raises:
+    The first exception raised by a batched policy, which stops the
+    tournament.
+  """
+  encoding_length = ObservationEncoder(game).encoding_length()
+  max_moves = game.max_moves()
+
+  errors = []
+
+  def on_batch(context, batch_size, observations, legal_masks, moves):
+    try:
+      ffi.from_handle(context)(
+          ffi.buffer(observations, 4 * batch_size * encoding_length),
+          ffi.buffer(legal_masks, batch_size * max_moves),
+          ffi.buffer(moves, 4 * batch_size))
+    except Exception as error:
+      # Exceptions cannot cross the C++ frames; -1 moves stop the tournament
+      # and the error is raised once PlayTournament returns.
+      errors.append(error)
+      for i in range(batch_size):
+        moves[i] = -1
+
+  callback = ffi.callback(
+      "void(void*, int, const float*, const unsigned char*, int*)", on_batch)
+  # Keeps the names and handles alive during the call.
+  names = [ffi.new("char[]", entrant.encode("ascii"))
+           if isinstance(entrant, str) else ffi.NULL for entrant in entrants]
+  handles = [ffi.NULL if isinstance(entrant, str) else
+             ffi.new_handle(entrant) for entrant in entrants]
+  lineups = list(itertools.product(range(len(entrants)),
+                                   repeat=game.num_players()))
+  scores = ffi.new("int[]", len(lineups) * num_decks)
+  status = lib.PlayTournament(
+      game.c_game, ffi.new("const char*[]", names), len(entrants), callback,
+      ffi.new("void*[]", handles), num_decks, num_threads, games_per_thread,
+      seed, scores)
+  if status == 0:
+    raise ValueError("Unknown policy in {}".format(entrants))
+  if status < 0:
+    if errors:
+      raise errors[0]
+    raise ValueError("A batched policy left a move unanswered")
+  return lineups, [list(scores[l * num_decks:(l + 1) * num_decks])
+                   for l in range(len(lineups))]
+
+
+class SharedRing(object):
+  """Shared-memory ring for sending trajectories between processes.
+
+  The learner creates the ring file with num_slots (a power of two) slots of
+  slot_bytes (a multiple of 8) bytes each; actors open it by path. Actors
+  push slots, and the single learner peeks at published slots in place and
+  releases them. Timeouts are in microseconds, negative to wait forever.
+  """
+
+  def __init__(self, path, num_slots=0, slot_bytes=0):
+    self._ring = ffi.new("pyhanabi_shared_ring_t*")
+    lib.NewSharedRing(path.encode("ascii"), num_slots, slot_bytes,
+                      self._ring)
+    self._slot_bytes = lib.SharedRingSlotBytes(self._ring)
+    self._slots = ffi.new("const unsigned char**")
+
+  @staticmethod
+  def transition_bytes(observation_bytes, legal_action_bytes):
+    """Slot size for push_transition() with the given packed sizes."""
+    return lib.SharedRingTransitionBytes(observation_bytes,
+                                         legal_action_bytes)
+
+  def num_slots(self):
+    return lib.SharedRingNumSlots(self._ring)
+
+  def slot_bytes(self):
+    return self._slot_bytes
+
+  def push(self, data, timeout_us=-1):
+    """Publishes the bytes of data in one slot. Returns False on timeout."""
+    c_data = ffi.from_buffer("unsigned char[]", data)
+    return bool(lib.SharedRingPush(self._ring, c_data, len(c_data),
+                                   timeout_us))
+
+  def push_transition(self, stream, observation, action, reward, terminal,
+                      legal_actions, timeout_us=-1):
+    """Publishes a transition in PrioritizedReplayMemory's packed format.
+
+    The slot holds stream, action, reward (float32) and terminal as 32-bit
+    values, then the packed observation and the packed legal actions.
+    Returns False on timeout.
+    """
+    c_observation = ffi.from_buffer("unsigned char[]", observation)
+    c_legal_actions = ffi.from_buffer("unsigned char[]", legal_actions)
+    return bool(lib.SharedRingPushTransition(
+        self._ring, stream, c_observation, len(c_observation), action,
+        reward, terminal, c_legal_actions, len(c_legal_actions), timeout_us))
+
+  def peek(self, max_slots, timeout_us=-1):
+    """Returns the next published slots as one buffer of
+    n x slot_bytes() bytes, 1 <= n <= max_slots, or None on timeout.
+
+    The buffer aliases the ring and is valid until release(n).
+    """
+    n = lib.SharedRingPeek(self._ring, max_slots, timeout_us, self._slots)
+    if n == 0:
+      return None
+    return ffi.buffer(self._slots[0], n * self._slot_bytes)
+
+  def release(self, num_slots):
+    """Hands the oldest num_slots peeked slots back to the producers."""
+    lib.SharedRingRelease(self._ring, num_slots)
+
+  def __del__(self):
+    if self._ring is not None:
+      lib.DeleteSharedRing(self._ring)
+      self._ring = None
+    del self
+
+
+class ObservationStacker(object):
+  """History of the last history_size observations of each player.
+
+  Stacks are kept in native ring buffers, so adding an observation copies
+  one observation rather than the whole stack.
+  """
+
+  def __init__(self, num_players, history_size, observation_size):
+    self._observation_size = observation_size
+    self._stack_size = history_size * observation_size
+    self._stacker = ffi.new("pyhanabi_observation_stacker_t*")
+    lib.NewObservationStacker(num_players, history_size, observation_size,
+                              self._stacker)
+
+  @property
+  def c_stacker(self):
+    return self._stacker
+
+  def stack_size(self):
+    """Returns history_size * observation_size."""
+    return self._stack_size
+
+  def reset(self):
+    """Clears every stack to zeros."""
+    lib.ObservationStackerReset(self._stacker)
+
+  def add(self, player, observation):
+    """Appends a float32 buffer of observation_size values to a stack."""
+    c_observation = ffi.from_buffer("float[]", observation)
+    assert len(c_observation) >= self._observation_size
+    lib.ObservationStackerAdd(self._stacker, player, c_observation)
+
+  def view(self, player):
+    """Returns the stack of player, oldest observation first, as a buffer of
+    stack_size() float32 values. The buffer aliases the stacker's memory
+    and is only valid until the stacker is next changed."""
+    return ffi.buffer(lib.ObservationStackerView(self._stacker, player),
+                      4 * self._stack_size)
+
+  def copy(self, player, out):
+    """Writes the stack of player, oldest observation first, to out."""
+    c_out = ffi.from_buffer("float[]", out, require_writable=True)
+    assert len(c_out) >= self._stack_size
+    lib.ObservationStackerCopy(self._stacker, player, c_out)
+
+  def __del__(self):
+    if self._stacker is not None:
+      lib.DeleteObservationStacker(self._stacker)
+      self._stacker = None
+    del self
+
+
+class GameRecordWriter(object):
+  """Appends finished games to a compact binary record file.
+
+  Records are buffered in memory and written by a background thread. A record
+  holds the deal order and move uids, so it can be replayed exactly given the
+  game parameters identified by config_id.
+  """
+
+  def __init__(self, path):
+    self._writer = ffi.new("pyhanabi_game_record_writer_t*")
+    lib.NewGameRecordWriter(ffi.new("char[]", path.encode('ascii')),
+                            self._writer)
+
+  def append(self, state, config_id=0):
+    """Records the history of state, usually a finished game."""
+    lib.GameRecordWriterAppend(self._writer, state.c_state, config_id)
+
+  def flush(self):
+    """Blocks until all appended records are on disk."""
+    lib.GameRecordWriterFlush(self._writer)
+
+  def __del__(self):
+    if self._writer is not None:
+      lib.DeleteGameRecordWriter(self._writer)
+      self._writer = None
+    del self
+
+
+class GameRecordReader(object):
+  """Memory-mapped reader for files written by GameRecordWriter."""
+
+  def __init__(self, path):
+    self._reader = ffi.new("pyhanabi_game_record_reader_t*")
+    lib.NewGameRecordReader(ffi.new("char[]", path.encode('ascii')),
+                            self._reader)
+
+  def __len__(self):
+    return lib.GameRecordReaderNumRecords(self._reader)
+
+  def config_id(self, index):
+    return lib.GameRecordReaderConfigId(self._reader, index)
+
+  def num_moves(self, index):
+    """Returns the number of player moves in record index."""
+    return lib.GameRecordReaderNumMoves(self._reader, index)
+
+  def replay(self, index, game, max_moves=-1):
+    """Returns the state after replaying record index.
+
+    Args:
+      index: record index, in [0, len(self)).
+      game: HanabiGame with the parameters the record was played with.
+      max_moves: if non-negative, stop after this many player moves.
+    """
+    c_state = ffi.new("pyhanabi_state_t*")
+    lib.GameRecordReaderReplay(self._reader, index, game.c_game, max_moves,
+                               c_state)
+    state = HanabiState(game, c_state)
+    lib.DeleteState(c_state)
+    return state
+
+  def __del__(self):
+    if self._reader is not None:
+      lib.DeleteGameRecordReader(self._reader)
+      self._reader = None
+    del self
+
+
+class PrioritizedReplayMemory(object):
+  """Native prioritized replay memory over bit-packed observations.
+
+  Same semantics as the rainbow agent's OutOfGraphPrioritizedReplayMemory.
+  The memory is locked internally, so it may be shared by actor and learner
+  threads.
+  """
+
+  def __init__(self, num_actions, observation_size, stack_size,
+               replay_capacity, update_horizon=1, gamma=1.0, seed=0):
+    self._num_actions = num_actions
+    self._observation_size = observation_size
+    self._stack_size = stack_size
+    self._memory = ffi.new("pyhanabi_replay_memory_t*")
+    lib.NewPrioritizedReplayMemory(num_actions, observation_size, stack_size,
+                                   replay_capacity, update_horizon, gamma,
+                                   seed, self._memory)
+
+  def observation_bytes(self):
+    """Bytes of a packed observation, (observation_size + 7) // 8."""
+    return lib.ReplayMemoryObservationBytes(self._memory)
+
+  def legal_action_bytes(self):
+    """Bytes of a packed legal action mask, (num_actions + 7) // 8."""
+    return lib.ReplayMemoryLegalActionBytes(self._memory)
+
+  @property
+  def add_count(self):
+    return lib.ReplayMemoryAddCount(self._memory)
+
+  def add(self, observation, action, reward, terminal, legal_actions):
+    """Adds a transition with the default priority.
+
+    Args:
+      observation: buffer of observation_bytes() uint8, the observation
+        packed as by numpy.packbits.
+      action: int, the action taken.
+      reward: float, the reward received.
+      terminal: bool, whether the transition ends the episode.
+      legal_actions: buffer of legal_action_bytes() uint8, the packed mask
+        of legal actions.
+    """
+    c_observation = ffi.from_buffer("unsigned char[]", observation)
+    c_legal_actions = ffi.from_buffer("unsigned char[]", legal_actions)
+    assert len(c_observation) >= self.observation_bytes()
+    assert len(c_legal_actions) >= self.legal_action_bytes()
+    lib.ReplayMemoryAdd(self._memory, c_observation, action, reward,
+                        terminal, c_legal_actions)
+
+  def sample_indices(self, indices):
+    """Fills the int32 buffer indices with sampled transition indices."""
+    c_indices = ffi.from_buffer("int[]", indices, require_writable=True)
+    if not lib.ReplayMemorySampleIndices(self._memory, len(c_indices),
+                                         c_indices):
+      raise Exception("Could not sample {} valid transitions".format(
+          len(c_indices)))
+
+  def sample_transitions(self, states, actions, rewards, next_states,
+                         terminals, out_indices, next_legal_actions,
+                         indices=None):
+    """Fills caller buffers with a batch of transitions.
+
+    The batch size is len(actions). states and next_states are uint8 of
+    shape (batch, observation_size, stack_size), actions and out_indices
+    int32, rewards float32, terminals uint8 and next_legal_actions float32
+    of shape (batch, num_actions). If indices is given, reads those
+    transitions instead of sampling.
+    """
+    c_actions = ffi.from_buffer("int[]", actions, require_writable=True)
+    batch_size = len(c_actions)
+    c_states = ffi.from_buffer("unsigned char[]", states,
+                               require_writable=True)
+    c_next_states = ffi.from_buffer("unsigned char[]", next_states,
+                                    require_writable=True)
+    c_next_legal_actions = ffi.from_buffer("float[]", next_legal_actions,
+                                           require_writable=True)
+    stack_bytes = self._observation_size * self._stack_size
+    assert len(c_states) >= batch_size * stack_bytes
+    assert len(c_next_states) >= batch_size * stack_bytes
+    assert len(c_next_legal_actions) >= batch_size * self._num_actions
+    c_indices = (ffi.NULL if indices is None else
+                 ffi.from_buffer("int[]", indices))
+    if not lib.ReplayMemorySampleTransitions(
+        self._memory, batch_size, c_indices, c_states, c_actions,
+        ffi.from_buffer("float[]", rewards, require_writable=True),
+        c_next_states,
+        ffi.from_buffer("unsigned char[]", terminals, require_writable=True),
+        ffi.from_buffer("int[]", out_indices, require_writable=True),
+        c_next_legal_actions):
+      raise Exception("Could not sample {} valid transitions".format(
+          batch_size))
+
+  def set_priorities(self, indices, priorities):
+    """Sets priorities from an int32 and a float32 buffer, in one update."""
+    c_indices = ffi.from_buffer("int[]", indices)
+    c_priorities = ffi.from_buffer("float[]", priorities)
+    assert len(c_priorities) >= len(c_indices)
+    lib.ReplayMemorySetPriorities(self._memory, len(c_indices), c_indices,
+                                  c_priorities)
+
+  def get_priorities(self, indices, priorities):
+    """Fills the float32 buffer priorities with those of int32 indices."""
+    c_indices = ffi.from_buffer("int[]", indices)
+    c_priorities = ffi.from_buffer("float[]", priorities,
+                                   require_writable=True)
+    assert len(c_priorities) >= len(c_indices)
+    lib.ReplayMemoryGetPriorities(self._memory, len(c_indices), c_indices,
+                                  c_priorities)
+
+  def save(self, path):
+    lib.ReplayMemorySave(self._memory, ffi.new("char[]", path.encode('ascii')))
+
+  def load(self, path):
+    lib.ReplayMemoryLoad(self._memory, ffi.new("char[]", path.encode('ascii')))
+
+  def __del__(self):
+    if self._memory is not None:
+      lib.DeletePrioritizedReplayMemory(self._memory)
+      self._memory = None
+    del self
 
 
 try_cdef()
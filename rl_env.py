@@ -16,6 +16,7 @@
 from __future__ import absolute_import
 from __future__ import division
 
+import numpy as np
 import pyhanabi
 from pyhanabi import color_char_to_idx
 
@@ -106,6 +107,12 @@ class HanabiEnv(Environment):
     self.observation_encoder = pyhanabi.ObservationEncoder(
         self.game, pyhanabi.ObservationEncoderType.CANONICAL)
     self.players = self.game.num_players()
+    # Preallocated outputs of reset_arrays() and step_arrays().
+    self._observation_arrays = np.zeros(
+        (self.players, self.observation_encoder.encoding_length()),
+        dtype=np.float32)
+    self._legal_mask = np.zeros(self.game.max_moves(), dtype=np.uint8)
+    self._stacker = None
 
   def reset(self):
     r"""Resets the environment for a new game.
@@ -216,6 +223,90 @@ class HanabiEnv(Environment):
     obs["current_player"] = self.state.cur_player()
     return obs
 
+  def reset_arrays(self):
+    """Resets the environment for a new game, in array mode.
+
+    Array mode is the fast path of step_arrays(): the observation is only
+    the vectorized observation of every player, written by a single native
+    call into arrays that are reused from step to step.
+
+    Returns:
+      Same tuple as step_arrays(), with a reward of 0.
+    """
+    self.state = self.game.new_initial_state()
+    return self._step_arrays(-1)
+
+  def step_arrays(self, action):
+    """Take one step in the game, in array mode.
+
+    Unlike step(), builds no observation dicts; call observation_dicts() to
+    get them for the current state when needed. The game must have been
+    started with reset_arrays().
+
+    Args:
+      action: int, uid of a legal move in range [0, num_moves()).
+
+    Returns:
+      observations: float32 array [num_players, vectorized length], the
+        vectorized observation of every player.
+      legal_mask: uint8 array [num_moves()], 1 for the legal moves of the
+        current player.
+      reward: float, score differential as in step().
+      done: bool, whether the game is done.
+      current_player: int, the player to act next.
+
+      The arrays are overwritten by the next call; copy them to keep them.
+    """
+    action = int(action)
+    assert self._legal_mask[action], "Illegal action: {}".format(action)
+    return self._step_arrays(action)
+
+  def _step_arrays(self, move_uid):
+    reward, done, current_player = self.state.step_encoded(
+        self.observation_encoder, move_uid, self._observation_arrays,
+        self._legal_mask, self._stacker)
+    return (self._observation_arrays, self._legal_mask, float(reward), done,
+            current_player)
+
+  def enable_observation_stacking(self, history_size):
+    """Keeps the last history_size observations of each player in array mode.
+
+    Each step_arrays() appends the acting player's observation to that
+    player's history, as run_experiment.ObservationStacker does. Read them
+    with stacked_observation(). reset_arrays() clears all histories. The end
+    of a game only marks them for clearing at the next append, so right
+    after done they still hold the finished game's observations.
+
+    Args:
+      history_size: int, number of observations per stack.
+    """
+    self._stacker = pyhanabi.ObservationStacker(
+        self.players, history_size,
+        self.observation_encoder.encoding_length())
+
+  def stacked_observation(self, player, out=None):
+    """Returns the history of player, oldest observation first.
+
+    Args:
+      player: int, the player whose history to return.
+      out: optional writable float32 buffer of history_size * vectorized
+        length values. If given, the history is copied into it.
+
+    Returns:
+      out if given; otherwise a float32 array that aliases the
+      native history and is only valid until the next array-mode step.
+    """
+    assert self._stacker is not None, "Call enable_observation_stacking()."
+    if out is not None:
+      self._stacker.copy(player, out)
+      return out
+    return np.frombuffer(self._stacker.view(player), dtype=np.float32)
+
+  def observation_dicts(self):
+    """Returns the observation dict of reset() and step() for the current
+    state, e.g. for an array-mode step that needs the full observation."""
+    return self._make_observation_all_players()
+
   def vectorized_observation_shape(self):
     """Returns the shape of the vectorized observation.
 
@@ -402,11 +493,10 @@ class HanabiEnv(Environment):
     for color, firework in zip(pyhanabi.COLOR_CHAR, fireworks):
       obs_dict["fireworks"][color] = firework
 
-    obs_dict["legal_moves"] = []
-    obs_dict["legal_moves_as_int"] = []
-    for move in observation.legal_moves():
-      obs_dict["legal_moves"].append(move.to_dict())
-      obs_dict["legal_moves_as_int"].append(self.game.get_move_uid(move))
+    obs_dict["legal_moves"] = [
+        move.to_dict() for move in observation.legal_moves()
+    ]
+    obs_dict["legal_moves_as_int"] = observation.legal_move_uids()
 
     obs_dict["observed_hands"] = []
     for player_hand in observation.observed_hands():
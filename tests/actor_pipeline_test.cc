@@ -0,0 +1,126 @@
+// Copyright 2018 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+// Tests that ActorPipeline answers every request exactly once with a legal
+// move, both when batches fill up and when only the timeout flushes them.
+
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <random>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "actor_pipeline.h"
+#include "hanabi_game.h"
+#include "hanabi_state.h"
+#include "test_check.h"
+
+namespace {
+
+using hanabi_learning_env::ActorPipeline;
+using hanabi_learning_env::ActorPipelineOptions;
+using hanabi_learning_env::ActorPipelineStats;
+using hanabi_learning_env::HanabiGame;
+using hanabi_learning_env::HanabiHistoryItem;
+using hanabi_learning_env::HanabiMove;
+using hanabi_learning_env::HanabiState;
+
+// No game of the tested configuration has this many player moves.
+constexpr int64_t kMaxGameMoves = 200;
+
+void TestPipeline(const HanabiGame& game, int num_threads,
+                  int games_per_thread, int batch_size) {
+  ActorPipelineOptions options;
+  options.num_threads = num_threads;
+  options.games_per_thread = games_per_thread;
+  options.batch_size = batch_size;
+  options.timeout_us = 200;
+  options.seed = 7;
+  const int num_games = num_threads * games_per_thread;
+  const int max_moves = game.MaxMoves();
+
+  // Called on the thread running Run() only.
+  int64_t requests = 0;
+  std::mt19937 rng(1);
+  auto inference = [&](int n, const float* observations,
+                       const uint8_t* legal_masks, int32_t* moves) {
+    (void)observations;
+    // Every game has at most one request in flight.
+    CHECK(n > 0 && n <= batch_size && n <= num_games);
+    for (int i = 0; i < n; ++i) {
+      std::vector<int> legal;
+      for (int uid = 0; uid < max_moves; ++uid) {
+        if (legal_masks[i * max_moves + uid]) {
+          legal.push_back(uid);
+        }
+      }
+      CHECK(!legal.empty());
+      moves[i] = legal[rng() % legal.size()];
+    }
+    requests += n;
+  };
+  // Called concurrently from the workers.
+  std::atomic<int64_t> finished_games{0};
+  std::atomic<int64_t> finished_moves{0};
+  std::atomic<int64_t> finished_score{0};
+  auto game_end = [&](const HanabiState& state) {
+    CHECK(state.IsTerminal());
+    int64_t player_moves = 0;
+    for (const HanabiHistoryItem& item : state.MoveHistory()) {
+      player_moves += item.move.MoveType() != HanabiMove::kDeal;
+    }
+    ++finished_games;
+    finished_moves += player_moves;
+    finished_score += state.Score();
+  };
+
+  ActorPipeline pipeline(&game, options, inference, game_end);
+  CHECK(pipeline.NumGames() == num_games);
+  ActorPipelineStats total;
+  for (int run = 0; run < 4; ++run) {
+    const ActorPipelineStats stats = pipeline.Run(500);
+    CHECK(stats.moves >= 500);
+    CHECK(stats.batches > 0);
+    total.moves += stats.moves;
+    total.games += stats.games;
+    total.total_score += stats.total_score;
+  }
+  CHECK(total.moves == requests);
+  CHECK(total.games == finished_games.load());
+  CHECK(total.total_score == finished_score.load());
+  CHECK(total.games > 0);
+  // Every answered move was applied: finished games hold all of them except
+  // those of the games still running.
+  const int64_t running_moves = requests - finished_moves.load();
+  CHECK(running_moves >= 0 && running_moves < num_games * kMaxGameMoves);
+}
+
+}  // namespace
+
+int main() {
+  const std::unordered_map<std::string, std::string> params = {
+      {"players", "3"}};
+  const HanabiGame game(params);
+  // Batches fill up.
+  TestPipeline(game, 3, 8, 4);
+  // Batches are larger than the number of games, so only the timeout
+  // flushes them.
+  TestPipeline(game, 2, 3, 64);
+  TestPipeline(game, 1, 1, 8);
+  std::printf("actor_pipeline_test passed\n");
+  return 0;
+}
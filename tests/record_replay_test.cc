@@ -0,0 +1,105 @@
+// Copyright 2018 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+// Tests that RecordReplay can be sampled while another thread keeps adding
+// games to a replay much smaller than the stream of games.
+
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "game_record.h"
+#include "hanabi_game.h"
+#include "hanabi_policy.h"
+#include "hanabi_state.h"
+#include "record_replay.h"
+#include "test_check.h"
+
+namespace {
+
+using hanabi_learning_env::GameRecord;
+using hanabi_learning_env::HanabiGame;
+using hanabi_learning_env::HanabiPolicy;
+using hanabi_learning_env::HanabiRng;
+using hanabi_learning_env::MakePolicy;
+using hanabi_learning_env::PlayGame;
+using hanabi_learning_env::RecordBatch;
+using hanabi_learning_env::RecordReplay;
+
+void TestConcurrentAddAndSample(const HanabiGame& game, int num_threads) {
+  const int kNumRecords = 16;
+  const int kBatchSize = 8;
+  std::unique_ptr<HanabiPolicy> policy = MakePolicy("random");
+  std::vector<HanabiPolicy*> policies(game.NumPlayers(), policy.get());
+  std::vector<GameRecord> records;
+  for (int g = 0; g < kNumRecords; ++g) {
+    records.push_back(GameRecord::FromState(
+        PlayGame(&game, policies, HanabiRng(3, 0, g)), 0));
+  }
+
+  RecordReplay replay(&game, 4, num_threads, 5);
+  // Game id g is records[g % kNumRecords].
+  replay.AddRecord(records[0]);
+  std::atomic<bool> stop{false};
+  std::thread adder([&]() {
+    for (int64_t g = 1; !stop.load(); ++g) {
+      CHECK(replay.AddRecord(records[g % kNumRecords]) == g);
+    }
+  });
+
+  const int length = replay.EncodingLength();
+  const int max_moves = game.MaxMoves();
+  std::vector<int64_t> game_ids(kBatchSize);
+  std::vector<int32_t> steps(kBatchSize);
+  std::vector<float> observations(kBatchSize * length);
+  std::vector<uint8_t> legal_masks(kBatchSize * max_moves);
+  std::vector<int32_t> actions(kBatchSize);
+  std::vector<float> rewards(kBatchSize);
+  std::vector<uint8_t> terminals(kBatchSize);
+  std::vector<float> next_observations(kBatchSize * length);
+  const RecordBatch batch = {game_ids.data(),     steps.data(),
+                             observations.data(), legal_masks.data(),
+                             actions.data(),      rewards.data(),
+                             terminals.data(),    next_observations.data()};
+  for (int i = 0; i < 10000; ++i) {
+    CHECK(replay.Sample(kBatchSize, batch));
+    for (int b = 0; b < kBatchSize; ++b) {
+      const GameRecord& record = records[game_ids[b] % kNumRecords];
+      CHECK(steps[b] >= 0 && steps[b] < record.moves.size());
+      CHECK(actions[b] == record.moves[steps[b]]);
+      CHECK(legal_masks[b * max_moves + actions[b]]);
+    }
+  }
+  stop.store(true);
+  adder.join();
+  CHECK(replay.AddCount() > 4);
+}
+
+}  // namespace
+
+int main() {
+  const std::unordered_map<std::string, std::string> params = {
+      {"players", "2"}};
+  const HanabiGame game(params);
+  TestConcurrentAddAndSample(game, 1);
+  TestConcurrentAddAndSample(game, 3);
+  std::printf("record_replay_test passed\n");
+  return 0;
+}
@@ -0,0 +1,157 @@
+// Copyright 2018 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+// Tests SharedRing across forked producer processes, its full-ring,
+// empty-ring and wrap-around paths, and recreating a ring in place.
+
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "shared_ring.h"
+#include "test_check.h"
+
+namespace {
+
+using hanabi_learning_env::SharedRing;
+
+double ElapsedUs(std::chrono::steady_clock::time_point start) {
+  return std::chrono::duration<double, std::micro>(
+             std::chrono::steady_clock::now() - start)
+      .count();
+}
+
+// Producers push (producer, index) pairs through a ring much smaller than
+// their output, so they keep blocking on a full ring, and the consumer
+// checks that each producer's slots arrive complete and in order.
+void TestForkedProducers(const std::string& path) {
+  const int kNumProducers = 3;
+  const int64_t kSlotsPerProducer = 20000;
+  SharedRing ring(path, 16, 16);
+  std::vector<pid_t> children;
+  for (int p = 0; p < kNumProducers; ++p) {
+    const pid_t pid = fork();
+    CHECK(pid >= 0);
+    if (pid == 0) {
+      SharedRing producer(path);
+      for (int64_t i = 0; i < kSlotsPerProducer; ++i) {
+        const int64_t slot[2] = {p, i};
+        CHECK(producer.Push(slot, sizeof(slot), 10000000));
+      }
+      _exit(0);
+    }
+    children.push_back(pid);
+  }
+  std::vector<int64_t> next(kNumProducers, 0);
+  int64_t total = 0;
+  while (total < kNumProducers * kSlotsPerProducer) {
+    const uint8_t* slots;
+    const int n = ring.Peek(8, 10000000, &slots);
+    CHECK(n > 0 && n <= 8);
+    for (int i = 0; i < n; ++i) {
+      int64_t slot[2];
+      std::memcpy(slot, slots + i * ring.SlotBytes(), sizeof(slot));
+      CHECK(slot[0] >= 0 && slot[0] < kNumProducers);
+      CHECK(slot[1] == next[slot[0]]);
+      ++next[slot[0]];
+    }
+    total += n;
+    ring.Release(n);
+  }
+  for (pid_t pid : children) {
+    int status;
+    CHECK(waitpid(pid, &status, 0) == pid);
+    CHECK(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+  }
+  const uint8_t* slots;
+  CHECK(ring.Peek(1, 0, &slots) == 0);
+}
+
+void TestFullAndEmpty(const std::string& path) {
+  SharedRing ring(path, 4, 8);
+  const uint8_t* slots;
+  auto start = std::chrono::steady_clock::now();
+  CHECK(ring.Peek(4, 20000, &slots) == 0);
+  CHECK(ElapsedUs(start) >= 20000);
+
+  for (int64_t i = 0; i < 4; ++i) {
+    CHECK(ring.Push(&i, sizeof(i), 0));
+  }
+  int64_t value = 4;
+  start = std::chrono::steady_clock::now();
+  CHECK(!ring.Push(&value, sizeof(value), 20000));
+  CHECK(ElapsedUs(start) >= 20000);
+  uint64_t ticket;
+  CHECK(ring.Reserve(0, &ticket) == nullptr);
+
+  // Releasing two slots frees exactly two.
+  CHECK(ring.Peek(8, 0, &slots) == 4);
+  ring.Release(2);
+  for (int64_t i = 4; i < 6; ++i) {
+    CHECK(ring.Push(&i, sizeof(i), 0));
+  }
+  CHECK(!ring.Push(&value, sizeof(value), 0));
+
+  // A run of slots stops at the end of the ring; the rest follows after the
+  // wrap.
+  CHECK(ring.Peek(8, 0, &slots) == 2);
+  int64_t read[2];
+  std::memcpy(read, slots, sizeof(read));
+  CHECK(read[0] == 2 && read[1] == 3);
+  ring.Release(2);
+  CHECK(ring.Peek(8, 0, &slots) == 2);
+  std::memcpy(read, slots, sizeof(read));
+  CHECK(read[0] == 4 && read[1] == 5);
+  ring.Release(2);
+  CHECK(ring.Peek(8, 0, &slots) == 0);
+}
+
+// Recreating a ring at the same path leaves rings mapped from the old file
+// working.
+void TestRecreate(const std::string& path) {
+  SharedRing old_ring(path, 4, 8);
+  SharedRing old_producer(path);
+  const int64_t value = 7;
+  CHECK(old_producer.Push(&value, sizeof(value), 0));
+  SharedRing new_ring(path, 8, 16);
+  CHECK(new_ring.NumSlots() == 8);
+  CHECK(old_producer.Push(&value, sizeof(value), 0));
+  const uint8_t* slots;
+  CHECK(old_ring.Peek(4, 0, &slots) == 2);
+  int64_t read;
+  std::memcpy(&read, slots + old_ring.SlotBytes(), sizeof(read));
+  CHECK(read == 7);
+  CHECK(new_ring.Peek(4, 0, &slots) == 0);
+  CHECK(SharedRing(path).SlotBytes() == 16);
+}
+
+}  // namespace
+
+int main() {
+  const std::string path =
+      "shared_ring_test." + std::to_string(getpid()) + ".ring";
+  TestForkedProducers(path);
+  TestFullAndEmpty(path);
+  TestRecreate(path);
+  std::remove(path.c_str());
+  std::printf("shared_ring_test passed\n");
+  return 0;
+}
@@ -0,0 +1,33 @@
+// Copyright 2018 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+// Minimal checks for the test executables, which are registered with CTest
+// and fail by exiting non-zero.
+
+#ifndef __TEST_CHECK_H__
+#define __TEST_CHECK_H__
+
+#include <cstdio>
+#include <cstdlib>
+
+// Prints the failed expression and exits with status 1, which also works in
+// forked children.
+#define CHECK(expr)                                                          \
+  ((expr) ? (void)0                                                          \
+          : (std::fprintf(stderr, "Check failed at %s:%d: %s\n",             \
+                          __FILE__, __LINE__, #expr),                        \
+             std::exit(1)))
+
+#endif
@@ -0,0 +1,181 @@
+// Copyright 2018 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+// Cross-play tournament of built-in policies over common decks (see
+// hanabi_lib/tournament.h).
+//
+//   tournament --policies=simple,hint_playable,safe_discard --num_decks=10000
+//       --config.hanabi.players=2 [--scores=scores.csv]
+//
+// Every lineup of the policies plays the same num_decks decks. Prints the
+// mean score and its standard error per lineup, and for two players the
+// matrix of means. --scores writes every score as lineup,deck,score rows.
+// Scores do not depend on the number of threads.
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "hanabi_game.h"
+#include "hanabi_policy.h"
+#include "tournament.h"
+
+constexpr const char* kGameParamArgPrefix = "--config.hanabi.";
+
+struct TournamentToolOptions {
+  std::vector<std::string> policies = {"simple", "hint_playable",
+                                       "safe_discard"};
+  int num_decks = 1000;
+  int num_threads = std::max(1u, std::thread::hardware_concurrency());
+  uint64_t seed = 0;
+  std::string scores;
+};
+
+std::string LineupName(const std::vector<std::string>& policies,
+                       const std::vector<int>& lineup) {
+  std::string name;
+  for (int entrant : lineup) {
+    name += (name.empty() ? "" : ",") + policies[entrant];
+  }
+  return name;
+}
+
+void RunTournament(
+    const std::unordered_map<std::string, std::string>& game_params,
+    const TournamentToolOptions& options) {
+  hanabi_learning_env::HanabiGame game(game_params);
+  std::vector<hanabi_learning_env::TournamentEntrant> entrants;
+  for (const auto& policy : options.policies) {
+    hanabi_learning_env::TournamentEntrant entrant;
+    entrant.name = policy;
+    entrant.policy = policy;
+    entrants.push_back(entrant);
+  }
+  hanabi_learning_env::TournamentOptions tournament_options;
+  tournament_options.num_threads = options.num_threads;
+  tournament_options.seed = options.seed;
+  auto result = hanabi_learning_env::RunTournament(
+      &game, entrants,
+      hanabi_learning_env::MakeDecks(&game, options.num_decks, options.seed),
+      tournament_options);
+
+  const int num_lineups = result.lineups.size();
+  std::printf("%d lineups x %d decks\n", num_lineups, options.num_decks);
+  for (int l = 0; l < num_lineups; ++l) {
+    std::printf("%-48s %6.3f +- %.3f\n",
+                LineupName(options.policies, result.lineups[l]).c_str(),
+                result.Mean(l), result.StdErr(l));
+  }
+  if (game.NumPlayers() == 2) {
+    // Rows are seat 0, columns seat 1.
+    const int num_policies = options.policies.size();
+    std::printf("\n%-16s", "");
+    for (const auto& policy : options.policies) {
+      std::printf(" %14s", policy.c_str());
+    }
+    std::printf("\n");
+    for (int row = 0; row < num_policies; ++row) {
+      std::printf("%-16s", options.policies[row].c_str());
+      for (int column = 0; column < num_policies; ++column) {
+        std::printf(" %14.3f", result.Mean(row * num_policies + column));
+      }
+      std::printf("\n");
+    }
+  }
+
+  if (!options.scores.empty()) {
+    std::ofstream out(options.scores);
+    if (!out) {
+      std::cerr << "Cannot write " << options.scores << "\n";
+      std::exit(1);
+    }
+    out << "lineup,deck,score\n";
+    for (int l = 0; l < num_lineups; ++l) {
+      const std::string name =
+          LineupName(options.policies, result.lineups[l]);
+      for (int d = 0; d < options.num_decks; ++d) {
+        out << '"' << name << "\"," << d << ',' << result.scores[l][d]
+            << '\n';
+      }
+    }
+  }
+}
+
+std::vector<std::string> ParseList(const std::string& value) {
+  std::vector<std::string> result;
+  std::stringstream stream(value);
+  std::string item;
+  while (std::getline(stream, item, ',')) {
+    result.push_back(item);
+  }
+  return result;
+}
+
+void ParseArguments(int argc, char** argv,
+                    std::unordered_map<std::string, std::string>* game_params,
+                    TournamentToolOptions* options) {
+  const auto prefix_len = strlen(kGameParamArgPrefix);
+  for (int i = 1; i < argc; ++i) {
+    std::string param = argv[i];
+    std::string value;
+    auto value_pos = param.find("=");
+    if (value_pos != std::string::npos) {
+      value = param.substr(value_pos + 1, std::string::npos);
+      param = param.substr(0, value_pos);
+    }
+    if (param.compare(0, prefix_len, kGameParamArgPrefix) == 0 &&
+        param.size() > prefix_len) {
+      (*game_params)[param.substr(prefix_len, std::string::npos)] = value;
+    } else if (param == "--policies") {
+      options->policies = ParseList(value);
+    } else if (param == "--num_decks") {
+      options->num_decks = std::stoi(value);
+    } else if (param == "--num_threads") {
+      options->num_threads = std::stoi(value);
+    } else if (param == "--seed") {
+      options->seed = std::stoull(value);
+    } else if (param == "--scores") {
+      options->scores = value;
+    } else {
+      std::cerr << "Unknown argument " << argv[i] << "\n";
+      std::exit(1);
+    }
+  }
+}
+
+int main(int argc, char** argv) {
+  std::unordered_map<std::string, std::string> game_params;
+  TournamentToolOptions options;
+  ParseArguments(argc, argv, &game_params, &options);
+  if (options.policies.empty()) {
+    std::cerr << "--policies is empty\n";
+    return 1;
+  }
+  for (const auto& policy : options.policies) {
+    if (!hanabi_learning_env::MakePolicy(policy)) {
+      std::cerr << "Unknown policy " << policy << "\n";
+      return 1;
+    }
+  }
+  RunTournament(game_params, options);
+  return 0;
+}